@@ -709,12 +709,12 @@ static PyTypeObject aspell_AspellType = {
 };
 
 DL_EXPORT(void)
-initaspell(void) {
+init_aspell(void) {
 	PyObject *module;
 	PyObject *dict;
 
 	aspell_AspellType.ob_type = &PyType_Type;
-	module = Py_InitModule("aspell", aspell_methods);
+	module = Py_InitModule("_aspell", aspell_methods);
 	dict   = PyModule_GetDict(module);
 
 	_AspellSpellerException = PyErr_NewException("aspell.AspellSpellerError", NULL, NULL);
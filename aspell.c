@@ -50,618 +50,7220 @@ $Id$
 ******************************************************************************/
 
 #include <Python.h>
+#include <pythread.h>
 #include <aspell.h>
 
+/* hot methods are METH_FASTCALL, public API since 3.7; types are heap
+   types bound to the module (PyType_FromModuleAndSpec), since 3.9 */
+#if PY_VERSION_HEX < 0x03090000
+#	error "Python 3.9 or newer is required"
+#endif
+
+/* critical sections lock an object in free-threaded builds, where they
+   replace the GIL as the guard of objects' fields; with the GIL (and
+   before 3.13) they are no-ops */
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#	define Py_BEGIN_CRITICAL_SECTION(op)	{
+#	define Py_END_CRITICAL_SECTION()		}
+#endif
+
+/* flags read on hot paths without any lock; free-threaded builds access
+   them atomically, otherwise they are guarded by the interpreter's GIL */
+#ifdef Py_GIL_DISABLED
+#	define load_flag(ptr)			_Py_atomic_load_int_relaxed(ptr)
+#	define store_flag(ptr, value)	_Py_atomic_store_int_relaxed(ptr, value)
+#else
+#	define load_flag(ptr)			(*(ptr))
+#	define store_flag(ptr, value)	(*(ptr) = (value))
+#endif
+
+/* types can't be subclassed nor modified; iterators are created only by
+   speller's methods; instances refer to their type, which refers to the
+   module, thus all types support the garbage collector */
+#ifdef Py_TPFLAGS_IMMUTABLETYPE
+#	define ASPELL_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC | Py_TPFLAGS_IMMUTABLETYPE)
+#else
+#	define ASPELL_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC)
+#endif
+
+#ifdef Py_TPFLAGS_DISALLOW_INSTANTIATION
+#	define ASPELL_TPFLAGS_NOINIT Py_TPFLAGS_DISALLOW_INSTANTIATION
+#else
+#	define ASPELL_TPFLAGS_NOINIT 0
+#endif
+
+#include <errno.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <time.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
 #define Speller(pyobject) (((aspell_AspellObject*)pyobject)->speller)
 #define Encoding(pyobject) (((aspell_AspellObject*)pyobject)->encoding)
+#define Lock(pyobject) (((aspell_AspellObject*)pyobject)->lock)
+#define EncodingKind(pyobject) (((aspell_AspellObject*)pyobject)->encoding_kind)
+#define SuggestCacheOf(pyobject) (&((aspell_AspellObject*)pyobject)->suggest_cache)
+#define Fingerprint(pyobject) (((aspell_AspellObject*)pyobject)->fingerprint)
 
 static char* DefaultEncoding = "ascii";
 
-static PyTypeObject aspell_AspellType;
-
-/* error reported by speller */
-static PyObject* _AspellSpellerException;
+/* Suggestion cache ***********************************************************/
 
-/* error reported by speller's config */
-static PyObject* _AspellConfigException;
-
-/* error reported by module */
-static PyObject* _AspellModuleException;
+/* LRU cache of suggest() results, keyed by encoded word. Entries are
+   kept in a hash table (chaining) and in a doubly-linked LRU list.
+   The cache is owned by a speller and accessed with the GIL and the
+   speller's lock held. */
+typedef struct CacheEntry {
+	struct CacheEntry* next;	/* next in bucket */
+	struct CacheEntry* newer;	/* LRU list */
+	struct CacheEntry* older;
+	size_t hash;
+	size_t bytes;				/* estimated size of entry */
+	PyObject* value;			/* list of suggestions */
+	Py_ssize_t length;			/* key length */
+	char key[1];
+} CacheEntry;
 
 typedef struct {
-	PyObject_HEAD
-	char* encoding; /* internal encoding */
-	AspellSpeller* speller;	/* the speller */
-} aspell_AspellObject;
+	CacheEntry** buckets;
+	size_t nbuckets;			/* power of two, or 0 if cache is disabled */
+	CacheEntry* newest;
+	CacheEntry* oldest;
+	Py_ssize_t entries;
+	Py_ssize_t bytes;
+	Py_ssize_t max_entries;		/* 0 - no limit */
+	Py_ssize_t max_bytes;		/* 0 - no limit */
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long invalidations;
+	unsigned long long generation;	/* incremented by each invalidation */
+} SuggestCache;
 
+/* FNV-1a */
+static size_t cache_hash(const char* key, Py_ssize_t length) {
+	size_t hash = (size_t)14695981039346656037ULL;
+	Py_ssize_t i;
 
-/* helper function: converts an aspell word list into python list */
-static PyObject* AspellWordList2PythonList(PyObject* self, const AspellWordList* wordlist) {
-	PyObject* list;
-	PyObject* elem;
+	for (i=0; i < length; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= (size_t)1099511628211ULL;
+	}
 
-	AspellStringEnumeration* elements;
-	const char* word;
+	return hash;
+}
 
-	list = PyList_New(0);
-	if (!list) {
-		PyErr_SetString(PyExc_Exception, "can't create new list");
-		return NULL;
-	}
+static void cache_unlink(SuggestCache* cache, CacheEntry* entry) {
+	CacheEntry** slot;
 
-	elements = aspell_word_list_elements(wordlist);
-	while ( (word=aspell_string_enumeration_next(elements)) != 0) {
-		elem = PyUnicode_Decode(word, strlen(word), Encoding(self), NULL);
+	slot = &cache->buckets[entry->hash & (cache->nbuckets - 1)];
+	while (*slot != entry)
+		slot = &(*slot)->next;
+	*slot = entry->next;
 
-		if (elem == 0) {
-			delete_aspell_string_enumeration(elements);
-			Py_DECREF(list);
-			return NULL;
-		}
+	if (entry->newer)
+		entry->newer->older = entry->older;
+	else
+		cache->newest = entry->older;
 
-		if (PyList_Append(list, elem) == -1) {
-			delete_aspell_string_enumeration(elements);
-			Py_DECREF(elem);
-			Py_DECREF(list);
-			return NULL;
-		}
-	}
+	if (entry->older)
+		entry->older->newer = entry->newer;
+	else
+		cache->oldest = entry->newer;
 
-	delete_aspell_string_enumeration(elements);
-	return list;
+	cache->entries -= 1;
+	cache->bytes   -= entry->bytes;
 }
 
-/* helper function: converts an aspell string list into python list */
-static PyObject* AspellStringList2PythonList(const AspellStringList* wordlist) {
-	PyObject* list;
-	AspellStringEnumeration* elements;
-	const char* word;
+static void cache_free_entry(CacheEntry* entry) {
+	Py_DECREF(entry->value);
+	PyMem_Free(entry);
+}
 
-	list = PyList_New(0);
-	if (!list) {
-		PyErr_SetString(PyExc_Exception, "can't create new list");
-		return NULL;
+/* removes all entries, doesn't change limits */
+static void cache_clear(SuggestCache* cache) {
+	CacheEntry* entry;
+	CacheEntry* older;
+
+	for (entry = cache->newest; entry; entry = older) {
+		older = entry->older;
+		cache_free_entry(entry);
 	}
 
-	elements = aspell_string_list_elements(wordlist);
-	while ( (word=aspell_string_enumeration_next(elements)) != 0)
-		if (PyList_Append(list, Py_BuildValue("s", word)) == -1) {
-			PyErr_SetString(PyExc_Exception, "It is almost impossible, but happend! Can't append element to the list.");
-			delete_aspell_string_enumeration(elements);
-			Py_DECREF(list);
-			return NULL;
-		}
-	delete_aspell_string_enumeration(elements);
-	return list;
-}
+	if (cache->buckets)
+		memset(cache->buckets, 0, cache->nbuckets * sizeof(CacheEntry*));
 
+	cache->newest	= NULL;
+	cache->oldest	= NULL;
+	cache->entries	= 0;
+	cache->bytes	= 0;
+}
 
-static PyObject* get_single_arg_string(
-	PyObject* self,	// [in]
-	PyObject* obj,	// [in]
-	char** word,		// [out]
-	Py_ssize_t* size	// [out]
-);
+/* called when speller's state changes */
+static void cache_invalidate(SuggestCache* cache) {
+	cache->generation += 1;
+	if (cache->entries > 0) {
+		cache_clear(cache);
+		cache->invalidations += 1;
+	}
+}
 
-/* Create a new speller *******************************************************/
-static PyObject* new_speller(PyTypeObject* self, PyObject* args, PyObject* kwargs) {
-	aspell_AspellObject* newobj;
+static void cache_init(SuggestCache* cache) {
+	memset(cache, 0, sizeof(SuggestCache));
+}
 
-	AspellSpeller* speller = 0;
-	AspellConfig*  config;
-	AspellCanHaveError* possible_error;
+static void cache_destroy(SuggestCache* cache) {
+	cache_clear(cache);
+	PyMem_Free(cache->buckets);
+	cache->buckets  = NULL;
+	cache->nbuckets = 0;
+}
 
-	int i;
-	int n; /* arg count */
-	char *key, *value;
-	char *encoding;
+/* returns borrowed reference or NULL */
+static PyObject* cache_lookup(SuggestCache* cache, const char* key, Py_ssize_t length) {
+	CacheEntry* entry;
+	size_t hash;
 
-	config = new_aspell_config();
-	if (config == NULL) {
-		PyErr_SetString(_AspellModuleException, "can't create config");
+	if (cache->nbuckets == 0)
 		return NULL;
-	}
 
-	/* check constructor arguments */
-	n = PyTuple_Size(args);
-	switch (n) {
-		case 0: /* no arguments passed */
+	hash = cache_hash(key, length);
+	for (entry = cache->buckets[hash & (cache->nbuckets - 1)]; entry; entry = entry->next)
+		if (entry->hash == hash && entry->length == length && memcmp(entry->key, key, length) == 0)
 			break;
 
-		case 2: /* constructor is called with single pair: key & value */
-			if (PyArg_ParseTuple(args, "ss", &key, &value)) {
-				if (!aspell_config_replace(config, key, value)) {
-					PyErr_SetString(_AspellConfigException, aspell_config_error_message(config));
-					goto arg_error;
-				}
-				break;
-			}
-			PyErr_Clear();
-		default: /* list of tuples key&value */
-			for (i=0; i<n; i++) {
-				if (!PyArg_ParseTuple(PyTuple_GetItem(args, i), "ss", &key, &value)) {
-					PyErr_Format(PyExc_TypeError, "argument %d: tuple of two strings (key, value) expeced", i);
-					goto arg_error;
-				}
-				if (!aspell_config_replace(config, key, value)) {
-					PyErr_SetString(_AspellConfigException, aspell_config_error_message(config));
-					goto arg_error;
-				}
-			}
-			break;
+	if (entry == NULL) {
+		cache->misses += 1;
+		return NULL;
 	}
 
-	/* try to create a new speller */
-	possible_error = new_aspell_speller(config);
+	cache->hits += 1;
 
-	if (aspell_error_number(possible_error) == 0)
-		/* save a speller */
-		speller = to_aspell_speller(possible_error);
-	else {
-		/* or raise an exception */
-		PyErr_SetString(_AspellSpellerException, aspell_error_message(possible_error));
-		delete_aspell_config(config);
-		delete_aspell_can_have_error(possible_error);
-		return NULL;
-	}
+	/* move to front */
+	if (entry != cache->newest) {
+		entry->newer->older = entry->older;
+		if (entry->older)
+			entry->older->newer = entry->newer;
+		else
+			cache->oldest = entry->newer;
 
-	/* get encoding */
-	encoding = NULL;
-	value = (char*)aspell_config_retrieve(config, "encoding");
-	if (value) {
-		if (strcmp(value, "none") != 0) {
-			encoding = (char*)malloc(strlen(value)+1);
-			if (encoding)
-				strcpy(encoding, value);
-		}
+		entry->older = cache->newest;
+		entry->newer = NULL;
+		cache->newest->newer = entry;
+		cache->newest = entry;
 	}
 
-	if (encoding == NULL)
-		encoding = DefaultEncoding;
-	
-	// free config
-	delete_aspell_config(config);
+	return entry->value;
+}
 
-	/* create a new py-object */
-  newobj = (aspell_AspellObject*)PyObject_New(aspell_AspellObject, &aspell_AspellType);
-	newobj->speller = speller;
-	newobj->encoding = encoding;
+static int cache_over_limit(SuggestCache* cache) {
+	return (cache->max_entries > 0 && cache->entries > cache->max_entries)
+	    || (cache->max_bytes > 0 && cache->bytes > cache->max_bytes);
+}
 
-	return (PyObject*)newobj;
+static void cache_resize(SuggestCache* cache) {
+	CacheEntry** buckets;
+	CacheEntry* entry;
+	size_t nbuckets = cache->nbuckets * 2;
+	size_t i;
 
-/* argument error: before return NULL we need to
-   delete speller's config we've created */
-arg_error:
-	delete_aspell_config(config);
-	return NULL;
-}
+	buckets = PyMem_Malloc(nbuckets * sizeof(CacheEntry*));
+	if (buckets == NULL)
+		return; /* just keep longer chains */
 
-/* Delete speller *************************************************************/
-static void speller_dealloc(PyObject* self) {
-	if (Encoding(self) != DefaultEncoding)
-		free(Encoding(self));
+	memset(buckets, 0, nbuckets * sizeof(CacheEntry*));
+	for (entry = cache->newest; entry; entry = entry->older) {
+		i = entry->hash & (nbuckets - 1);
+		entry->next = buckets[i];
+		buckets[i] = entry;
+	}
 
-	delete_aspell_speller( Speller(self) );
-	PyObject_Del(self);
+	PyMem_Free(cache->buckets);
+	cache->buckets  = buckets;
+	cache->nbuckets = nbuckets;
 }
 
+/* stores a list of suggestions (the cache takes a new reference);
+   failures are silently ignored - it's just a cache */
+static void cache_insert(SuggestCache* cache, const char* key, Py_ssize_t length, PyObject* value) {
+	CacheEntry* entry;
+	PyObject* item;
+	Py_ssize_t i;
+	size_t bytes;
 
-static PyObject* configkeys_helper(PyObject* self) {
-	AspellConfig* config;
-	AspellKeyInfoEnumeration *keys_enumeration;
-	AspellStringList* lst;
-	AspellMutableContainer* amc;
-	const AspellKeyInfo *key_info;
+	if (cache->nbuckets == 0)
+		return;
 
-	PyObject *dict = 0, *obj = 0, *value = 0;
-	const char*  string;
-	unsigned int integer;
-	unsigned int boolean;
+	/* raw spellers cache lists of bytes, others lists of str */
+	bytes = sizeof(CacheEntry) + length + sizeof(PyListObject) + PyList_GET_SIZE(value) * sizeof(PyObject*);
+	for (i=0; i < PyList_GET_SIZE(value); i++) {
+		item = PyList_GET_ITEM(value, i);
+		if (PyBytes_Check(item))
+			bytes += Py_TYPE(item)->tp_basicsize + PyBytes_GET_SIZE(item);
+		else
+		if (PyUnicode_IS_COMPACT_ASCII(item))
+			bytes += sizeof(PyASCIIObject) + PyUnicode_GET_LENGTH(item) + 1;
+		else
+			/* decoded strings are compact, with 1, 2 or 4 bytes per char */
+			bytes += sizeof(PyCompactUnicodeObject) + (PyUnicode_GET_LENGTH(item) + 1) * PyUnicode_KIND(item);
+	}
 
-	char *key_type = 0;
+	if (cache->max_bytes > 0 && (Py_ssize_t)bytes > cache->max_bytes)
+		return;
 
-	if (self)
-		config = aspell_speller_config(Speller(self));
+	entry = PyMem_Malloc(sizeof(CacheEntry) + length);
+	if (entry == NULL)
+		return;
+
+	memcpy(entry->key, key, length);
+	entry->length = length;
+	entry->hash   = cache_hash(key, length);
+	entry->bytes  = bytes;
+	entry->value  = value;
+	Py_INCREF(value);
+
+	i = entry->hash & (cache->nbuckets - 1);
+	entry->next = cache->buckets[i];
+	cache->buckets[i] = entry;
+
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest)
+		cache->newest->newer = entry;
 	else
-		config = new_aspell_config();
+		cache->oldest = entry;
+	cache->newest = entry;
 
-	if (config == NULL) {
-		PyErr_SetString(_AspellModuleException, "can't create config");
-		return NULL;
-	}
+	cache->entries += 1;
+	cache->bytes   += bytes;
 
-	keys_enumeration = aspell_config_possible_elements(config, 1);
-	if (!keys_enumeration) {
-		if (!self) delete_aspell_config(config);
-		PyErr_SetString(_AspellConfigException, "can't get list of config keys");
-		return NULL;
+	while (cache_over_limit(cache)) {
+		entry = cache->oldest;
+		cache_unlink(cache, entry);
+		cache_free_entry(entry);
+		cache->evictions += 1;
 	}
 
-	dict = PyDict_New();
-	if (dict == NULL) {
-		if (!self) delete_aspell_config(config);
-		return NULL;
-	}
-		
-	while ((key_info = aspell_key_info_enumeration_next(keys_enumeration))) {
+	if ((size_t)cache->entries > cache->nbuckets)
+		cache_resize(cache);
+}
 
-		/* key type -> string */
-		switch (key_info->type) {
-			case AspellKeyInfoString:
-				key_type = "string";
-				string   = aspell_config_retrieve(config, key_info->name);
-				if (aspell_config_error(config) != NULL) goto config_get_error;
-				obj      = PyUnicode_FromString( string );
-				break;
-			case AspellKeyInfoInt:
-				key_type = "integer";
-				integer  = aspell_config_retrieve_int(config, key_info->name);
-				if (aspell_config_error(config) != NULL) goto config_get_error;
-				obj      = PyLong_FromLong( integer );
-				break;
-			case AspellKeyInfoBool:
-				key_type = "boolean";
-				boolean  = aspell_config_retrieve_bool(config, key_info->name);
-				if (aspell_config_error(config) != NULL) goto config_get_error;
-				obj      = PyBool_FromLong( boolean );
-				break;
-			case AspellKeyInfoList:
-				key_type = "list";
-				lst = new_aspell_string_list();
-				amc = aspell_string_list_to_mutable_container(lst);
-				aspell_config_retrieve_list(config, key_info->name, amc);
-				if (aspell_config_error(config) != NULL) goto config_get_error;
+/* sets limits, 0 means no limit; if both are 0 cache is disabled */
+static int cache_configure(SuggestCache* cache, Py_ssize_t max_entries, Py_ssize_t max_bytes) {
+	CacheEntry* entry;
 
-				obj = AspellStringList2PythonList(lst);
-				delete_aspell_string_list(lst);
-				break;
+	if (max_entries == 0 && max_bytes == 0) {
+		cache_destroy(cache);
+		cache->max_entries = 0;
+		cache->max_bytes   = 0;
+		return 0;
+	}
+
+	if (cache->nbuckets == 0) {
+		cache->buckets = PyMem_Malloc(64 * sizeof(CacheEntry*));
+		if (cache->buckets == NULL) {
+			PyErr_NoMemory();
+			return -1;
 		}
 
-		/* value */
-		value = Py_BuildValue("(sOs)",
-							key_type,
-							obj,
-							key_info->desc ? key_info->desc : "internal"
-		);
+		cache->nbuckets = 64;
+		memset(cache->buckets, 0, cache->nbuckets * sizeof(CacheEntry*));
+	}
 
-		if (value) {
-			if (PyDict_SetItemString(dict, key_info->name, value)) {
-				goto python_error;
-			}
-			else
-				Py_DECREF(value);
-		}
-		else
-			goto python_error;
+	cache->max_entries = max_entries;
+	cache->max_bytes   = max_bytes;
+	while (cache->entries > 0 && cache_over_limit(cache)) {
+		entry = cache->oldest;
+		cache_unlink(cache, entry);
+		cache_free_entry(entry);
+		cache->evictions += 1;
 	}
-	
-	delete_aspell_key_info_enumeration(keys_enumeration);
-	if (!self) delete_aspell_config(config);
-	return dict;
 
-config_get_error:
-	PyErr_SetString(_AspellConfigException, aspell_config_error_message(config));
-python_error:
-	delete_aspell_key_info_enumeration(keys_enumeration);
-	if (!self) delete_aspell_config(config);
-	Py_DECREF(dict);
-	return NULL;
+	return 0;
 }
 
-/* ConfigKeys *****************************************************************/
-static PyObject* configkeys(PyObject* _) {
-	return configkeys_helper(NULL);
-}
 
-/* method:ConfigKeys **********************************************************/
-static PyObject* m_configkeys(PyObject* self, PyObject* args) {
-	return configkeys_helper(self);
-}
+/* Shared check cache *********************************************************/
 
-/* method:setConfigKey ********************************************************/
-static PyObject* m_set_config_key(PyObject* self, PyObject* args) {
-	AspellConfig* config;
-	const AspellKeyInfo* info;
-	char* key;
-	char* string;
-	Py_ssize_t length;
-	long  number;
-	char  buffer[32];
+/* Process-wide cache of check() results shared by all spellers. Key is
+   a speller's fingerprint (hash of its config, changed when session or
+   personal word list of speller is modified) and an encoded word.
 
-	PyObject* arg1;
-	PyObject* value;
+   Entries have fixed size and are stored inline in a set-associative
+   table split into stripes, each guarded by its own lock, so lookups
+   from many threads (also without the GIL) rarely contend. Memory
+   is allocated once, when the cache is enabled. */
 
-	if (PyTuple_Size(args) != 2) {
-		PyErr_Format(PyExc_TypeError, "expected two arguments");
-		return NULL;
-	}
+#define CHECK_CACHE_WORD	46	/* longer words are not cached */
+#define CHECK_CACHE_WAYS	4
+#define CHECK_CACHE_STRIPES	64
 
-	if (!PyArg_ParseTuple(args, "sO", &key, &arg1)) {
-		PyErr_Format(PyExc_TypeError, "first argument must be a string");
-		return NULL;
-	}
+typedef struct {
+	unsigned long long fingerprint;	/* 0 - empty slot */
+	unsigned long long hash;
+	unsigned char length;
+	unsigned char correct;
+	char word[CHECK_CACHE_WORD];
+} CheckCacheEntry;
 
+typedef struct {
+	PyThread_type_lock lock;
+	CheckCacheEntry* entries;	/* nsets * CHECK_CACHE_WAYS */
+	unsigned int victim;		/* round-robin replacement */
+	Py_ssize_t used;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+} CheckCacheStripe;
+
+typedef struct {
+	PyThread_type_lock lock;	/* guards refcount */
+	Py_ssize_t refcount;
+	size_t nsets;				/* sets in a stripe */
+	CheckCacheStripe stripes[CHECK_CACHE_STRIPES];
+} CheckCache;
+
+/* Module state ***************************************************************/
+
+/* Everything owned by an instance of the module; each interpreter imports
+   its own instance. Fields which are not python objects are guarded by the
+   GIL, or in free-threaded builds by a critical section on the module. */
+typedef struct {
+	PyObject* speller_error;	/* error reported by speller */
+	PyObject* config_error;		/* error reported by speller's config */
+	PyObject* module_error;		/* error reported by module */
+
+	PyTypeObject* speller_type;
+	PyTypeObject* wordlist_iter_type;
+	PyTypeObject* file_checker_type;
+	PyTypeObject* pool_type;
+	PyTypeObject* local_type;
+	PyTypeObject* multi_type;
+	PyTypeObject* mapped_type;
+
+	CheckCache* check_cache;	/* current cache or NULL */
+	unsigned long long fingerprint_counter;	/* source of private fingerprints */
+
+	PyObject* registry;		/* spellers of getSpeller(), keyed by config */
+	unsigned long long registry_hits;
+	unsigned long long registry_misses;
+
+	int stats_enabled;		/* see setStatsEnabled, use load_flag/store_flag */
+} ModuleState;
+
+/* types can't be subclassed, thus an object's type is always
+   the one created by the module */
+static PyObject* module_of(PyObject* self) {
+	return PyType_GetModule(Py_TYPE(self));
+}
+
+static ModuleState* state_of_module(PyObject* module) {
+	return (ModuleState*)PyModule_GetState(module);
+}
+
+static ModuleState* state_of_type(PyTypeObject* type) {
+	return state_of_module(PyType_GetModule(type));
+}
+
+static ModuleState* state_of(PyObject* self) {
+	return state_of_module(module_of(self));
+}
+
+#define SpellerError(pyobject) (state_of(pyobject)->speller_error)
+#define ConfigError(pyobject) (state_of(pyobject)->config_error)
+#define ModuleError(pyobject) (state_of(pyobject)->module_error)
+
+static void check_cache_free(CheckCache* cache) {
+	int i;
+
+	if (cache->lock)
+		PyThread_free_lock(cache->lock);
+
+	for (i=0; i < CHECK_CACHE_STRIPES; i++) {
+		if (cache->stripes[i].lock)
+			PyThread_free_lock(cache->stripes[i].lock);
+		PyMem_Free(cache->stripes[i].entries);
+	}
+
+	PyMem_Free(cache);
+}
+
+static CheckCache* check_cache_new(Py_ssize_t entries) {
+	CheckCache* cache;
+	size_t n;
+	int i;
+
+	cache = PyMem_Malloc(sizeof(CheckCache));
+	if (cache == NULL)
+		return (CheckCache*)PyErr_NoMemory();
+
+	memset(cache, 0, sizeof(CheckCache));
+	cache->refcount = 1;
+	cache->nsets = (entries + CHECK_CACHE_STRIPES*CHECK_CACHE_WAYS - 1) / (CHECK_CACHE_STRIPES*CHECK_CACHE_WAYS);
+	n = cache->nsets * CHECK_CACHE_WAYS;
+
+	cache->lock = PyThread_allocate_lock();
+	if (cache->lock == NULL) {
+		check_cache_free(cache);
+		return (CheckCache*)PyErr_NoMemory();
+	}
+
+	for (i=0; i < CHECK_CACHE_STRIPES; i++) {
+		cache->stripes[i].lock = PyThread_allocate_lock();
+		cache->stripes[i].entries = PyMem_Malloc(n * sizeof(CheckCacheEntry));
+		if (cache->stripes[i].lock == NULL || cache->stripes[i].entries == NULL) {
+			check_cache_free(cache);
+			return (CheckCache*)PyErr_NoMemory();
+		}
+
+		memset(cache->stripes[i].entries, 0, n * sizeof(CheckCacheEntry));
+	}
+
+	return cache;
+}
+
+/* takes a reference to the module's current cache; the module's reference
+   can't be released meanwhile, setCheckCache swaps it under the same
+   critical section */
+static CheckCache* check_cache_get(PyObject* module) {
+	CheckCache* cache;
+
+	Py_BEGIN_CRITICAL_SECTION(module);
+	cache = state_of_module(module)->check_cache;
+	if (cache) {
+		PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+		cache->refcount += 1;
+		PyThread_release_lock(cache->lock);
+	}
+	Py_END_CRITICAL_SECTION();
+
+	return cache;
+}
+
+/* releases reference */
+static void check_cache_put(CheckCache* cache) {
+	int last;
+
+	if (cache == NULL)
+		return;
+
+	PyThread_acquire_lock(cache->lock, WAIT_LOCK);
+	last = (--cache->refcount == 0);
+	PyThread_release_lock(cache->lock);
+
+	if (last)
+		check_cache_free(cache);
+}
+
+static unsigned long long check_cache_hash(unsigned long long fingerprint, const char* word, Py_ssize_t length) {
+	return (unsigned long long)cache_hash(word, length) ^ (fingerprint * 0x9e3779b97f4a7c15ULL);
+}
+
+/* returns 0/1 - cached result, -1 - not found; safe without the GIL */
+static int check_cache_lookup(CheckCache* cache, unsigned long long fingerprint, const char* word, Py_ssize_t length) {
+	CheckCacheStripe* stripe;
+	CheckCacheEntry* entry;
+	unsigned long long hash;
+	int i, result = -1;
+
+	if (length > CHECK_CACHE_WORD)
+		return -1;
+
+	hash   = check_cache_hash(fingerprint, word, length);
+	stripe = &cache->stripes[hash % CHECK_CACHE_STRIPES];
+	entry  = &stripe->entries[(hash / CHECK_CACHE_STRIPES) % cache->nsets * CHECK_CACHE_WAYS];
+
+	PyThread_acquire_lock(stripe->lock, WAIT_LOCK);
+	for (i=0; i < CHECK_CACHE_WAYS; i++, entry++)
+		if (entry->fingerprint == fingerprint
+		 && entry->hash == hash
+		 && entry->length == length
+		 && memcmp(entry->word, word, length) == 0) {
+			result = entry->correct;
+			break;
+		}
+
+	if (result < 0)
+		stripe->misses += 1;
+	else
+		stripe->hits += 1;
+	PyThread_release_lock(stripe->lock);
+
+	return result;
+}
+
+/* stores result of check; safe without the GIL */
+static void check_cache_insert(CheckCache* cache, unsigned long long fingerprint, const char* word, Py_ssize_t length, int correct) {
+	CheckCacheStripe* stripe;
+	CheckCacheEntry* set;
+	CheckCacheEntry* entry = NULL;
+	unsigned long long hash;
+	int i;
+
+	if (length > CHECK_CACHE_WORD)
+		return;
+
+	hash   = check_cache_hash(fingerprint, word, length);
+	stripe = &cache->stripes[hash % CHECK_CACHE_STRIPES];
+	set    = &stripe->entries[(hash / CHECK_CACHE_STRIPES) % cache->nsets * CHECK_CACHE_WAYS];
+
+	PyThread_acquire_lock(stripe->lock, WAIT_LOCK);
+	for (i=0; i < CHECK_CACHE_WAYS; i++)
+		if (set[i].fingerprint == 0) {
+			entry = &set[i];
+			stripe->used += 1;
+			break;
+		}
+
+	if (entry == NULL) {
+		entry = &set[stripe->victim++ % CHECK_CACHE_WAYS];
+		stripe->evictions += 1;
+	}
+
+	entry->fingerprint = fingerprint;
+	entry->hash    = hash;
+	entry->length  = (unsigned char)length;
+	entry->correct = (unsigned char)correct;
+	memcpy(entry->word, word, length);
+	PyThread_release_lock(stripe->lock);
+}
+
+/* helper function: calls visit for name and value(s) of each config key */
+static void config_walk(AspellConfig* config, void (*visit)(void*, const char*), void* context) {
+	AspellKeyInfoEnumeration* keys;
+	const AspellKeyInfo* info;
+	AspellStringList* lst;
+	AspellStringEnumeration* elements;
+	const char* string;
+	char buffer[32];
+
+	keys = aspell_config_possible_elements(config, 1);
+	if (keys == NULL)
+		return;
+
+	while ((info = aspell_key_info_enumeration_next(keys))) {
+		visit(context, info->name);
+		switch (info->type) {
+			case AspellKeyInfoString:
+				string = aspell_config_retrieve(config, info->name);
+				if (string)
+					visit(context, string);
+				break;
+
+			case AspellKeyInfoInt:
+			case AspellKeyInfoBool:
+				snprintf(buffer, sizeof(buffer), "%d",
+					info->type == AspellKeyInfoInt
+					? aspell_config_retrieve_int(config, info->name)
+					: aspell_config_retrieve_bool(config, info->name));
+				visit(context, buffer);
+				break;
+
+			case AspellKeyInfoList:
+				lst = new_aspell_string_list();
+				aspell_config_retrieve_list(config, info->name, aspell_string_list_to_mutable_container(lst));
+				elements = aspell_string_list_elements(lst);
+				while ((string = aspell_string_enumeration_next(elements)))
+					visit(context, string);
+				delete_aspell_string_enumeration(elements);
+				delete_aspell_string_list(lst);
+				break;
+		}
+	}
+
+	delete_aspell_key_info_enumeration(keys);
+}
+
+static void hash_string(void* context, const char* string) {
+	unsigned long long* hash = (unsigned long long*)context;
+
+	*hash = (*hash ^ cache_hash(string, strlen(string))) * 1099511628211ULL;
+}
+
+/* helper function: hash of all config values */
+static unsigned long long config_fingerprint(AspellConfig* config) {
+	unsigned long long hash = 14695981039346656037ULL;
+
+	config_walk(config, hash_string, &hash);
+	return hash;
+}
+
+typedef struct {
+	char* data;
+	size_t used;
+	size_t capacity;
+	int failed;
+} StringBuffer;
+
+static void append_bytes(StringBuffer* buffer, const void* data, size_t length) {
+	char* tmp;
+
+	if (buffer->failed)
+		return;
+
+	if (buffer->used + length > buffer->capacity) {
+		tmp = realloc(buffer->data, 2*(buffer->used + length));
+		if (tmp == NULL) {
+			buffer->failed = 1;
+			return;
+		}
+
+		buffer->data = tmp;
+		buffer->capacity = 2*(buffer->used + length);
+	}
+
+	memcpy(buffer->data + buffer->used, data, length);
+	buffer->used += length;
+}
+
+static void append_string(void* context, const char* string) {
+	append_bytes((StringBuffer*)context, string, strlen(string) + 1);
+}
+
+/* helper function: returns all config values as bytes; configs
+   with the same values produce equal keys */
+static PyObject* config_key(AspellConfig* config) {
+	StringBuffer buffer;
+	PyObject* key;
+
+	memset(&buffer, 0, sizeof(buffer));
+	config_walk(config, append_string, &buffer);
+	if (buffer.failed) {
+		free(buffer.data);
+		return PyErr_NoMemory();
+	}
+
+	key = PyBytes_FromStringAndSize(buffer.data, buffer.used);
+	free(buffer.data);
+	return key;
+}
+
+
+/* encodings handled without codec machinery */
+typedef enum {
+	ENCODING_ASCII,
+	ENCODING_LATIN1,
+	ENCODING_UTF8,
+	ENCODING_OTHER,
+	ENCODING_RAW		/* raw speller: bytes in, bytes out */
+} EncodingKind;
+
+/* Runtime statistics *******************************************************/
+
+/* Counters and latency histograms of speller's operations. Time spent in
+   libaspell and time spent on converting words is measured separately.
+   Histograms have log2 buckets: bucket i counts durations in range
+   [2^i, 2^(i+1)) ns. Stats are updated with the GIL held; when collection
+   is disabled the clock isn't read at all. */
+
+typedef enum {
+	STATS_CHECK,
+	STATS_CHECK_MANY,
+	STATS_CHECK_BUFFER,
+	STATS_CHECK_DOCUMENT,
+	STATS_SUGGEST,
+	STATS_SUGGEST_MANY,
+	STATS_OPERATIONS
+} StatsOperation;
+
+static const char* stats_names[STATS_OPERATIONS] = {
+	"check",
+	"checkMany",
+	"checkBuffer",
+	"checkDocument",
+	"suggest",
+	"suggestMany",
+};
+
+typedef enum {
+	STATS_OK,
+	STATS_ERROR,		/* reported by aspell */
+	STATS_EXCEPTION		/* other python exception */
+} StatsOutcome;
+
+#define STATS_BUCKETS 40
+
+typedef struct {
+	unsigned long long calls;
+	unsigned long long words;
+	unsigned long long errors;
+	unsigned long long exceptions;
+	unsigned long long aspell_ns;
+	unsigned long long convert_ns;
+	unsigned long long aspell_histogram[STATS_BUCKETS];
+	unsigned long long convert_histogram[STATS_BUCKETS];
+} OperationStats;
+
+typedef struct {
+	OperationStats operations[STATS_OPERATIONS];
+} SpellerStats;
+
+/* switched by aspell.setStatsEnabled() for each interpreter; off by
+   default, because reading the clock is noticeable compared to a cheap
+   call like check() */
+#define StatsEnabled(pyobject) load_flag(&((aspell_AspellObject*)pyobject)->state->stats_enabled)
+
+#define STATS_NOW(pyobject) (StatsEnabled(pyobject) ? monotonic_ns() : 0)
+
+/* additional speller used by suggestMany() */
+typedef struct {
+	AspellSpeller* speller;
+	unsigned long long private_id; /* speller's word lists copied so far */
+	size_t replayed; /* bytes of replacements log applied */
+} SuggestWorker;
+
+/* pairs passed to addReplacement(), replayed on workers */
+typedef struct {
+	char* data;
+	size_t used;
+	size_t capacity;
+} ReplacementLog;
+
+typedef struct {
+	PyObject_HEAD
+	char* encoding; /* internal encoding */
+	EncodingKind encoding_kind;
+	PyObject* encoder; /* codec's encoder, used for ENCODING_OTHER */
+	AspellSpeller* speller;	/* the speller */
+	PyThread_type_lock lock; /* serializes all uses of speller */
+	SuggestCache suggest_cache; /* guarded by lock */
+	unsigned long long config_hash; /* fingerprint of config */
+	unsigned long long private_id; /* non-zero once word lists were modified */
+	unsigned long long fingerprint; /* key of entries in check cache */
+	SuggestWorker* workers; /* guarded by lock */
+	Py_ssize_t nworkers;
+	unsigned long long workers_config; /* config_hash of workers */
+	ReplacementLog replacements; /* guarded by lock */
+	SpellerStats* stats; /* guarded by critical section, allocated on first use */
+	ModuleState* state; /* of the module, which outlives the speller's type */
+} aspell_AspellObject;
+
+
+/* helper function: recalculates speller's fingerprint;
+   must be called with the speller's lock held */
+static void update_fingerprint(PyObject* self, int config_changed, int wordlists_changed) {
+	aspell_AspellObject* obj = (aspell_AspellObject*)self;
+
+	if (config_changed)
+		obj->config_hash = config_fingerprint(aspell_speller_config(obj->speller));
+
+	/* speller's results differ from other spellers with the same config */
+	if (wordlists_changed) {
+		PyObject* module = module_of(self);
+
+		Py_BEGIN_CRITICAL_SECTION(module);
+		obj->private_id = ++state_of_module(module)->fingerprint_counter;
+		Py_END_CRITICAL_SECTION();
+	}
+
+	obj->fingerprint = (obj->config_hash ^ (obj->private_id * 0xc2b2ae3d27d4eb4fULL)) | 1;
+}
+
+
+static void stats_add(unsigned long long* histogram, long long ns) {
+	int bucket = 0;
+
+	while (ns > 1 && bucket < STATS_BUCKETS - 1) {
+		ns >>= 1;
+		bucket++;
+	}
+
+	histogram[bucket] += 1;
+}
+
+/* helper function: records a call; aspell_ns < 0 means aspell wasn't
+   called (e.g. cache hit) */
+static void stats_record(
+	PyObject* self,
+	StatsOperation operation,
+	Py_ssize_t words,
+	long long aspell_ns,
+	long long convert_ns,
+	StatsOutcome outcome
+) {
+	aspell_AspellObject* obj = (aspell_AspellObject*)self;
+	OperationStats* stats;
+
+	if (!StatsEnabled(self))
+		return;
+
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (obj->stats == NULL)
+		obj->stats = PyMem_Calloc(1, sizeof(SpellerStats));
+
+	/* stats are not worth an exception */
+	if (obj->stats != NULL) {
+		stats = &obj->stats->operations[operation];
+		stats->calls += 1;
+		stats->words += words;
+		if (outcome == STATS_ERROR)
+			stats->errors += 1;
+		else if (outcome == STATS_EXCEPTION)
+			stats->exceptions += 1;
+
+		if (aspell_ns >= 0) {
+			stats->aspell_ns += aspell_ns;
+			stats_add(stats->aspell_histogram, aspell_ns);
+		}
+
+		stats->convert_ns += convert_ns;
+		stats_add(stats->convert_histogram, convert_ns);
+	}
+	Py_END_CRITICAL_SECTION();
+}
+
+
+/* Speller's lock *************************************************************/
+
+/* libaspell calls are made with the GIL released, thus every access to
+   a speller (and to its config or word lists) has to be done with the
+   speller's lock held. The lock is taken while holding the GIL; if it's
+   busy, the GIL is released for the time of waiting, so a thread holding
+   the lock can always reacquire the GIL. */
+static void speller_lock(PyObject* self) {
+	if (!PyThread_acquire_lock(Lock(self), NOWAIT_LOCK)) {
+		Py_BEGIN_ALLOW_THREADS
+		PyThread_acquire_lock(Lock(self), WAIT_LOCK);
+		Py_END_ALLOW_THREADS
+	}
+}
+
+static void speller_unlock(PyObject* self) {
+	PyThread_release_lock(Lock(self));
+}
+
+
+/* helper function: monotonic clock in nanoseconds */
+static long long monotonic_ns(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	/* fixed at boot, no need to cache it in a global */
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (long long)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+
+/* helper function: classifies encoding name */
+static EncodingKind get_encoding_kind(const char* encoding) {
+	char name[16];
+	size_t i, n;
+
+	/* normalize: lower case, without '-' and '_' */
+	for (i=0, n=0; encoding[i] && n < sizeof(name) - 1; i++) {
+		if (encoding[i] == '-' || encoding[i] == '_')
+			continue;
+
+		name[n++] = Py_TOLOWER(encoding[i]);
+	}
+	name[n] = 0;
+
+	if (strcmp(name, "ascii") == 0 || strcmp(name, "usascii") == 0)
+		return ENCODING_ASCII;
+
+	if (strcmp(name, "iso88591") == 0 || strcmp(name, "latin1") == 0)
+		return ENCODING_LATIN1;
+
+	if (strcmp(name, "utf8") == 0)
+		return ENCODING_UTF8;
+
+	return ENCODING_OTHER;
+}
+
+/* helper function: converts a word returned by aspell into python string */
+static PyObject* decode_word(PyObject* self, const char* word, Py_ssize_t size) {
+	switch (EncodingKind(self)) {
+		case ENCODING_ASCII:
+			return PyUnicode_DecodeASCII(word, size, NULL);
+
+		case ENCODING_LATIN1:
+			return PyUnicode_DecodeLatin1(word, size, NULL);
+
+		case ENCODING_UTF8:
+			return PyUnicode_DecodeUTF8(word, size, NULL);
+
+		case ENCODING_RAW:
+			return PyBytes_FromStringAndSize(word, size);
+
+		default:
+			return PyUnicode_Decode(word, size, Encoding(self), NULL);
+	}
+}
+
+/* A single word to suggest. Word lists returned by aspell are owned by
+   the speller, thus they are copied into a job under the speller's lock
+   and converted by job2list after unlocking: creating python objects may
+   run the garbage collector, and a finalizer may use the same speller. */
+typedef struct {
+	const char* word;
+	Py_ssize_t length;
+	char* suggestions;	/* NUL-terminated words, one after another */
+	Py_ssize_t count;	/* number of suggestions */
+	char* error;		/* or error message */
+} SuggestJob;
+
+/* helper function: copies string returned by aspell */
+static char* copy_string(const char* string) {
+	char* copy = malloc(strlen(string) + 1);
+	if (copy)
+		strcpy(copy, string);
+
+	return copy;
+}
+
+/* helper function: copies at most limit strings (all if limit < 0) of
+   an enumeration, the job gets fewer only when the enumeration ends;
+   returns 0 on success */
+static int copy_strings(SuggestJob* job, AspellStringEnumeration* elements, Py_ssize_t limit) {
+	const char* word;
+	size_t used = 0, capacity = 0, length;
+	char* tmp;
+
+	while (job->count != limit && (word = aspell_string_enumeration_next(elements)) != NULL) {
+		length = strlen(word) + 1;
+		if (used + length > capacity) {
+			capacity = 2*(used + length);
+			tmp = realloc(job->suggestions, capacity);
+			if (tmp == NULL)
+				return -1;
+			job->suggestions = tmp;
+		}
+
+		memcpy(job->suggestions + used, word, length);
+		used += length;
+		job->count += 1;
+	}
+
+	return 0;
+}
+
+/* helper function: copies list of suggestions; returns 0 on success */
+static int copy_suggestions(SuggestJob* job, const AspellWordList* wordlist) {
+	AspellStringEnumeration* elements;
+	int result;
+
+	elements = aspell_word_list_elements(wordlist);
+	result = copy_strings(job, elements, -1);
+	delete_aspell_string_enumeration(elements);
+	return result;
+}
+
+/* helper function: converts suggestions of a job into python list */
+static PyObject* job2list(PyObject* self, SuggestJob* job) {
+	PyObject* list;
+	PyObject* word;
+	const char* s;
+	Py_ssize_t i, length;
+
+	list = PyList_New(job->count);
+	if (list == NULL)
+		return NULL;
+
+	for (i=0, s=job->suggestions; i < job->count; i++, s += length + 1) {
+		length = strlen(s);
+		word = decode_word(self, s, length);
+		if (word == NULL) {
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, i, word);
+	}
+
+	return list;
+}
+
+/* helper function: converts an aspell string list into python list */
+static PyObject* AspellStringList2PythonList(const AspellStringList* wordlist) {
+	PyObject* list;
+	AspellStringEnumeration* elements;
+	const char* word;
+
+	list = PyList_New(0);
+	if (!list) {
+		PyErr_SetString(PyExc_Exception, "can't create new list");
+		return NULL;
+	}
+
+	elements = aspell_string_list_elements(wordlist);
+	while ( (word=aspell_string_enumeration_next(elements)) != 0)
+		if (PyList_Append(list, Py_BuildValue("s", word)) == -1) {
+			PyErr_SetString(PyExc_Exception, "It is almost impossible, but happend! Can't append element to the list.");
+			delete_aspell_string_enumeration(elements);
+			Py_DECREF(list);
+			return NULL;
+		}
+	delete_aspell_string_enumeration(elements);
+	return list;
+}
+
+
+static PyObject* get_single_arg_string(
+	PyObject* self,	// [in]
+	PyObject* obj,	// [in]
+	char** word,		// [out]
+	Py_ssize_t* size	// [out]
+);
+
+/* helper function: creates config from arguments of Speller(), i.e.
+   nothing, a single pair key & value, or a list of such pairs */
+static AspellConfig* config_from_args(ModuleState* state, PyObject* args) {
+	AspellConfig*  config;
+
+	int i;
+	int n; /* arg count */
+	char *key, *value;
+
+	config = new_aspell_config();
+	if (config == NULL) {
+		PyErr_SetString(state->module_error, "can't create config");
+		return NULL;
+	}
+
+	/* check constructor arguments */
+	n = PyTuple_Size(args);
+	switch (n) {
+		case 0: /* no arguments passed */
+			break;
+
+		case 2: /* constructor is called with single pair: key & value */
+			if (PyArg_ParseTuple(args, "ss", &key, &value)) {
+				if (!aspell_config_replace(config, key, value)) {
+					PyErr_SetString(state->config_error, aspell_config_error_message(config));
+					goto arg_error;
+				}
+				break;
+			}
+			PyErr_Clear();
+		default: /* list of tuples key&value */
+			for (i=0; i<n; i++) {
+				if (!PyArg_ParseTuple(PyTuple_GetItem(args, i), "ss", &key, &value)) {
+					PyErr_Format(PyExc_TypeError, "argument %d: tuple of two strings (key, value) expeced", i);
+					goto arg_error;
+				}
+				if (!aspell_config_replace(config, key, value)) {
+					PyErr_SetString(state->config_error, aspell_config_error_message(config));
+					goto arg_error;
+				}
+			}
+			break;
+	}
+
+	return config;
+
+/* argument error: before return NULL we need to
+   delete speller's config we've created */
+arg_error:
+	delete_aspell_config(config);
+	return NULL;
+}
+
+/* helper function: creates python object for a speller; the object takes
+   ownership of the speller, which is deleted on error */
+static PyObject* wrap_speller(ModuleState* state, AspellSpeller* speller) {
+	aspell_AspellObject* newobj;
+	const char* value;
+	char *encoding;
+
+	/* get encoding */
+	encoding = NULL;
+	value = aspell_config_retrieve(aspell_speller_config(speller), "encoding");
+	if (value) {
+		if (strcmp(value, "none") != 0) {
+			encoding = (char*)malloc(strlen(value)+1);
+			if (encoding)
+				strcpy(encoding, value);
+		}
+	}
+
+	if (encoding == NULL)
+		encoding = DefaultEncoding;
+
+	/* create a new py-object */
+	newobj = (aspell_AspellObject*)state->speller_type->tp_alloc(state->speller_type, 0);
+	if (newobj == NULL) {
+		if (encoding != DefaultEncoding)
+			free(encoding);
+		delete_aspell_speller(speller);
+		return NULL;
+	}
+
+	newobj->speller = speller;
+	newobj->encoding = encoding;
+	newobj->encoding_kind = get_encoding_kind(encoding);
+	newobj->encoder = NULL;
+	cache_init(&newobj->suggest_cache);
+	newobj->private_id = 0;
+	update_fingerprint((PyObject*)newobj, 1, 0);
+	newobj->workers = NULL;
+	newobj->nworkers = 0;
+	newobj->workers_config = 0;
+	memset(&newobj->replacements, 0, sizeof(ReplacementLog));
+	newobj->stats = NULL;
+	newobj->state = state;
+	newobj->lock = PyThread_allocate_lock();
+	if (newobj->lock == NULL) {
+		Py_DECREF(newobj);
+		return PyErr_NoMemory();
+	}
+
+	/* resolve codec once, not on every call */
+	if (newobj->encoding_kind == ENCODING_OTHER) {
+		newobj->encoder = PyCodec_Encoder(encoding);
+		if (newobj->encoder == NULL) {
+			Py_DECREF(newobj);
+			return NULL;
+		}
+	}
+
+	return (PyObject*)newobj;
+}
+
+/* helper function: creates speller object for config */
+static PyObject* speller_from_config(ModuleState* state, AspellConfig* config) {
+	AspellCanHaveError* possible_error;
+
+	/* try to create a new speller (loading dictionaries might take a while) */
+	Py_BEGIN_ALLOW_THREADS
+	possible_error = new_aspell_speller(config);
+	Py_END_ALLOW_THREADS
+
+	if (aspell_error_number(possible_error) != 0) {
+		PyErr_SetString(state->speller_error, aspell_error_message(possible_error));
+		delete_aspell_can_have_error(possible_error);
+		return NULL;
+	}
+
+	return wrap_speller(state, to_aspell_speller(possible_error));
+}
+
+/* Create a new speller *******************************************************/
+static PyObject* new_speller(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"raw", NULL};
+	ModuleState* state = state_of_type(type);
+	AspellConfig* config;
+	PyObject* speller;
+	PyObject* empty;
+	int raw = 0;
+
+	/* config is given as positional arguments, only options are parsed */
+	if (kwargs) {
+		empty = PyTuple_New(0);
+		if (empty == NULL)
+			return NULL;
+
+		if (!PyArg_ParseTupleAndKeywords(empty, kwargs, "|p:Speller", kwlist, &raw)) {
+			Py_DECREF(empty);
+			return NULL;
+		}
+
+		Py_DECREF(empty);
+	}
+
+	config = config_from_args(state, args);
+	if (config == NULL)
+		return NULL;
+
+	speller = speller_from_config(state, config);
+	delete_aspell_config(config);
+
+	/* words are passed to aspell as they are, in the speller's encoding */
+	if (speller && raw)
+		EncodingKind(speller) = ENCODING_RAW;
+
+	return speller;
+}
+
+static void delete_workers(aspell_AspellObject* self);
+
+/* Delete speller *************************************************************/
+static void speller_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+
+	PyObject_GC_UnTrack(self);
+	if (Encoding(self) != DefaultEncoding)
+		free(Encoding(self));
+
+	delete_workers((aspell_AspellObject*)self);
+	free(((aspell_AspellObject*)self)->replacements.data);
+	PyMem_Free(((aspell_AspellObject*)self)->stats);
+	delete_aspell_speller( Speller(self) );
+	Py_XDECREF(((aspell_AspellObject*)self)->encoder);
+	cache_destroy(SuggestCacheOf(self));
+	if (Lock(self))
+		PyThread_free_lock(Lock(self));
+
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+/* the cached lists hold just strings, thus a speller refers to other
+   objects only by its type and encoder, which can't be cleared */
+static int speller_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(((aspell_AspellObject*)self)->encoder);
+	return 0;
+}
+
+
+/* helper function: returns config keys of speller, or defaults if self is NULL;
+   the speller's config is cloned, so the dictionary is built without the lock */
+static PyObject* configkeys_helper(ModuleState* state, PyObject* self) {
+	AspellConfig* config;
+	AspellKeyInfoEnumeration *keys_enumeration;
+	AspellStringList* lst;
+	AspellMutableContainer* amc;
+	const AspellKeyInfo *key_info;
+
+	PyObject *dict = 0, *obj = 0, *value = 0;
+	const char*  string;
+	unsigned int integer;
+	unsigned int boolean;
+
+	char *key_type = 0;
+
+	if (self) {
+		speller_lock(self);
+		config = aspell_config_clone(aspell_speller_config(Speller(self)));
+		speller_unlock(self);
+	}
+	else
+		config = new_aspell_config();
+
+	if (config == NULL) {
+		PyErr_SetString(state->module_error, "can't create config");
+		return NULL;
+	}
+
+	keys_enumeration = aspell_config_possible_elements(config, 1);
+	if (!keys_enumeration) {
+		delete_aspell_config(config);
+		PyErr_SetString(state->config_error, "can't get list of config keys");
+		return NULL;
+	}
+
+	dict = PyDict_New();
+	if (dict == NULL) {
+		delete_aspell_config(config);
+		return NULL;
+	}
+		
+	while ((key_info = aspell_key_info_enumeration_next(keys_enumeration))) {
+
+		/* key type -> string */
+		switch (key_info->type) {
+			case AspellKeyInfoString:
+				key_type = "string";
+				string   = aspell_config_retrieve(config, key_info->name);
+				if (aspell_config_error(config) != NULL) goto config_get_error;
+				obj      = PyUnicode_FromString( string );
+				break;
+			case AspellKeyInfoInt:
+				key_type = "integer";
+				integer  = aspell_config_retrieve_int(config, key_info->name);
+				if (aspell_config_error(config) != NULL) goto config_get_error;
+				obj      = PyLong_FromLong( integer );
+				break;
+			case AspellKeyInfoBool:
+				key_type = "boolean";
+				boolean  = aspell_config_retrieve_bool(config, key_info->name);
+				if (aspell_config_error(config) != NULL) goto config_get_error;
+				obj      = PyBool_FromLong( boolean );
+				break;
+			case AspellKeyInfoList:
+				key_type = "list";
+				lst = new_aspell_string_list();
+				amc = aspell_string_list_to_mutable_container(lst);
+				aspell_config_retrieve_list(config, key_info->name, amc);
+				if (aspell_config_error(config) != NULL) goto config_get_error;
+
+				obj = AspellStringList2PythonList(lst);
+				delete_aspell_string_list(lst);
+				break;
+		}
+
+		/* value */
+		value = Py_BuildValue("(sOs)",
+							key_type,
+							obj,
+							key_info->desc ? key_info->desc : "internal"
+		);
+
+		if (value) {
+			if (PyDict_SetItemString(dict, key_info->name, value)) {
+				goto python_error;
+			}
+			else
+				Py_DECREF(value);
+		}
+		else
+			goto python_error;
+	}
+	
+	delete_aspell_key_info_enumeration(keys_enumeration);
+	delete_aspell_config(config);
+	return dict;
+
+config_get_error:
+	PyErr_SetString(state->config_error, aspell_config_error_message(config));
+python_error:
+	delete_aspell_key_info_enumeration(keys_enumeration);
+	delete_aspell_config(config);
+	Py_DECREF(dict);
+	return NULL;
+}
+
+/* ConfigKeys *****************************************************************/
+static PyObject* configkeys(PyObject* module) {
+	return configkeys_helper(state_of_module(module), NULL);
+}
+
+/* method:ConfigKeys **********************************************************/
+static PyObject* m_configkeys(PyObject* self, PyObject* args) {
+	return configkeys_helper(state_of(self), self);
+}
+
+/* helper function: sets config key of speller;
+   must be called with the speller's lock held */
+static PyObject* set_config_key_helper(PyObject* self, char* key, PyObject* arg1) {
+	AspellConfig* config;
+	const AspellKeyInfo* info;
+	char* string;
+	Py_ssize_t length;
+	long  number;
+	char  buffer[32];
+
+	PyObject* value;
+
+	config = aspell_speller_config(Speller(self));
+	info   = aspell_config_keyinfo(config, key);
+	if (aspell_config_error(config) != 0) {
+		PyErr_SetString(ConfigError(self), aspell_config_error_message(config));
+		return NULL;
+	}
+
+	switch (info->type) {
+		case AspellKeyInfoList:
+			// Can't figure out the splitting char for lists,
+			// it seems to be the ':', but doesn't work.
+		case AspellKeyInfoString:
+			value = get_single_arg_string(self, arg1, &string, &length);
+			if (value == NULL) {
+				PyErr_Format(PyExc_TypeError, "second argument have to be string");
+				return NULL;
+			}
+
+			aspell_config_replace(config, key, string);
+			Py_DECREF(value);
+			break;
+
+		case AspellKeyInfoInt:
+			number = PyLong_AsLong(arg1);
+			if (number == -1 && PyErr_Occurred()) {
+				return NULL;
+			}
+
+			snprintf(buffer, 32, "%ld", number);
+			aspell_config_replace(config, key, buffer);
+			break;
+
+		case AspellKeyInfoBool:
+			if (PyBool_Check(arg1)) {
+				aspell_config_replace(config, key, (arg1 == Py_True) ? "true" : "false");
+			} else {
+				PyErr_Format(PyExc_TypeError, "second argument have to be boolean");
+				return NULL;
+			}
+			break;
+
+		default:
+			PyErr_Format(ModuleError(self), "unsupported aspell config item type");
+			return NULL;
+	}
 
-	config = aspell_speller_config(Speller(self));
-	info   = aspell_config_keyinfo(config, key);
 	if (aspell_config_error(config) != 0) {
-		PyErr_SetString(_AspellConfigException, aspell_config_error_message(config));
+		PyErr_SetString(ConfigError(self), aspell_config_error_message(config));
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+/* method:setConfigKey ********************************************************/
+static PyObject* m_set_config_key(PyObject* self, PyObject* args) {
+	char* key;
+	PyObject* arg1;
+	PyObject* result;
+
+	if (PyTuple_Size(args) != 2) {
+		PyErr_Format(PyExc_TypeError, "expected two arguments");
+		return NULL;
+	}
+
+	if (!PyArg_ParseTuple(args, "sO", &key, &arg1)) {
+		PyErr_Format(PyExc_TypeError, "first argument must be a string");
+		return NULL;
+	}
+
+	speller_lock(self);
+	result = set_config_key_helper(self, key, arg1);
+	cache_invalidate(SuggestCacheOf(self));
+	update_fingerprint(self, 1, 0);
+	speller_unlock(self);
+
+	return result;
+}
+
+
+/* helper function: converts str or bytes into encoded buffer;
+   returns object which owns the buffer or NULL on error */
+static PyObject* encode_string(
+	const char* encoding,	// [in] encoding name
+	EncodingKind kind,		// [in]
+	PyObject* encoder,		// [in] codec's encoder for ENCODING_OTHER
+	PyObject* obj,	// [in]
+	char** word,		// [out]
+	Py_ssize_t* size	// [out]
+) {
+	PyObject* buf;
+	PyObject* result;
+	const char* data;
+
+	/* unicode */
+	if (PyUnicode_Check(obj)) {
+		if (kind == ENCODING_RAW) {
+			PyErr_SetString(PyExc_TypeError, "bytes-like object required by raw speller");
+			return NULL;
+		}
+
+		/* fast paths: the string itself holds the encoded data,
+		   so it's returned as the buffer and no copy is made */
+		switch (kind) {
+			case ENCODING_UTF8:
+				data = PyUnicode_AsUTF8AndSize(obj, size);
+				if (data == NULL)
+					return NULL;
+
+				*word = (char*)data;
+				Py_INCREF(obj);
+				return obj;
+
+			case ENCODING_ASCII:
+				if (PyUnicode_IS_ASCII(obj)) {
+					*word = (char*)PyUnicode_DATA(obj);
+					*size = PyUnicode_GET_LENGTH(obj);
+					Py_INCREF(obj);
+					return obj;
+				}
+				/* let codec report the error */
+				buf = PyUnicode_AsASCIIString(obj);
+				break;
+
+			case ENCODING_LATIN1:
+				if (PyUnicode_KIND(obj) == PyUnicode_1BYTE_KIND) {
+					*word = (char*)PyUnicode_DATA(obj);
+					*size = PyUnicode_GET_LENGTH(obj);
+					Py_INCREF(obj);
+					return obj;
+				}
+				/* let codec report the error */
+				buf = PyUnicode_AsLatin1String(obj);
+				break;
+
+			default:
+				/* encoder returns tuple (bytes, length consumed) */
+				result = PyObject_CallFunctionObjArgs(encoder, obj, NULL);
+				if (result == NULL)
+					return NULL;
+
+				if (!PyTuple_Check(result) || PyTuple_GET_SIZE(result) != 2 || !PyBytes_Check(PyTuple_GET_ITEM(result, 0))) {
+					Py_DECREF(result);
+					PyErr_Format(PyExc_TypeError, "encoder '%s' returned unexpected result", encoding);
+					return NULL;
+				}
+
+				buf = PyTuple_GET_ITEM(result, 0);
+				Py_INCREF(buf);
+				Py_DECREF(result);
+				break;
+		}
+	}
+	else
+	/* buffer */
+	if (PyBytes_Check(obj)) {
+		buf = obj;
+		Py_INCREF(buf);	// PyTuple_GetItem returns borrowed reference
+	}
+	else
+	/* bytearray, memoryview, ...: copied, as they might change
+	   while aspell runs without the GIL */
+	if (PyObject_CheckBuffer(obj)) {
+		buf = PyBytes_FromObject(obj);
+	}
+	else {
+		PyErr_SetString(PyExc_TypeError, "string of bytes required");
+		return NULL;
+	}
+
+	/* unpack buffer */
+	if (buf) {
+		if (PyBytes_AsStringAndSize(buf, word, size) != -1) {
+			return buf;
+		}
+		else {
+			Py_DECREF(buf);
+			return NULL;
+		}
+	}
+	else
+		return NULL;
+}
+
+
+static PyObject* get_single_arg_string(
+	PyObject* self,	// [in]
+	PyObject* obj,	// [in]
+	char** word,		// [out]
+	Py_ssize_t* size	// [out]
+) {
+	return encode_string(
+		Encoding(self),
+		EncodingKind(self),
+		((aspell_AspellObject*)self)->encoder,
+		obj,
+		word,
+		size
+	);
+}
+
+
+static PyObject* get_arg_string(
+	PyObject* self,	// [in]
+	PyObject* args,	// [in]
+	const int index,// [in] args[index]
+	char** word,		// [out]
+	Py_ssize_t* size	// [out]
+) {
+	PyObject* obj;
+
+	obj = PyTuple_GetItem(args, index);
+	if (obj)
+		return get_single_arg_string(self, obj, word, size);
+	else
+		return NULL;
+}
+
+
+/* helper function: checks number of arguments of METH_FASTCALL method */
+static int check_nargs(const char* name, Py_ssize_t nargs, Py_ssize_t expected) {
+	if (nargs == expected)
+		return 0;
+
+	PyErr_Format(PyExc_TypeError, "%s() takes exactly %zd argument%s (%zd given)",
+		name, expected, expected == 1 ? "" : "s", nargs);
+	return -1;
+}
+
+/* helper function: matches arguments of METH_FASTCALL|METH_KEYWORDS method
+   with names in kwlist; first required ones are mandatory, values of
+   missing arguments are left NULL (borrowed references) */
+static int parse_fastcall(
+	const char* name,			// [in] method name, for messages
+	PyObject* const* args,		// [in]
+	Py_ssize_t nargs,			// [in]
+	PyObject* kwnames,			// [in] may be NULL
+	const char* const* kwlist,	// [in] NULL terminated
+	Py_ssize_t required,		// [in]
+	PyObject** values			// [out] as many as names in kwlist
+) {
+	Py_ssize_t count, nkw, i, j;
+	PyObject* key;
+
+	for (count=0; kwlist[count]; count++)
+		values[count] = NULL;
+
+	if (nargs > count) {
+		PyErr_Format(PyExc_TypeError, "%s() takes at most %zd arguments (%zd given)", name, count, nargs);
+		return -1;
+	}
+
+	for (i=0; i < nargs; i++)
+		values[i] = args[i];
+
+	nkw = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+	for (i=0; i < nkw; i++) {
+		key = PyTuple_GET_ITEM(kwnames, i);
+		for (j=0; j < count; j++)
+			if (PyUnicode_CompareWithASCIIString(key, kwlist[j]) == 0)
+				break;
+
+		if (j == count) {
+			PyErr_Format(PyExc_TypeError, "'%U' is an invalid keyword argument for %s()", key, name);
+			return -1;
+		}
+
+		if (values[j]) {
+			PyErr_Format(PyExc_TypeError, "argument '%s' of %s() given by name and position", kwlist[j], name);
+			return -1;
+		}
+
+		values[j] = args[nargs + i];
+	}
+
+	for (i=0; i < required; i++)
+		if (values[i] == NULL) {
+			PyErr_Format(PyExc_TypeError, "%s() missing required argument '%s'", name, kwlist[i]);
+			return -1;
+		}
+
+	return 0;
+}
+
+
+/* method:__contains__ ********************************************************/
+static int
+m_contains(PyObject* self, PyObject* args) {
+	char*	word;
+	Py_ssize_t length;
+	PyObject* buf;
+	CheckCache* cache;
+	int result;
+	long long t0, t1, t2;
+
+	t0 = STATS_NOW(self);
+	buf = get_single_arg_string(self, args, &word, &length);
+	t1 = STATS_NOW(self);
+	if (buf == NULL) {
+		stats_record(self, STATS_CHECK, 0, -1, t1 - t0, STATS_EXCEPTION);
+		return -1;
+	}
+
+	cache = check_cache_get(module_of(self));
+	if (cache) {
+		result = check_cache_lookup(cache, Fingerprint(self), word, length);
+		if (result >= 0) {
+			check_cache_put(cache);
+			Py_DECREF(buf);
+			stats_record(self, STATS_CHECK, 1, -1, t1 - t0, STATS_OK);
+			return result;
+		}
+	}
+
+	speller_lock(self);
+	t2 = STATS_NOW(self);
+	Py_BEGIN_ALLOW_THREADS
+	result = aspell_speller_check(Speller(self), word, length);
+	Py_END_ALLOW_THREADS
+	stats_record(self, STATS_CHECK, 1, STATS_NOW(self) - t2, t1 - t0, result == 0 || result == 1 ? STATS_OK : STATS_ERROR);
+
+	switch (result) {
+		case 0:
+		case 1:
+			/* fingerprint is read under the lock, after the check */
+			if (cache)
+				check_cache_insert(cache, Fingerprint(self), word, length, result);
+			break;
+
+		default:
+			PyErr_SetString(SpellerError(self), aspell_speller_error_message(Speller(self)));
+			result = -1;
+			break;
+	}
+
+	speller_unlock(self);
+	check_cache_put(cache);
+	Py_DECREF(buf);
+	return result;
+}
+
+
+/* method:check ***************************************************************/
+static PyObject* m_check(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	if (check_nargs("check", nargs, 1) < 0)
+		return NULL;
+
+	switch (m_contains(self, args[0])) {
+		case 0:
+			Py_RETURN_FALSE;
+
+		case 1:
+			Py_RETURN_TRUE;
+
+		default:
+			return NULL;
+	}
+}
+
+/* method:checkMany ***********************************************************/
+static PyObject* m_checkMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"words", "indices", NULL};
+
+	PyObject* words;
+	PyObject* seq;
+	PyObject* result = NULL;
+	PyObject* index;
+	PyObject** bufs = NULL;
+	char** word = NULL;
+	Py_ssize_t* length = NULL;
+	char* mask = NULL;
+	int indices = 0;
+	int correct = 0;
+	Py_ssize_t i, n, k;
+	CheckCache* cache;
+	unsigned long long fingerprint;
+	long long t0, aspell_ns = -1;
+	StatsOutcome outcome = STATS_EXCEPTION;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", kwlist, &words, &indices))
+		return NULL;
+
+	t0 = STATS_NOW(self);
+
+	/* lists and tuples are used directly, other iterables are materialized */
+	seq = PySequence_Fast(words, "checkMany() argument must be an iterable of strings");
+	if (seq == NULL)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE(seq);
+
+	/* 1. encode all words, so that libaspell can be called without the GIL */
+	bufs   = PyMem_New(PyObject*, n);
+	word   = PyMem_New(char*, n);
+	length = PyMem_New(Py_ssize_t, n);
+	mask   = PyMem_Malloc(n > 0 ? n : 1);
+	if (bufs == NULL || word == NULL || length == NULL || mask == NULL) {
+		PyErr_NoMemory();
+		n = 0;
+		goto cleanup;
+	}
+
+	for (i=0; i < n; i++) {
+		bufs[i] = get_single_arg_string(self, PySequence_Fast_GET_ITEM(seq, i), &word[i], &length[i]);
+		if (bufs[i] == NULL) {
+			if (PyErr_ExceptionMatches(PyExc_TypeError))
+				PyErr_Format(PyExc_TypeError, "word #%zd: string or bytes required", i);
+			n = i;
+			goto cleanup;
+		}
+	}
+
+	/* 2. check them */
+	cache = check_cache_get(module_of(self));
+	speller_lock(self);
+	fingerprint = Fingerprint(self);
+	aspell_ns = STATS_NOW(self);
+	Py_BEGIN_ALLOW_THREADS
+	for (i=0; i < n; i++) {
+		if (cache) {
+			correct = check_cache_lookup(cache, fingerprint, word[i], length[i]);
+			if (correct >= 0) {
+				mask[i] = (char)correct;
+				continue;
+			}
+		}
+
+		correct = aspell_speller_check(Speller(self), word[i], length[i]);
+		if (correct != 0 && correct != 1)
+			break;
+
+		if (cache)
+			check_cache_insert(cache, fingerprint, word[i], length[i], correct);
+
+		mask[i] = (char)correct;
+	}
+	Py_END_ALLOW_THREADS
+	aspell_ns = STATS_NOW(self) - aspell_ns;
+	check_cache_put(cache);
+
+	if (i < n) {
+		PyErr_Format(SpellerError(self), "word #%zd: %s", i, aspell_speller_error_message(Speller(self)));
+		speller_unlock(self);
+		outcome = STATS_ERROR;
+		goto cleanup;
+	}
+	speller_unlock(self);
+
+	/* 3. build result */
+	if (!indices) {
+		result = PyByteArray_FromStringAndSize(mask, n);
+		goto cleanup;
+	}
+
+	result = PyList_New(0);
+	if (result == NULL)
+		goto cleanup;
+
+	for (k=0; k < n; k++) {
+		if (mask[k])
+			continue;
+
+		index = PyLong_FromSsize_t(k);
+		if (index == NULL || PyList_Append(result, index) == -1) {
+			Py_XDECREF(index);
+			Py_CLEAR(result);
+			goto cleanup;
+		}
+		Py_DECREF(index);
+	}
+
+cleanup:
+	for (i=0; i < n; i++)
+		Py_DECREF(bufs[i]);
+
+	PyMem_Free(bufs);
+	PyMem_Free(word);
+	PyMem_Free(length);
+	PyMem_Free(mask);
+	Py_DECREF(seq);
+
+	if (result)
+		outcome = STATS_OK;
+	stats_record(self, STATS_CHECK_MANY, n, aspell_ns, STATS_NOW(self) - t0 - (aspell_ns > 0 ? aspell_ns : 0), outcome);
+	return result;
+}
+
+/* checkBuffer ****************************************************************/
+
+/* helper function: returns position of the first separator in [p, end)
+   or end if there is none */
+static const char* find_separator(const char* p, const char* end, const char* sep, Py_ssize_t seplen) {
+	const char* q;
+
+	if (seplen == 1) {
+		q = memchr(p, sep[0], end - p);
+		return q ? q : end;
+	}
+
+	while (end - p >= seplen) {
+		q = memchr(p, sep[0], end - p - seplen + 1);
+		if (q == NULL)
+			break;
+
+		if (memcmp(q, sep, seplen) == 0)
+			return q;
+
+		p = q + 1;
+	}
+
+	return end;
+}
+
+/* helper function: number of words in buffer; a trailing separator
+   doesn't start a new word */
+static Py_ssize_t count_words(const char* data, Py_ssize_t size, const char* sep, Py_ssize_t seplen) {
+	const char* p = data;
+	const char* end = data + size;
+	Py_ssize_t n = 0;
+
+	while (p < end) {
+		p = find_separator(p, end, sep, seplen);
+		n += 1;
+		if (p < end)
+			p += seplen;
+	}
+
+	return n;
+}
+
+/* method:checkBuffer *********************************************************/
+static PyObject* m_checkBuffer(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"buffer", "sep", "offsets", NULL};
+
+	PyObject* obj;
+	PyObject* result = NULL;
+	PyObject* bytes;
+	PyObject* array;
+	Py_buffer view;
+	Py_buffer sep = {NULL, NULL};
+	int offsets = 0;
+	char* mask = NULL;
+	long long* misspelled = NULL;	/* byte offsets, if offsets is true */
+	long long* tmp;
+	Py_ssize_t count = 0;
+	Py_ssize_t capacity = 0;
+	Py_ssize_t n = 0;
+	Py_ssize_t i = 0;
+	const char* p;
+	const char* q;
+	const char* end;
+	int correct = 1;
+	int nomemory = 0;
+	int toolong = 0;
+	CheckCache* cache;
+	unsigned long long fingerprint;
+	long long t0, aspell_ns = -1;
+	StatsOutcome outcome = STATS_EXCEPTION;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|y*p", kwlist, &obj, &sep, &offsets))
+		return NULL;
+
+	if (sep.buf == NULL) {
+		if (PyBuffer_FillInfo(&sep, NULL, "\n", 1, 1, PyBUF_SIMPLE) < 0)
+			return NULL;
+	}
+	else if (sep.len == 0) {
+		PyBuffer_Release(&sep);
+		PyErr_SetString(PyExc_ValueError, "empty separator");
+		return NULL;
+	}
+
+	/* the buffer is exported until the end, thus can't be resized */
+	if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0) {
+		PyBuffer_Release(&sep);
+		return NULL;
+	}
+
+	t0 = STATS_NOW(self);
+	p   = (const char*)view.buf;
+	end = p + view.len;
+
+	/* mask is written directly into result */
+	if (!offsets) {
+		Py_BEGIN_ALLOW_THREADS
+		n = count_words(p, view.len, (const char*)sep.buf, sep.len);
+		Py_END_ALLOW_THREADS
+
+		result = PyByteArray_FromStringAndSize(NULL, n);
+		if (result == NULL)
+			goto cleanup;
+
+		mask = PyByteArray_AS_STRING(result);
+	}
+
+	cache = check_cache_get(module_of(self));
+	speller_lock(self);
+	fingerprint = Fingerprint(self);
+	aspell_ns = STATS_NOW(self);
+	Py_BEGIN_ALLOW_THREADS
+	for (i=0; p < end; i++) {
+		/* a writable buffer might be changed by another thread
+		   since words were counted */
+		if (mask && i == n)
+			break;
+
+		q = find_separator(p, end, (const char*)sep.buf, sep.len);
+		if (q - p > INT_MAX) {
+			toolong = 1;
+			break;
+		}
+
+		correct = -1;
+		if (q == p)
+			correct = 1;	/* empty line */
+		else if (cache)
+			correct = check_cache_lookup(cache, fingerprint, p, q - p);
+
+		if (correct < 0) {
+			correct = aspell_speller_check(Speller(self), p, (int)(q - p));
+			if (correct != 0 && correct != 1)
+				break;
+
+			if (cache)
+				check_cache_insert(cache, fingerprint, p, q - p, correct);
+		}
+
+		if (mask)
+			mask[i] = (char)correct;
+		else if (!correct) {
+			if (count == capacity) {
+				capacity = capacity ? 2*capacity : 256;
+				tmp = PyMem_RawRealloc(misspelled, capacity * sizeof(long long));
+				if (tmp == NULL) {
+					nomemory = 1;
+					break;
+				}
+				misspelled = tmp;
+			}
+
+			misspelled[count++] = p - (const char*)view.buf;
+		}
+
+		p = (q < end) ? q + sep.len : end;
+	}
+	Py_END_ALLOW_THREADS
+	aspell_ns = STATS_NOW(self) - aspell_ns;
+	check_cache_put(cache);
+
+	if (nomemory) {
+		speller_unlock(self);
+		PyErr_NoMemory();
+		Py_CLEAR(result);
+		goto cleanup;
+	}
+
+	if (toolong) {
+		speller_unlock(self);
+		PyErr_Format(PyExc_OverflowError, "word #%zd is too long", i);
+		Py_CLEAR(result);
+		goto cleanup;
+	}
+
+	if (mask && (correct == 0 || correct == 1) && (i != n || p < end)) {
+		speller_unlock(self);
+		PyErr_SetString(PyExc_RuntimeError, "buffer changed during checkBuffer()");
+		Py_CLEAR(result);
+		goto cleanup;
+	}
+
+	if (correct != 0 && correct != 1) {
+		PyErr_Format(SpellerError(self), "word #%zd: %s", i, aspell_speller_error_message(Speller(self)));
+		speller_unlock(self);
+		Py_CLEAR(result);
+		outcome = STATS_ERROR;
+		goto cleanup;
+	}
+	speller_unlock(self);
+
+	/* offsets are returned as array('q') */
+	if (offsets) {
+		bytes = PyBytes_FromStringAndSize((const char*)misspelled, count * sizeof(long long));
+		if (bytes == NULL)
+			goto cleanup;
+
+		array = PyImport_ImportModule("array");
+		if (array == NULL) {
+			Py_DECREF(bytes);
+			goto cleanup;
+		}
+
+		result = PyObject_CallMethod(array, "array", "sO", "q", bytes);
+		Py_DECREF(array);
+		Py_DECREF(bytes);
+	}
+
+cleanup:
+	PyMem_RawFree(misspelled);
+	PyBuffer_Release(&view);
+	PyBuffer_Release(&sep);
+
+	if (result)
+		outcome = STATS_OK;
+	stats_record(self, STATS_CHECK_BUFFER, i, aspell_ns, STATS_NOW(self) - t0 - (aspell_ns > 0 ? aspell_ns : 0), outcome);
+	return result;
+}
+
+/* helper function: converts offset/length of tokens found in an encoded
+   document into character offsets; tokens are sorted by offset */
+static PyObject* tokens2list(
+	PyObject* self,
+	const char* document,
+	const AspellToken* tokens,
+	Py_ssize_t count,
+	int decode
+) {
+	PyObject* list;
+	PyObject* item;
+	PyObject* segment;
+	Py_ssize_t i, j;
+	Py_ssize_t offset, length;
+	Py_ssize_t last_byte = 0;	/* position in document */
+	Py_ssize_t last_char = 0;	/* and corresponding character offset */
+	int utf8;
+
+	utf8 = (EncodingKind(self) == ENCODING_UTF8);
+
+	list = PyList_New(count);
+	if (list == NULL)
+		return NULL;
+
+	for (i=0; i < count; i++) {
+		offset = tokens[i].offset;
+		length = tokens[i].len;
+
+		if (decode) {
+			if (utf8) {
+				/* count bytes that are not continuation bytes */
+				for (j=last_byte; j < offset; j++)
+					last_char += ((document[j] & 0xc0) != 0x80);
+
+				length = 0;
+				for (j=offset; j < offset + (Py_ssize_t)tokens[i].len; j++)
+					length += ((document[j] & 0xc0) != 0x80);
+			}
+			else {
+				segment = decode_word(self, document + last_byte, offset - last_byte);
+				if (segment == NULL)
+					goto error;
+				last_char += PyUnicode_GET_LENGTH(segment);
+				Py_DECREF(segment);
+
+				segment = decode_word(self, document + offset, length);
+				if (segment == NULL)
+					goto error;
+				length = PyUnicode_GET_LENGTH(segment);
+				Py_DECREF(segment);
+			}
+
+			last_byte = offset;
+			offset = last_char;
+		}
+
+		item = Py_BuildValue("(nn)", offset, length);
+		if (item == NULL)
+			goto error;
+
+		PyList_SET_ITEM(list, i, item);
+	}
+
+	return list;
+
+error:
+	Py_DECREF(list);
+	return NULL;
+}
+
+/* helper function: creates document checker using given filter mode
+   (speller's mode if NULL); must be called with the speller's lock held.
+   On error sets exception, *aspell_error is set if aspell reported it */
+static AspellDocumentChecker* new_document_checker(PyObject* self, const char* mode, int* aspell_error) {
+	AspellConfig* config;
+	AspellCanHaveError* possible_error;
+	const char* value;
+	char* prev_mode = NULL;
+
+	*aspell_error = 0;
+
+	/* filters are set up from the speller's config when a checker is
+	   created, so mode is changed only for this moment */
+	config = aspell_speller_config(Speller(self));
+	if (mode) {
+		value = aspell_config_retrieve(config, "mode");
+		if (value) {
+			prev_mode = (char*)malloc(strlen(value)+1);
+			if (prev_mode == NULL) {
+				PyErr_NoMemory();
+				return NULL;
+			}
+			strcpy(prev_mode, value);
+		}
+
+		if (!aspell_config_replace(config, "mode", mode)) {
+			PyErr_SetString(ConfigError(self), aspell_config_error_message(config));
+			free(prev_mode);
+			*aspell_error = 1;
+			return NULL;
+		}
+	}
+
+	possible_error = new_aspell_document_checker(Speller(self));
+
+	if (prev_mode) {
+		aspell_config_replace(config, "mode", prev_mode);
+		free(prev_mode);
+	}
+
+	if (aspell_error_number(possible_error) != 0) {
+		PyErr_SetString(SpellerError(self), aspell_error_message(possible_error));
+		delete_aspell_can_have_error(possible_error);
+		*aspell_error = 1;
+		return NULL;
+	}
+
+	return to_aspell_document_checker(possible_error);
+}
+
+/* method:checkDocument *******************************************************/
+static PyObject* m_checkDocument(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"text", "mode", NULL};
+
+	PyObject* text;
+	PyObject* buf;
+	PyObject* result = NULL;
+	char* mode = NULL;
+	char* document;
+	Py_ssize_t length;
+	int aspell_error;
+
+	AspellDocumentChecker* checker = NULL;
+	AspellToken token;
+	AspellToken* tokens = NULL;
+	AspellToken* tmp;
+	Py_ssize_t count = 0;
+	Py_ssize_t capacity = 0;
+	int nomemory = 0;
+	int checked = 0;
+	long long t0, t1, aspell_ns = -1;
+	StatsOutcome outcome = STATS_EXCEPTION;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|z", kwlist, &text, &mode))
+		return NULL;
+
+	t0 = STATS_NOW(self);
+	buf = get_single_arg_string(self, text, &document, &length);
+	if (buf == NULL) {
+		stats_record(self, STATS_CHECK_DOCUMENT, 0, -1, STATS_NOW(self) - t0, outcome);
+		return NULL;
+	}
+
+	if (length > INT_MAX) {
+		Py_DECREF(buf);
+		PyErr_SetString(PyExc_ValueError, "document is too large");
+		stats_record(self, STATS_CHECK_DOCUMENT, 0, -1, STATS_NOW(self) - t0, outcome);
+		return NULL;
+	}
+
+	speller_lock(self);
+	t1 = STATS_NOW(self);
+
+	checker = new_document_checker(self, mode, &aspell_error);
+	if (checker == NULL) {
+		if (aspell_error)
+			outcome = STATS_ERROR;
+		goto cleanup;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	aspell_document_checker_process(checker, document, (int)length);
+	while (1) {
+		token = aspell_document_checker_next_misspelling(checker);
+		if (token.len == 0)
+			break;
+
+		if (count == capacity) {
+			capacity = capacity ? 2*capacity : 16;
+			tmp = PyMem_RawRealloc(tokens, capacity * sizeof(AspellToken));
+			if (tmp == NULL) {
+				nomemory = 1;
+				break;
+			}
+			tokens = tmp;
+		}
+
+		tokens[count++] = token;
+	}
+	Py_END_ALLOW_THREADS
+	aspell_ns = STATS_NOW(self) - t1;
+	checked = 1;
+
+cleanup:
+	if (checker)
+		delete_aspell_document_checker(checker);
+	speller_unlock(self);
+
+	/* tokens are offsets into the caller's document, thus they are
+	   converted after unlocking, see SuggestJob */
+	if (nomemory)
+		PyErr_NoMemory();
+	else
+	if (checked)
+		/* offsets of str are given in characters, of bytes -- in bytes */
+		result = tokens2list(self, document, tokens, count, PyUnicode_Check(text));
+
+	PyMem_RawFree(tokens);
+	Py_DECREF(buf);
+
+	if (result)
+		outcome = STATS_OK;
+	stats_record(self, STATS_CHECK_DOCUMENT, count, aspell_ns, STATS_NOW(self) - t0 - (aspell_ns > 0 ? aspell_ns : 0), outcome);
+	return result;
+}
+
+/* helper function: copies a word list under the speller's lock
+   and converts it into python list */
+static PyObject* get_word_list(
+	PyObject* self,
+	const AspellWordList* (*getter)(AspellSpeller*)
+) {
+	const AspellWordList* wordlist;
+	SuggestJob copy = {NULL, 0, NULL, 0, NULL};
+	PyObject* list = NULL;
+	int copied = 0;
+
+	speller_lock(self);
+	wordlist = getter(Speller(self));
+	if (wordlist == NULL)
+		PyErr_SetString(SpellerError(self), aspell_speller_error_message(Speller(self)));
+	else
+		copied = (copy_suggestions(&copy, wordlist) == 0);
+	speller_unlock(self);
+
+	if (copied)
+		list = job2list(self, &copy);
+	else
+	if (wordlist)
+		PyErr_NoMemory();
+
+	free(copy.suggestions);
+	return list;
+}
+
+/* helper function: parses limit and mode arguments of suggest */
+static int parse_suggest_options(
+	PyObject* limit_obj,	// [in] may be NULL or None
+	PyObject* mode_obj,		// [in] may be NULL or None
+	Py_ssize_t* limit,		// [out] -1 if not limited
+	const char** mode		// [out] NULL if not given
+) {
+	*limit = -1;
+	*mode = NULL;
+
+	if (limit_obj && limit_obj != Py_None) {
+		*limit = PyNumber_AsSsize_t(limit_obj, PyExc_OverflowError);
+		if (*limit == -1 && PyErr_Occurred())
+			return -1;
+
+		if (*limit < 0) {
+			PyErr_SetString(PyExc_ValueError, "limit must not be negative");
+			return -1;
+		}
+	}
+
+	if (mode_obj && mode_obj != Py_None) {
+		if (!PyUnicode_Check(mode_obj)) {
+			PyErr_SetString(PyExc_TypeError, "mode must be a string");
+			return -1;
+		}
+
+		*mode = PyUnicode_AsUTF8(mode_obj);
+		if (*mode == NULL)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* helper function: key of suggest cache; suggestions made in a mode
+   other than the speller's are stored as "mode\0word" */
+static char* suggest_cache_key(const char* mode, const char* word, Py_ssize_t length, Py_ssize_t* keylength) {
+	size_t n;
+	char* key;
+
+	n = strlen(mode) + 1;
+	key = PyMem_Malloc(n + length);
+	if (key == NULL) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+
+	memcpy(key, mode, n);
+	memcpy(key + n, word, length);
+	*keylength = n + length;
+	return key;
+}
+
+/* helper function: suggests at most limit words (all if limit < 0);
+   if mode is not NULL it's used as sug-mode only for this call */
+static PyObject* suggest_word(PyObject* self, PyObject* obj, Py_ssize_t limit, const char* mode) {
+	char* word;
+	Py_ssize_t length;
+	char* key = NULL;			/* cache key of a non-default mode */
+	const char* cachekey;
+	Py_ssize_t cachelength;
+	char* prev_mode = NULL;
+	const char* value;
+	AspellConfig* config = NULL;
+	PyObject* buf;
+	PyObject* list = NULL;
+	PyObject* cached = NULL;
+	const AspellWordList* wordlist;
+	SuggestJob copy = {NULL, 0, NULL, 0, NULL};
+	int copied = 0;
+	int cacheable = 0;
+	int shared = 0;				/* cached is referred by the cache */
+	unsigned long long generation = 0;
+	long long t, encode_ns, aspell_ns = -1;
+	StatsOutcome outcome = STATS_EXCEPTION;
+
+	t = STATS_NOW(self);
+	buf = get_single_arg_string(self, obj, &word, &length);
+	encode_ns = STATS_NOW(self) - t;
+	if (buf == NULL) {
+		stats_record(self, STATS_SUGGEST, 0, -1, encode_ns, STATS_EXCEPTION);
+		return NULL;
+	}
+
+	speller_lock(self);
+
+	if (mode) {
+		config = aspell_speller_config(Speller(self));
+		value = aspell_config_retrieve(config, "sug-mode");
+		if (value && strcmp(value, mode) == 0)
+			mode = NULL;	/* nothing to override */
+	}
+
+	cachekey = word;
+	cachelength = length;
+	if (mode) {
+		key = suggest_cache_key(mode, word, length, &cachelength);
+		if (key == NULL)
+			goto cleanup;
+
+		cachekey = key;
+	}
+
+	/* cached lists are never modified, the caller gets own copy
+	   made after unlocking */
+	cached = cache_lookup(SuggestCacheOf(self), cachekey, cachelength);
+	if (cached) {
+		Py_INCREF(cached);
+		shared = 1;
+		goto cleanup;
+	}
+
+	/* sug-mode is read by the speller on each suggestion, so it's changed
+	   only for this moment, like the mode in checkDocument */
+	if (mode) {
+		value = aspell_config_retrieve(config, "sug-mode");
+		if (value) {
+			prev_mode = (char*)malloc(strlen(value)+1);
+			if (prev_mode == NULL) {
+				PyErr_NoMemory();
+				goto cleanup;
+			}
+			strcpy(prev_mode, value);
+		}
+
+		if (!aspell_config_replace(config, "sug-mode", mode)) {
+			PyErr_SetString(ConfigError(self), aspell_config_error_message(config));
+			outcome = STATS_ERROR;
+			goto cleanup;
+		}
+	}
+
+	t = STATS_NOW(self);
+	Py_BEGIN_ALLOW_THREADS
+	wordlist = aspell_speller_suggest(Speller(self), word, length);
+	Py_END_ALLOW_THREADS
+	aspell_ns = STATS_NOW(self) - t;
+
+	if (wordlist == NULL) {
+		PyErr_SetString(SpellerError(self), aspell_speller_error_message(Speller(self)));
+		outcome = STATS_ERROR;
+	}
+	else {
+		/* the list is owned by speller, copy it before unlocking */
+		t = STATS_NOW(self);
+		copied = (copy_suggestions(&copy, wordlist) == 0);
+		if (!copied)
+			PyErr_NoMemory();
+
+		/* cached lists are complete, thus limit applies to the copy */
+		cacheable = (SuggestCacheOf(self)->nbuckets != 0);
+		generation = SuggestCacheOf(self)->generation;
+		if (!cacheable && limit >= 0 && limit < copy.count)
+			copy.count = limit;
+		encode_ns += STATS_NOW(self) - t;
+	}
+
+	if (prev_mode)
+		aspell_config_replace(config, "sug-mode", prev_mode);
+
+cleanup:
+	speller_unlock(self);
+
+	if (copied) {
+		t = STATS_NOW(self);
+		cached = job2list(self, &copy);
+		if (cached && cacheable) {
+			/* the result is dropped if the speller changed meanwhile */
+			speller_lock(self);
+			if (SuggestCacheOf(self)->generation == generation) {
+				cache_insert(SuggestCacheOf(self), cachekey, cachelength, cached);
+				shared = 1;
+			}
+			speller_unlock(self);
+		}
+		encode_ns += STATS_NOW(self) - t;
+	}
+
+	if (cached) {
+		if (limit < 0 || limit > PyList_GET_SIZE(cached))
+			limit = PyList_GET_SIZE(cached);
+
+		if (!shared && limit == PyList_GET_SIZE(cached))
+			list = cached;
+		else {
+			list = PyList_GetSlice(cached, 0, limit);
+			Py_DECREF(cached);
+		}
+	}
+
+	free(copy.suggestions);
+	free(prev_mode);
+	PyMem_Free(key);
+	Py_DECREF(buf);
+
+	if (list)
+		outcome = STATS_OK;
+	stats_record(self, STATS_SUGGEST, 1, aspell_ns, encode_ns, outcome);
+	return list;
+}
+
+static const char* const suggest_kwlist[] = {"word", "limit", "mode", NULL};
+
+/* method:suggest ************************************************************/
+static PyObject* m_suggest(PyObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames) {
+	PyObject* values[3];
+	Py_ssize_t limit;
+	const char* mode;
+
+	/* the common case: just a word */
+	if (nargs == 1 && kwnames == NULL)
+		return suggest_word(self, args[0], -1, NULL);
+
+	if (parse_fastcall("suggest", args, nargs, kwnames, suggest_kwlist, 1, values) < 0)
+		return NULL;
+
+	if (parse_suggest_options(values[1], values[2], &limit, &mode) < 0)
+		return NULL;
+
+	return suggest_word(self, values[0], limit, mode);
+}
+
+/* suggestMany ****************************************************************/
+
+/* Words are suggested in parallel by the speller itself and by additional
+   spellers (workers) with the same config. Workers are created on demand
+   and kept by the speller; before use their session word lists and
+   replacements are brought in sync with the speller. All threads run
+   without the GIL, results are converted once all of them finish. */
+
+/* helper function: appends replacement pair to the log */
+static int replacements_append(ReplacementLog* log, const char* mis, size_t ml, const char* cor, size_t cl) {
+	size_t needed;
+	char* tmp;
+
+	needed = log->used + 2*sizeof(size_t) + ml + cl;
+	if (needed > log->capacity) {
+		tmp = realloc(log->data, 2*needed);
+		if (tmp == NULL)
+			return -1;
+
+		log->data = tmp;
+		log->capacity = 2*needed;
+	}
+
+	memcpy(log->data + log->used, &ml, sizeof(size_t));
+	log->used += sizeof(size_t);
+	memcpy(log->data + log->used, mis, ml);
+	log->used += ml;
+	memcpy(log->data + log->used, &cl, sizeof(size_t));
+	log->used += sizeof(size_t);
+	memcpy(log->data + log->used, cor, cl);
+	log->used += cl;
+	return 0;
+}
+
+/* helper function: adds all words from a word list to speller,
+   add is aspell_speller_add_to_session or aspell_speller_add_to_personal */
+static void copy_words(
+	AspellSpeller* speller,
+	const AspellWordList* wordlist,
+	int (*add)(AspellSpeller*, const char*, int)
+) {
+	AspellStringEnumeration* elements;
+	const char* word;
+
+	if (wordlist == NULL)
+		return;
+
+	elements = aspell_word_list_elements(wordlist);
+	while ((word = aspell_string_enumeration_next(elements)) != NULL)
+		add(speller, word, -1);
+
+	delete_aspell_string_enumeration(elements);
+}
+
+/* helper function: stores replacements from the log, starting at given
+   position; returns position of the log's end */
+static size_t replay_replacements(AspellSpeller* speller, const ReplacementLog* log, size_t pos) {
+	size_t ml, cl;
+
+	for (/**/; pos < log->used; pos += 2*sizeof(size_t) + ml + cl) {
+		memcpy(&ml, log->data + pos, sizeof(size_t));
+		memcpy(&cl, log->data + pos + sizeof(size_t) + ml, sizeof(size_t));
+		aspell_speller_store_replacement(
+			speller,
+			log->data + pos + sizeof(size_t), (int)ml,
+			log->data + pos + 2*sizeof(size_t) + ml, (int)cl
+		);
+	}
+
+	return pos;
+}
+
+/* helper function: creates a speller with the same config as the given
+   one; doesn't need the GIL, on error message is copied into error */
+static AspellSpeller* new_speller_like(AspellSpeller* speller, char* error, size_t error_size) {
+	AspellConfig* config;
+	AspellCanHaveError* possible_error;
+
+	config = aspell_config_clone(aspell_speller_config(speller));
+	if (config == NULL) {
+		strncpy(error, "can't create config", error_size - 1);
+		return NULL;
+	}
+
+	possible_error = new_aspell_speller(config);
+	delete_aspell_config(config);
+	if (aspell_error_number(possible_error) != 0) {
+		strncpy(error, aspell_error_message(possible_error), error_size - 1);
+		delete_aspell_can_have_error(possible_error);
+		return NULL;
+	}
+
+	return to_aspell_speller(possible_error);
+}
+
+static void delete_workers(aspell_AspellObject* self) {
+	Py_ssize_t i;
+
+	for (i=0; i < self->nworkers; i++)
+		delete_aspell_speller(self->workers[i].speller);
+
+	free(self->workers);
+	self->workers = NULL;
+	self->nworkers = 0;
+}
+
+/* helper function: makes at least n workers ready for use; must be called
+   with the speller's lock held, doesn't need the GIL; returns number of
+   ready workers, on error message is copied into error */
+static Py_ssize_t prepare_workers(aspell_AspellObject* self, Py_ssize_t n, char* error, size_t error_size) {
+	SuggestWorker* worker;
+	SuggestWorker* tmp;
+	AspellSpeller* speller;
+	Py_ssize_t i;
+
+	/* config changed - workers are useless */
+	if (self->nworkers > 0 && self->workers_config != self->config_hash)
+		delete_workers(self);
+
+	if (n > self->nworkers) {
+		tmp = realloc(self->workers, n * sizeof(SuggestWorker));
+		if (tmp == NULL) {
+			strncpy(error, "out of memory", error_size - 1);
+			return -1;
+		}
+		self->workers = tmp;
+
+		while (self->nworkers < n) {
+			speller = new_speller_like(self->speller, error, error_size);
+			if (speller == NULL)
+				return -1;
+
+			worker = &self->workers[self->nworkers++];
+			worker->speller = speller;
+			worker->private_id = 0;	/* same state as a fresh speller */
+			worker->replayed = 0;
+		}
+
+		self->workers_config = self->config_hash;
+	}
+
+	for (i=0; i < n; i++) {
+		worker = &self->workers[i];
+
+		/* session and personal words of the speller go to worker's session */
+		if (worker->private_id != self->private_id) {
+			aspell_speller_clear_session(worker->speller);
+			copy_words(worker->speller, aspell_speller_session_word_list(self->speller), aspell_speller_add_to_session);
+			copy_words(worker->speller, aspell_speller_personal_word_list(self->speller), aspell_speller_add_to_session);
+			worker->private_id = self->private_id;
+		}
+
+		worker->replayed = replay_replacements(worker->speller, &self->replacements, worker->replayed);
+	}
+
+	return n;
+}
+
+typedef struct {
+	SuggestJob* jobs;
+	Py_ssize_t njobs;
+	Py_ssize_t next;			/* next job to take, guarded by mutex */
+	Py_ssize_t running;			/* number of running threads, guarded by mutex */
+	PyThread_type_lock mutex;
+	PyThread_type_lock done;	/* released by the last thread */
+} SuggestBatch;
+
+typedef struct {
+	SuggestBatch* batch;
+	AspellSpeller* speller;
+} SuggestThread;
+
+static void suggest_thread(void* arg) {
+	SuggestThread* thread = (SuggestThread*)arg;
+	SuggestBatch* batch = thread->batch;
+	const AspellWordList* wordlist;
+	SuggestJob* job;
+	Py_ssize_t i;
+	int last;
+
+	while (1) {
+		PyThread_acquire_lock(batch->mutex, WAIT_LOCK);
+		i = batch->next < batch->njobs ? batch->next++ : -1;
+		PyThread_release_lock(batch->mutex);
+
+		if (i < 0)
+			break;
+
+		job = &batch->jobs[i];
+		wordlist = aspell_speller_suggest(thread->speller, job->word, job->length);
+		if (wordlist == NULL)
+			job->error = copy_string(aspell_speller_error_message(thread->speller));
+		else
+		if (copy_suggestions(job, wordlist) < 0)
+			job->error = copy_string("out of memory");
+	}
+
+	PyThread_acquire_lock(batch->mutex, WAIT_LOCK);
+	last = (--batch->running == 0);
+	PyThread_release_lock(batch->mutex);
+
+	if (last)
+		PyThread_release_lock(batch->done);
+}
+
+/* helper function: runs jobs on n spellers; the calling thread uses
+   speller of self, the others use workers */
+static void run_suggest_batch(aspell_AspellObject* self, SuggestBatch* batch, Py_ssize_t nthreads) {
+	SuggestThread* threads;
+	Py_ssize_t i;
+
+	threads = malloc(nthreads * sizeof(SuggestThread));
+	if (threads == NULL)
+		nthreads = 1;
+
+	batch->next = 0;
+	batch->running = 1;
+	PyThread_acquire_lock(batch->done, WAIT_LOCK);
+
+	for (i=1; i < nthreads; i++) {
+		threads[i].batch = batch;
+		threads[i].speller = self->workers[i - 1].speller;
+
+		PyThread_acquire_lock(batch->mutex, WAIT_LOCK);
+		batch->running += 1;
+		PyThread_release_lock(batch->mutex);
+
+		if (PyThread_start_new_thread(suggest_thread, &threads[i]) == (unsigned long)-1) {
+			/* remaining jobs will be done by already running threads */
+			PyThread_acquire_lock(batch->mutex, WAIT_LOCK);
+			batch->running -= 1;
+			PyThread_release_lock(batch->mutex);
+			break;
+		}
+	}
+
+	if (threads == NULL) {
+		SuggestThread thread = {batch, self->speller};
+		suggest_thread(&thread);
+	}
+	else {
+		threads[0].batch = batch;
+		threads[0].speller = self->speller;
+		suggest_thread(&threads[0]);
+	}
+
+	/* wait for the others */
+	PyThread_acquire_lock(batch->done, WAIT_LOCK);
+	PyThread_release_lock(batch->done);
+	free(threads);
+}
+
+/* method:suggestMany *********************************************************/
+static PyObject* m_suggestMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"words", "threads", NULL};
+	aspell_AspellObject* obj = (aspell_AspellObject*)self;
+	PyObject* words;
+	PyObject* threads_arg = Py_None;
+	PyObject* seq = NULL;
+	PyObject* result = NULL;
+	PyObject* unique = NULL;	/* encoded word => index of job */
+	PyObject** bufs = NULL;
+	PyObject** lists = NULL;	/* results of jobs */
+	Py_ssize_t* job_of = NULL;	/* index of job for each word */
+	SuggestJob* jobs = NULL;
+	SuggestBatch batch;
+	Py_ssize_t n, i, j, k, njobs = 0, nthreads;
+	PyObject* key;
+	PyObject* index;
+	char* word;
+	Py_ssize_t length;
+	char error[256];
+	int cacheable;
+	unsigned long long generation;
+	long long t0, aspell_ns = -1;
+	StatsOutcome outcome = STATS_EXCEPTION;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist, &words, &threads_arg))
+		return NULL;
+
+	t0 = STATS_NOW(self);
+	batch.jobs = NULL;
+	batch.njobs = 0;
+	n = 0;
+
+	/* each additional thread needs own speller with a whole dictionary
+	   loaded, thus threads are used only when asked for */
+	if (threads_arg == Py_None)
+		nthreads = 1;
+	else {
+		nthreads = PyNumber_AsSsize_t(threads_arg, PyExc_OverflowError);
+		if (nthreads == -1 && PyErr_Occurred())
+			return NULL;
+
+		if (nthreads < 1) {
+			PyErr_SetString(PyExc_ValueError, "number of threads must be positive");
+			return NULL;
+		}
+	}
+
+	seq = PySequence_Fast(words, "words must be a sequence");
+	if (seq == NULL)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE(seq);
+	bufs   = PyMem_Calloc(n + 1, sizeof(PyObject*));
+	lists  = PyMem_Calloc(n + 1, sizeof(PyObject*));
+	job_of = PyMem_Malloc((n + 1) * sizeof(Py_ssize_t));
+	jobs   = PyMem_Calloc(2*n + 1, sizeof(SuggestJob));	/* unique words + jobs to run */
+	unique = PyDict_New();
+	if (bufs == NULL || lists == NULL || job_of == NULL || jobs == NULL || unique == NULL) {
+		PyErr_NoMemory();
+		goto done;
+	}
+
+	/* encode words, identical words share a job */
+	for (i=0; i < n; i++) {
+		bufs[i] = get_single_arg_string(self, PySequence_Fast_GET_ITEM(seq, i), &word, &length);
+		if (bufs[i] == NULL) {
+			if (PyErr_ExceptionMatches(PyExc_TypeError)) {
+				PyErr_Clear();
+				PyErr_Format(PyExc_TypeError, "word #%zd: string or bytes required", i);
+			}
+			goto done;
+		}
+
+		key = PyBytes_FromStringAndSize(word, length);
+		if (key == NULL)
+			goto done;
+
+		index = PyDict_GetItemWithError(unique, key);
+		if (index) {
+			job_of[i] = PyLong_AsSsize_t(index);
+			Py_DECREF(key);
+			continue;
+		}
+		else if (PyErr_Occurred()) {
+			Py_DECREF(key);
+			goto done;
+		}
+
+		index = PyLong_FromSsize_t(njobs);
+		if (index == NULL || PyDict_SetItem(unique, key, index) < 0) {
+			Py_XDECREF(index);
+			Py_DECREF(key);
+			goto done;
+		}
+		Py_DECREF(index);
+		Py_DECREF(key);
+
+		jobs[njobs].word = word;
+		jobs[njobs].length = length;
+		job_of[i] = njobs++;
+	}
+
+	speller_lock(self);
+
+	/* words found in the suggestions cache are not sent to threads;
+	   python objects are created only after unlocking, see SuggestJob */
+	cacheable = (SuggestCacheOf(self)->nbuckets != 0);
+	for (i=0; i < njobs; i++) {
+		lists[i] = cache_lookup(SuggestCacheOf(self), jobs[i].word, jobs[i].length);
+		Py_XINCREF(lists[i]);
+	}
+
+	/* remaining jobs are packed after the unique words */
+	batch.jobs = jobs + njobs;
+	for (i=0; i < njobs; i++)
+		if (lists[i] == NULL)
+			batch.jobs[batch.njobs++] = jobs[i];
+
+	if (nthreads > batch.njobs)
+		nthreads = batch.njobs > 0 ? batch.njobs : 1;
+
+	error[0] = '\0';
+	if (batch.njobs > 0) {
+		batch.mutex = PyThread_allocate_lock();
+		batch.done  = PyThread_allocate_lock();
+		if (batch.mutex == NULL || batch.done == NULL) {
+			if (batch.mutex) PyThread_free_lock(batch.mutex);
+			if (batch.done) PyThread_free_lock(batch.done);
+			speller_unlock(self);
+			PyErr_NoMemory();
+			goto done;
+		}
+
+		aspell_ns = STATS_NOW(self);
+		Py_BEGIN_ALLOW_THREADS
+		if (nthreads > 1 && prepare_workers(obj, nthreads - 1, error, sizeof(error)) < 0)
+			nthreads = 0;
+		else
+			run_suggest_batch(obj, &batch, nthreads);
+		Py_END_ALLOW_THREADS
+		aspell_ns = STATS_NOW(self) - aspell_ns;
+
+		PyThread_free_lock(batch.mutex);
+		PyThread_free_lock(batch.done);
+	}
+
+	generation = SuggestCacheOf(self)->generation;
+	speller_unlock(self);
+
+	if (nthreads == 0) {
+		error[sizeof(error) - 1] = '\0';
+		PyErr_SetString(SpellerError(self), error);
+		outcome = STATS_ERROR;
+		goto done;
+	}
+
+	/* convert results */
+	for (i=0, j=0; i < njobs; i++) {
+		if (lists[i])
+			continue;
+
+		if (batch.jobs[j].error) {
+			for (k=0; job_of[k] != i; k++);
+			PyErr_Format(SpellerError(self), "word #%zd: %s", k, batch.jobs[j].error);
+			outcome = STATS_ERROR;
+			goto done;
+		}
+
+		lists[i] = job2list(self, &batch.jobs[j++]);
+		if (lists[i] == NULL)
+			goto done;
+	}
+
+	/* fill the cache, unless the speller changed meanwhile */
+	if (cacheable && batch.njobs > 0) {
+		speller_lock(self);
+		/* the batch keeps order of jobs */
+		if (SuggestCacheOf(self)->generation == generation)
+			for (i=0, j=0; i < njobs && j < batch.njobs; i++)
+				if (jobs[i].word == batch.jobs[j].word) {
+					cache_insert(SuggestCacheOf(self), jobs[i].word, jobs[i].length, lists[i]);
+					j++;
+				}
+		speller_unlock(self);
+	}
+
+	/* each word gets own list, lists of the cache are copied */
+	result = PyList_New(n);
+	if (result == NULL)
+		goto done;
+
+	for (i=0, k=0; i < n; i++) {
+		j = job_of[i];
+		if (j == k && !cacheable) {
+			/* first occurrence of word (jobs are numbered in order) */
+			Py_INCREF(lists[j]);
+			PyList_SET_ITEM(result, i, lists[j]);
+			k++;
+		}
+		else {
+			PyList_SET_ITEM(result, i, PyList_GetSlice(lists[j], 0, PyList_GET_SIZE(lists[j])));
+			if (PyList_GET_ITEM(result, i) == NULL) {
+				Py_CLEAR(result);
+				goto done;
+			}
+		}
+	}
+
+done:
+	for (i=0; i < batch.njobs; i++) {
+		free(batch.jobs[i].suggestions);
+		free(batch.jobs[i].error);
+	}
+
+	if (bufs)
+		for (i=0; i < n; i++)
+			Py_XDECREF(bufs[i]);
+
+	if (lists)
+		for (i=0; i < njobs; i++)
+			Py_XDECREF(lists[i]);
+
+	PyMem_Free(bufs);
+	PyMem_Free(lists);
+	PyMem_Free(job_of);
+	PyMem_Free(jobs);
+	Py_XDECREF(unique);
+	Py_XDECREF(seq);
+
+	if (result)
+		outcome = STATS_OK;
+	stats_record(self, STATS_SUGGEST_MANY, n, aspell_ns, STATS_NOW(self) - t0 - (aspell_ns > 0 ? aspell_ns : 0), outcome);
+	return result;
+}
+
+/* method:getMainwordlist *****************************************************/
+static PyObject* m_getMainwordlist(PyObject* self, PyObject* args) {
+	return get_word_list(self, aspell_speller_main_word_list);
+}
+
+/* method:getPersonalwordlist *************************************************/
+static PyObject* m_getPersonalwordlist(PyObject* self, PyObject* args) {
+	return get_word_list(self, aspell_speller_personal_word_list);
+}
+
+/* method:getSessionwordlist **************************************************/
+static PyObject* m_getSessionwordlist(PyObject* self, PyObject* args) {
+	return get_word_list(self, aspell_speller_session_word_list);
+}
+
+/* Word list iterator *********************************************************/
+
+/* Iterates lazily over a speller's word list; words are decoded in
+   chunks under the speller's lock. Session and personal lists must
+   not change during iteration, it is detected by comparing speller's
+   private_id, which changes with each modification of word lists. */
+
+#define WORDLIST_CHUNK 256
+
+typedef struct {
+	PyObject_HEAD
+	PyObject* speller;
+	AspellStringEnumeration* elements;
+	unsigned long long private_id;
+	PyObject* chunk;		/* decoded words */
+	Py_ssize_t pos;			/* next word in chunk */
+	int exhausted;
+} aspell_WordlistIterObject;
+
+#define WordlistIter(pyobject) ((aspell_WordlistIterObject*)pyobject)
+
+/* helper function: creates an iterator over word list */
+static PyObject* iter_word_list(
+	PyObject* self,
+	const AspellWordList* (*getter)(AspellSpeller*)
+) {
+	PyTypeObject* type;
+	aspell_WordlistIterObject* iter;
+	const AspellWordList* wordlist;
+
+	type = state_of(self)->wordlist_iter_type;
+	iter = (aspell_WordlistIterObject*)type->tp_alloc(type, 0);
+	if (iter == NULL)
+		return NULL;
+
+	Py_INCREF(self);
+	iter->speller	= self;
+	iter->elements	= NULL;
+	iter->chunk		= NULL;
+	iter->pos		= 0;
+	iter->exhausted	= 0;
+
+	speller_lock(self);
+	wordlist = getter(Speller(self));
+	if (wordlist == NULL)
+		PyErr_SetString(SpellerError(self), aspell_speller_error_message(Speller(self)));
+	else
+		iter->elements = aspell_word_list_elements(wordlist);
+
+	iter->private_id = ((aspell_AspellObject*)self)->private_id;
+	speller_unlock(self);
+
+	if (iter->elements == NULL) {
+		Py_DECREF(iter);
+		return NULL;
+	}
+
+	return (PyObject*)iter;
+}
+
+static void wordlist_iter_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	aspell_WordlistIterObject* iter = WordlistIter(self);
+
+	PyObject_GC_UnTrack(self);
+	if (iter->elements) {
+		speller_lock(iter->speller);
+		delete_aspell_string_enumeration(iter->elements);
+		speller_unlock(iter->speller);
+	}
+
+	Py_XDECREF(iter->chunk);
+	Py_XDECREF(iter->speller);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+/* the speller is needed until the enumeration is deleted, thus it's
+   released only by dealloc */
+static int wordlist_iter_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(WordlistIter(self)->speller);
+	Py_VISIT(WordlistIter(self)->chunk);
+	return 0;
+}
+
+/* helper function: decodes next chunk of words */
+static int wordlist_iter_fill(aspell_WordlistIterObject* iter) {
+	PyObject* self = iter->speller;
+	SuggestJob copy = {NULL, 0, NULL, 0, NULL};
+	int changed, result;
+
+	Py_CLEAR(iter->chunk);
+	iter->pos = 0;
+
+	/* words are copied under the lock and decoded after unlocking */
+	speller_lock(self);
+	changed = (((aspell_AspellObject*)self)->private_id != iter->private_id);
+	result = changed ? 0 : copy_strings(&copy, iter->elements, WORDLIST_CHUNK);
+	speller_unlock(self);
+
+	if (changed) {
+		PyErr_SetString(PyExc_RuntimeError, "word list changed during iteration");
+		return -1;
+	}
+
+	if (result < 0) {
+		free(copy.suggestions);
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	if (copy.count < WORDLIST_CHUNK)
+		iter->exhausted = 1;
+
+	iter->chunk = job2list(self, &copy);
+	free(copy.suggestions);
+	return iter->chunk ? 0 : -1;
+}
+
+/* must be called within a critical section on the iterator */
+static PyObject* wordlist_iter_next_locked(PyObject* self) {
+	aspell_WordlistIterObject* iter = WordlistIter(self);
+	PyObject* word;
+
+	if (iter->chunk == NULL || iter->pos == PyList_GET_SIZE(iter->chunk)) {
+		if (iter->exhausted)
+			return NULL;
+
+		if (wordlist_iter_fill(iter) < 0)
+			return NULL;
+
+		if (PyList_GET_SIZE(iter->chunk) == 0)
+			return NULL;
+	}
+
+	word = PyList_GET_ITEM(iter->chunk, iter->pos++);
+	Py_INCREF(word);
+	return word;
+}
+
+static PyObject* wordlist_iter_next(PyObject* self) {
+	PyObject* word;
+
+	Py_BEGIN_CRITICAL_SECTION(self);
+	word = wordlist_iter_next_locked(self);
+	Py_END_CRITICAL_SECTION();
+
+	return word;
+}
+
+static PyType_Slot wordlist_iter_slots[] = {
+	{Py_tp_dealloc, wordlist_iter_dealloc},
+	{Py_tp_traverse, wordlist_iter_traverse},
+	{Py_tp_iter, PyObject_SelfIter},
+	{Py_tp_iternext, wordlist_iter_next},
+	{0, NULL}
+};
+
+static PyType_Spec wordlist_iter_spec = {
+	"aspell.WordlistIterator",
+	sizeof(aspell_WordlistIterObject),
+	0,
+	ASPELL_TPFLAGS | ASPELL_TPFLAGS_NOINIT,
+	wordlist_iter_slots
+};
+
+/* method:iterMainwordlist ****************************************************/
+static PyObject* m_iterMainwordlist(PyObject* self, PyObject* args) {
+	return iter_word_list(self, aspell_speller_main_word_list);
+}
+
+/* method:iterPersonalwordlist ************************************************/
+static PyObject* m_iterPersonalwordlist(PyObject* self, PyObject* args) {
+	return iter_word_list(self, aspell_speller_personal_word_list);
+}
+
+/* method:iterSessionwordlist *************************************************/
+static PyObject* m_iterSessionwordlist(PyObject* self, PyObject* args) {
+	return iter_word_list(self, aspell_speller_session_word_list);
+}
+
+/* Memory mapped files ********************************************************/
+
+typedef struct {
+	const unsigned char* data;	/* NULL for an empty file */
+	size_t size;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+} MappedFile;
+
+/* helper function: maps whole file read-only; returns errno value on error */
+static int map_file(MappedFile* self, const char* path) {
+#ifdef _WIN32
+	HANDLE file;
+	LARGE_INTEGER size;
+	int error = 0;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return ENOENT;
+
+	if (!GetFileSizeEx(file, &size))
+		error = EIO;
+	else
+	if (size.QuadPart > 0) {
+		self->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (self->mapping == NULL)
+			error = EIO;
+		else {
+			self->data = MapViewOfFile(self->mapping, FILE_MAP_READ, 0, 0, 0);
+			if (self->data == NULL) {
+				CloseHandle(self->mapping);
+				self->mapping = NULL;
+				error = EIO;
+			}
+			else
+				self->size = (size_t)size.QuadPart;
+		}
+	}
+
+	CloseHandle(file);
+	return error;
+#else
+	struct stat info;
+	void* data;
+	int fd;
+	int error = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return errno;
+
+	if (fstat(fd, &info) < 0)
+		error = errno;
+	else
+	if (info.st_size > 0) {
+		data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+			error = errno;
+		else {
+			self->data = data;
+			self->size = (size_t)info.st_size;
+		}
+	}
+
+	close(fd);
+	return error;
+#endif
+}
+
+static void unmap_file(MappedFile* self) {
+	if (self->data == NULL)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(self->data);
+	CloseHandle(self->mapping);
+#else
+	munmap((void*)self->data, self->size);
+#endif
+	self->data = NULL;
+}
+
+/* helper function: tells the system that pages in [start, end) won't be
+   read again, thus they don't stay in the process's resident set; start
+   is page aligned, returns end rounded down to page, i.e. the next start */
+static size_t release_mapped_range(MappedFile* self, size_t start, size_t end) {
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	end = end / page * page;
+	if (start < end)
+		madvise((void*)(self->data + start), end - start, MADV_DONTNEED);
+
+	return end;
+#else
+	return start;
+#endif
+}
+
+/* File checker ***************************************************************/
+
+/* Iterates over misspellings in a memory mapped file. The file is passed
+   line by line to aspell's document checker, which tokenizes it and
+   applies filters; lines are scanned in chunks with the GIL released and
+   the speller's lock held. Only misspellings of the current chunk are kept,
+   and pages already scanned are released, so memory use doesn't depend
+   on file size. */
+
+#define FILE_CHECKER_CHUNK		(1 << 20)	/* bytes scanned at once */
+#define FILE_CHECKER_RECORDS	1024		/* misspellings found at once */
+#define FILE_CHECKER_PIECE		(1 << 16)	/* longer lines are split */
+
+typedef struct {
+	size_t offset;		/* in bytes, from start of file */
+	size_t line;		/* 1-based */
+	unsigned int length;
+} FileMisspelling;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject* speller;
+	MappedFile file;
+	AspellDocumentChecker* checker;
+	size_t position;	/* start of the next piece to scan */
+	size_t line;		/* line of position */
+	size_t released;	/* pages before this offset were released */
+	FileMisspelling* found;
+	Py_ssize_t count;	/* misspellings in found */
+	Py_ssize_t capacity;
+	Py_ssize_t next;	/* next misspelling returned */
+	unsigned long long words;	/* blank separated words scanned */
+	int busy;			/* chunk is being scanned */
+} aspell_FileCheckerObject;
+
+#define FileChecker(pyobject) ((aspell_FileCheckerObject*)pyobject)
+
+static void file_checker_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	aspell_FileCheckerObject* iter = FileChecker(self);
+
+	PyObject_GC_UnTrack(self);
+	if (iter->checker) {
+		speller_lock(iter->speller);
+		delete_aspell_document_checker(iter->checker);
+		speller_unlock(iter->speller);
+	}
+
+	unmap_file(&iter->file);
+	PyMem_RawFree(iter->found);
+	Py_XDECREF(iter->speller);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+/* like the word list iterator, keeps the speller until dealloc */
+static int file_checker_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(FileChecker(self)->speller);
+	return 0;
+}
+
+/* helper function: returns end of the next piece passed to aspell: end
+   of line or, for very long lines, the last blank before the limit
+   (aspell requires text to be split on white space only) */
+static size_t file_checker_piece(aspell_FileCheckerObject* iter, size_t* next) {
+	const char* data = (const char*)iter->file.data;
+	size_t start = iter->position;
+	size_t limit = iter->file.size - start;
+	const char* eol;
+	size_t end;
+
+	if (limit > FILE_CHECKER_PIECE)
+		limit = FILE_CHECKER_PIECE;
+
+	eol = memchr(data + start, '\n', limit);
+	if (eol) {
+		end = eol - data;
+		*next = end + 1;
+		return end;
+	}
+
+	end = start + limit;
+	if (end < iter->file.size) {
+		while (end > start && data[end - 1] != ' ' && data[end - 1] != '\t')
+			end--;
+
+		/* a single huge word: it ends at the next blank */
+		if (end == start) {
+			end = start + limit;
+			while (end < iter->file.size && data[end] != ' ' && data[end] != '\t' && data[end] != '\n')
+				end++;
+		}
+	}
+
+	*next = end;
+	return end;
+}
+
+/* helper function: counts blank separated words in [p, end) */
+static unsigned long long count_blank_separated(const char* p, const char* end) {
+	unsigned long long n = 0;
+	int blank = 1;
+	int c;
+
+	for (; p < end; p++) {
+		c = *p;
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v')
+			blank = 1;
+		else {
+			n += blank;
+			blank = 0;
+		}
+	}
+
+	return n;
+}
+
+/* helper function: scans next chunk of file; must be called without the GIL
+   and with the speller's lock held; returns 0 or -1 if there is no memory */
+static int file_checker_scan(aspell_FileCheckerObject* iter) {
+	AspellToken token;
+	FileMisspelling* tmp;
+	size_t start = iter->position;
+	size_t end, next;
+
+	iter->count = 0;
+	iter->next = 0;
+
+	while (iter->position < iter->file.size
+	    && iter->position - start < FILE_CHECKER_CHUNK
+	    && iter->count < FILE_CHECKER_RECORDS) {
+
+		end = file_checker_piece(iter, &next);
+		iter->words += count_blank_separated((const char*)iter->file.data + iter->position, (const char*)iter->file.data + end);
+		aspell_document_checker_process(iter->checker, (const char*)iter->file.data + iter->position, (int)(end - iter->position));
+
+		while (1) {
+			token = aspell_document_checker_next_misspelling(iter->checker);
+			if (token.len == 0)
+				break;
+
+			if (iter->count == iter->capacity) {
+				iter->capacity = iter->capacity ? 2*iter->capacity : FILE_CHECKER_RECORDS;
+				tmp = PyMem_RawRealloc(iter->found, iter->capacity * sizeof(FileMisspelling));
+				if (tmp == NULL)
+					return -1;
+
+				iter->found = tmp;
+			}
+
+			iter->found[iter->count].offset = iter->position + token.offset;
+			iter->found[iter->count].line = iter->line;
+			iter->found[iter->count].length = token.len;
+			iter->count += 1;
+		}
+
+		if (next > end)
+			iter->line += 1;
+
+		iter->position = next;
+	}
+
+	return 0;
+}
+
+/* must be called within a critical section on the checker; it's
+   suspended while a chunk is scanned, then flag busy guards the state */
+static PyObject* file_checker_next_locked(PyObject* self) {
+	aspell_FileCheckerObject* iter = FileChecker(self);
+	FileMisspelling* m;
+	PyObject* word;
+	int result;
+
+	while (iter->next == iter->count) {
+		if (iter->position >= iter->file.size)
+			return NULL;
+
+		if (iter->busy) {
+			PyErr_SetString(PyExc_RuntimeError, "file checker is already used by another thread");
+			return NULL;
+		}
+
+		/* all words of the previous chunk were returned, so its pages
+		   aren't needed anymore */
+		iter->released = release_mapped_range(&iter->file, iter->released, iter->position);
+
+		iter->busy = 1;
+		speller_lock(iter->speller);
+		Py_BEGIN_ALLOW_THREADS
+		result = file_checker_scan(iter);
+		Py_END_ALLOW_THREADS
+		speller_unlock(iter->speller);
+		iter->busy = 0;
+
+		if (result < 0) {
+			iter->count = iter->next = 0;
+			return PyErr_NoMemory();
+		}
+	}
+
+	m = &iter->found[iter->next++];
+	word = decode_word(iter->speller, (const char*)iter->file.data + m->offset, m->length);
+	if (word == NULL)
+		return NULL;
+
+	return Py_BuildValue("(KKN)", (unsigned long long)m->offset, (unsigned long long)m->line, word);
+}
+
+static PyObject* file_checker_next(PyObject* self) {
+	PyObject* result;
+
+	Py_BEGIN_CRITICAL_SECTION(self);
+	result = file_checker_next_locked(self);
+	Py_END_CRITICAL_SECTION();
+
+	return result;
+}
+
+/* attribute:position *********************************************************/
+static PyObject* file_checker_position(PyObject* self, void* closure) {
+	return PyLong_FromSize_t(FileChecker(self)->position);
+}
+
+/* attribute:words ************************************************************/
+static PyObject* file_checker_words(PyObject* self, void* closure) {
+	return PyLong_FromUnsignedLongLong(FileChecker(self)->words);
+}
+
+static PyGetSetDef aspell_file_checker_getset[] = {
+	{"position", (getter)file_checker_position, NULL, "bytes of file scanned so far", NULL},
+	{"words", (getter)file_checker_words, NULL, "number of blank separated words scanned so far", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot file_checker_slots[] = {
+	{Py_tp_dealloc, file_checker_dealloc},
+	{Py_tp_traverse, file_checker_traverse},
+	{Py_tp_iter, PyObject_SelfIter},
+	{Py_tp_iternext, file_checker_next},
+	{Py_tp_getset, aspell_file_checker_getset},
+	{0, NULL}
+};
+
+static PyType_Spec file_checker_spec = {
+	"aspell.FileChecker",
+	sizeof(aspell_FileCheckerObject),
+	0,
+	ASPELL_TPFLAGS | ASPELL_TPFLAGS_NOINIT,
+	file_checker_slots
+};
+
+/* method:checkFile ***********************************************************/
+static PyObject* m_checkFile(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"path", "mode", NULL};
+	PyTypeObject* type;
+	aspell_FileCheckerObject* iter;
+	PyObject* path;
+	char* mode = NULL;
+	int error;
+	int aspell_error;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|z", kwlist, PyUnicode_FSConverter, &path, &mode))
+		return NULL;
+
+	type = state_of(self)->file_checker_type;
+	iter = (aspell_FileCheckerObject*)type->tp_alloc(type, 0);
+	if (iter == NULL) {
+		Py_DECREF(path);
+		return NULL;
+	}
+
+	Py_INCREF(self);
+	iter->speller	= self;
+	memset(&iter->file, 0, sizeof(MappedFile));
+	iter->checker	= NULL;
+	iter->position	= 0;
+	iter->line		= 1;
+	iter->released	= 0;
+	iter->found		= NULL;
+	iter->count		= 0;
+	iter->capacity	= 0;
+	iter->next		= 0;
+	iter->words		= 0;
+	iter->busy		= 0;
+
+	Py_BEGIN_ALLOW_THREADS
+	error = map_file(&iter->file, PyBytes_AS_STRING(path));
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+	if (error == 0 && iter->file.data)
+		madvise((void*)iter->file.data, iter->file.size, MADV_SEQUENTIAL);
+#endif
+	Py_END_ALLOW_THREADS
+
+	if (error) {
+		errno = error;
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		Py_DECREF(iter);
+		return NULL;
+	}
+	Py_DECREF(path);
+
+	speller_lock(self);
+	iter->checker = new_document_checker(self, mode, &aspell_error);
+	speller_unlock(self);
+
+	if (iter->checker == NULL) {
+		Py_DECREF(iter);
+		return NULL;
+	}
+
+	return (PyObject*)iter;
+}
+
+/* helper function: returns size of word list */
+static PyObject* word_list_size(
+	PyObject* self,
+	const AspellWordList* (*getter)(AspellSpeller*)
+) {
+	const AspellWordList* wordlist;
+	unsigned int size = 0;
+
+	speller_lock(self);
+	wordlist = getter(Speller(self));
+	if (wordlist != NULL && !aspell_word_list_empty(wordlist))
+		size = aspell_word_list_size(wordlist);
+	speller_unlock(self);
+
+	if (wordlist == NULL) {
+		PyErr_SetString(SpellerError(self), "can't get word list");
+		return NULL;
+	}
+
+	return PyLong_FromUnsignedLong(size);
+}
+
+/* method:getMainwordlistSize *************************************************/
+static PyObject* m_getMainwordlistSize(PyObject* self, PyObject* args) {
+	return word_list_size(self, aspell_speller_main_word_list);
+}
+
+/* method:getPersonalwordlistSize *********************************************/
+static PyObject* m_getPersonalwordlistSize(PyObject* self, PyObject* args) {
+	return word_list_size(self, aspell_speller_personal_word_list);
+}
+
+/* method:getSessionwordlistSize **********************************************/
+static PyObject* m_getSessionwordlistSize(PyObject* self, PyObject* args) {
+	return word_list_size(self, aspell_speller_session_word_list);
+}
+
+/* check for any aspell error after a lib call
+   and either raises exception one or returns none;
+   must be called with the speller's lock held */
+static PyObject* AspellCheckError(PyObject* self) {
+	if (aspell_speller_error(Speller(self)) != 0) {
+		PyErr_SetString(SpellerError(self), aspell_speller_error_message(Speller(self)));
+		return NULL;
+	}
+	else
+		Py_RETURN_NONE;
+}
+
+/* method:addtoPersonal *******************************************************/
+static PyObject* m_addtoPersonal(PyObject* self, PyObject* args) {
+	char *word;
+	Py_ssize_t length;
+	PyObject* buf;
+	PyObject* result;
+
+	buf = get_arg_string(self, args, 0, &word, &length);
+	if (buf == NULL)
+		return NULL;
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	aspell_speller_add_to_personal(Speller(self), word, length);
+	Py_END_ALLOW_THREADS
+	cache_invalidate(SuggestCacheOf(self));
+	update_fingerprint(self, 0, 1);
+	result = AspellCheckError(self);
+	speller_unlock(self);
+
+	Py_DECREF(buf);
+	return result;
+}
+
+/* method:addtoSession ********************************************************/
+static PyObject* m_addtoSession(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	char *word;
+	Py_ssize_t length;
+	PyObject* buf;
+	PyObject* result;
+
+	if (check_nargs("addtoSession", nargs, 1) < 0)
+		return NULL;
+
+	buf = get_single_arg_string(self, args[0], &word, &length);
+	if (buf == NULL)
+		return NULL;
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	aspell_speller_add_to_session(Speller(self), word, length);
+	Py_END_ALLOW_THREADS
+	cache_invalidate(SuggestCacheOf(self));
+	update_fingerprint(self, 0, 1);
+	result = AspellCheckError(self);
+	speller_unlock(self);
+
+	Py_DECREF(buf);
+	return result;
+}
+
+typedef int (*AddWordFunction)(AspellSpeller*, const char*, int);
+
+/* helper function: adds all words from iterable with a single libaspell
+   lock and without the GIL; stops at the first failing word, reporting
+   its index */
+static PyObject* add_words_many(PyObject* self, PyObject* words, AddWordFunction add, const char* name) {
+	PyObject* seq;
+	PyObject* result = NULL;
+	PyObject** bufs = NULL;
+	char** word = NULL;
+	Py_ssize_t* length = NULL;
+	Py_ssize_t i, n;
+	int added = 1;
+
+	seq = PySequence_Fast(words, "argument must be an iterable of strings");
+	if (seq == NULL)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE(seq);
+
+	/* 1. encode all words */
+	bufs   = PyMem_New(PyObject*, n);
+	word   = PyMem_New(char*, n);
+	length = PyMem_New(Py_ssize_t, n);
+	if (bufs == NULL || word == NULL || length == NULL) {
+		PyErr_NoMemory();
+		n = 0;
+		goto cleanup;
+	}
+
+	for (i=0; i < n; i++) {
+		bufs[i] = get_single_arg_string(self, PySequence_Fast_GET_ITEM(seq, i), &word[i], &length[i]);
+		if (bufs[i] == NULL) {
+			if (PyErr_ExceptionMatches(PyExc_TypeError))
+				PyErr_Format(PyExc_TypeError, "%s(): word #%zd: string or bytes required", name, i);
+			n = i;
+			goto cleanup;
+		}
+	}
+
+	/* 2. add them */
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	for (i=0; i < n; i++) {
+		added = add(Speller(self), word[i], length[i]);
+		if (added == 0)
+			break;
+	}
+	Py_END_ALLOW_THREADS
+
+	/* words preceding the failing one have been added */
+	if (i > 0) {
+		cache_invalidate(SuggestCacheOf(self));
+		update_fingerprint(self, 0, 1);
+	}
+
+	if (added == 0 || aspell_speller_error(Speller(self)) != 0)
+		PyErr_Format(SpellerError(self), "word #%zd: %s", i, aspell_speller_error_message(Speller(self)));
+	else {
+		result = Py_None;
+		Py_INCREF(result);
+	}
+	speller_unlock(self);
+
+cleanup:
+	if (bufs) {
+		for (i=0; i < n; i++)
+			Py_DECREF(bufs[i]);
+	}
+
+	PyMem_Free(bufs);
+	PyMem_Free(word);
+	PyMem_Free(length);
+	Py_DECREF(seq);
+	return result;
+}
+
+/* method:addtoPersonalMany ***************************************************/
+static PyObject* m_addtoPersonalMany(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	if (check_nargs("addtoPersonalMany", nargs, 1) < 0)
+		return NULL;
+
+	return add_words_many(self, args[0], aspell_speller_add_to_personal, "addtoPersonalMany");
+}
+
+/* method:addtoSessionMany ****************************************************/
+static PyObject* m_addtoSessionMany(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	if (check_nargs("addtoSessionMany", nargs, 1) < 0)
+		return NULL;
+
+	return add_words_many(self, args[0], aspell_speller_add_to_session, "addtoSessionMany");
+}
+
+/* method:loadSessionFile *****************************************************/
+static PyObject* m_loadSessionFile(PyObject* self, PyObject* args) {
+	PyObject* path;
+	MappedFile file;
+	const char* p;
+	const char* end;
+	const char* eol;
+	size_t length;
+	Py_ssize_t line = 0;
+	Py_ssize_t count = 0;
+	int added = 1;
+	int toolong = 0;
+	int error;
+
+	if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path))
+		return NULL;
+
+	memset(&file, 0, sizeof(MappedFile));
+
+	Py_BEGIN_ALLOW_THREADS
+	error = map_file(&file, PyBytes_AS_STRING(path));
+	Py_END_ALLOW_THREADS
+
+	if (error) {
+		errno = error;
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+
+	/* one word per line, in the speller's encoding; blank lines are skipped */
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	p   = (const char*)file.data;
+	end = p + file.size;
+	while (p < end) {
+		line += 1;
+		eol = memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+
+		length = eol - p;
+		if (length > 0 && p[length - 1] == '\r')
+			length -= 1;
+
+		/* aspell takes length as int */
+		if (length > INT_MAX) {
+			toolong = 1;
+			break;
+		}
+
+		if (length > 0) {
+			added = aspell_speller_add_to_session(Speller(self), p, (int)length);
+			if (added == 0)
+				break;
+
+			count += 1;
+		}
+
+		p = eol + 1;
+	}
+	Py_END_ALLOW_THREADS
+
+	if (count > 0) {
+		cache_invalidate(SuggestCacheOf(self));
+		update_fingerprint(self, 0, 1);
+	}
+
+	if (added == 0)
+		PyErr_Format(SpellerError(self), "%s, line %zd: %s", PyBytes_AS_STRING(path), line, aspell_speller_error_message(Speller(self)));
+	speller_unlock(self);
+
+	unmap_file(&file);
+
+	if (toolong)
+		PyErr_Format(PyExc_ValueError, "%s, line %zd: word is too long", PyBytes_AS_STRING(path), line);
+
+	Py_DECREF(path);
+
+	if (added == 0 || toolong)
+		return NULL;
+
+	return PyLong_FromSsize_t(count);
+}
+
+/* method:clearsession ********************************************************/
+static PyObject* m_clearsession(PyObject* self, PyObject* args) {
+	PyObject* result;
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	aspell_speller_clear_session(Speller(self));
+	Py_END_ALLOW_THREADS
+	cache_invalidate(SuggestCacheOf(self));
+	update_fingerprint(self, 0, 1);
+	result = AspellCheckError(self);
+	speller_unlock(self);
+
+	return result;
+}
+
+/* method:saveallwords ********************************************************/
+static PyObject* m_saveallwords(PyObject* self, PyObject* args) {
+	PyObject* result;
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	aspell_speller_save_all_word_lists(Speller(self));
+	Py_END_ALLOW_THREADS
+	result = AspellCheckError(self);
+	speller_unlock(self);
+
+	return result;
+}
+
+/* method:addReplacement ******************************************************/
+static PyObject* m_addReplacement(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	char *mis; Py_ssize_t ml;
+	char *cor; Py_ssize_t cl;
+	PyObject* Mbuf;
+	PyObject* Cbuf;
+	PyObject* result;
+
+	if (check_nargs("addReplacement", nargs, 2) < 0)
+		return NULL;
+
+	Mbuf = get_single_arg_string(self, args[0], &mis, &ml);
+	if (Mbuf == NULL) {
+		PyErr_SetString(PyExc_TypeError, "first argument have to be a string or bytes");
+		return NULL;
+	}
+
+	Cbuf = get_single_arg_string(self, args[1], &cor, &cl);
+	if (Cbuf == NULL) {
+		Py_DECREF(Mbuf);
+		PyErr_SetString(PyExc_TypeError, "second argument have to be a string or bytes");
+		return NULL;
+	}
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	aspell_speller_store_replacement(Speller(self), mis, ml, cor, cl);
+	Py_END_ALLOW_THREADS
+	cache_invalidate(SuggestCacheOf(self));
+	result = AspellCheckError(self);
+	if (result && replacements_append(&((aspell_AspellObject*)self)->replacements, mis, ml, cor, cl) < 0) {
+		Py_CLEAR(result);
+		PyErr_NoMemory();
+	}
+	speller_unlock(self);
+
+	Py_DECREF(Mbuf);
+	Py_DECREF(Cbuf);
+	return result;
+}
+
+/* Word list export ***********************************************************/
+
+/* File written by exportWordlist() and read by MappedWordlist:
+
+	offset	size
+	0		8			magic "ASPWLST1"
+	8		32			encoding of words, padded with NULs
+	40		4			N - number of words
+	44		4			reserved, 0
+	48		4*(N+1)		offsets of words, relative to the words area
+	...					words, sorted bytewise, without separators
+
+   All integers are little-endian. */
+
+#define WORDLIST_MAGIC			"ASPWLST1"
+#define WORDLIST_ENCODING_SIZE	32
+#define WORDLIST_HEADER_SIZE	48
+
+typedef struct {
+	const char* ptr;
+	unsigned int length;
+} WordRef;
+
+typedef struct {
+	char* buffer;			/* all words */
+	size_t used;
+	size_t capacity;
+	size_t* offsets;		/* start of each word in buffer */
+	size_t count;
+	size_t offsets_capacity;
+} WordCollector;
+
+static int collect_words(WordCollector* words, const AspellWordList* wordlist) {
+	AspellStringEnumeration* elements;
+	const char* word;
+	size_t length;
+	void* tmp;
+
+	if (wordlist == NULL)
+		return 0;
+
+	elements = aspell_word_list_elements(wordlist);
+	while ((word = aspell_string_enumeration_next(elements)) != NULL) {
+		length = strlen(word);
+		if (words->used + length > words->capacity) {
+			words->capacity = 2*(words->used + length) + 4096;
+			tmp = realloc(words->buffer, words->capacity);
+			if (tmp == NULL)
+				goto error;
+			words->buffer = tmp;
+		}
+
+		if (words->count + 2 > words->offsets_capacity) {
+			words->offsets_capacity = 2*words->count + 1024;
+			tmp = realloc(words->offsets, words->offsets_capacity * sizeof(size_t));
+			if (tmp == NULL)
+				goto error;
+			words->offsets = tmp;
+		}
+
+		memcpy(words->buffer + words->used, word, length);
+		words->offsets[words->count++] = words->used;
+		words->used += length;
+	}
+
+	delete_aspell_string_enumeration(elements);
+	return 0;
+
+error:
+	delete_aspell_string_enumeration(elements);
+	return -1;
+}
+
+static int compare_words(const void* a, const void* b) {
+	const WordRef* A = (const WordRef*)a;
+	const WordRef* B = (const WordRef*)b;
+	int result;
+
+	result = memcmp(A->ptr, B->ptr, A->length < B->length ? A->length : B->length);
+	if (result)
+		return result;
+	else
+		return (A->length > B->length) - (A->length < B->length);
+}
+
+static void put_uint32(unsigned char* buffer, size_t value) {
+	buffer[0] = (unsigned char)(value);
+	buffer[1] = (unsigned char)(value >> 8);
+	buffer[2] = (unsigned char)(value >> 16);
+	buffer[3] = (unsigned char)(value >> 24);
+}
+
+static size_t get_uint32(const unsigned char* buffer) {
+	return (size_t)buffer[0]
+	    | ((size_t)buffer[1] << 8)
+	    | ((size_t)buffer[2] << 16)
+	    | ((size_t)buffer[3] << 24);
+}
+
+/* helper function: creates a temporary file next to path, which is
+   later renamed over path; name is set to its malloc'ed name */
+static FILE* open_temporary(const char* path, char** name) {
+	FILE* file;
+	size_t length = strlen(path);
+#ifdef _WIN32
+	*name = malloc(length + 32);
+	if (*name == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	sprintf(*name, "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+	file = fopen(*name, "wb");
+#else
+	struct stat st;
+	int fd;
+
+	*name = malloc(length + 8);
+	if (*name == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	sprintf(*name, "%sXXXXXX", path);
+	fd = mkstemp(*name);
+	if (fd < 0)
+		file = NULL;
+	else {
+		/* mkstemp creates a private file, the list is meant to be shared */
+		fchmod(fd, stat(path, &st) == 0 ? (st.st_mode & 07777) : 0644);
+		file = fdopen(fd, "wb");
+		if (file == NULL) {
+			close(fd);
+			unlink(*name);
+		}
+	}
+#endif
+	if (file == NULL) {
+		free(*name);
+		*name = NULL;
+	}
+
+	return file;
+}
+
+/* helper function: replaces path with the temporary file */
+static int replace_file(const char* temporary, const char* path) {
+#ifdef _WIN32
+	if (!MoveFileExA(temporary, path, MOVEFILE_REPLACE_EXISTING))
+		return EACCES;
+#else
+	if (rename(temporary, path) != 0)
+		return errno;
+#endif
+	return 0;
+}
+
+/* helper function: sorts words and writes the file;
+   returns 0 on success, errno value or -1 when out of memory
+
+   The file is written under a temporary name and then renamed, thus
+   processes which have mapped the previous file keep reading it intact. */
+static int write_word_list(const char* path, const char* encoding, WordCollector* words) {
+	WordRef* refs;
+	unsigned char header[WORDLIST_HEADER_SIZE];
+	unsigned char number[4];
+	size_t i, n, offset;
+	FILE* file;
+	char* temporary;
+	int error = 0;
+
+	refs = malloc((words->count + 1) * sizeof(WordRef));
+	if (refs == NULL)
+		return -1;
+
+	for (i=0; i < words->count; i++) {
+		refs[i].ptr = words->buffer + words->offsets[i];
+		refs[i].length = (unsigned int)((i + 1 < words->count ? words->offsets[i + 1] : words->used) - words->offsets[i]);
+	}
+
+	qsort(refs, words->count, sizeof(WordRef), compare_words);
+
+	/* remove duplicates */
+	for (i=0, n=0; i < words->count; i++)
+		if (n == 0 || compare_words(&refs[n - 1], &refs[i]) != 0)
+			refs[n++] = refs[i];
+
+	file = open_temporary(path, &temporary);
+	if (file == NULL) {
+		error = errno;
+		free(refs);
+		return error;
+	}
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, WORDLIST_MAGIC, 8);
+	strncpy((char*)header + 8, encoding, WORDLIST_ENCODING_SIZE - 1);
+	put_uint32(header + 40, n);
+
+	fwrite(header, sizeof(header), 1, file);
+	for (i=0, offset=0; i <= n; i++) {
+		put_uint32(number, offset);
+		fwrite(number, 4, 1, file);
+		if (i < n)
+			offset += refs[i].length;
+	}
+
+	for (i=0; i < n; i++)
+		fwrite(refs[i].ptr, refs[i].length, 1, file);
+
+	if (fflush(file) != 0 || ferror(file))
+		error = errno ? errno : EIO;
+
+	if (fclose(file) != 0 && error == 0)
+		error = errno;
+
+	if (error == 0)
+		error = replace_file(temporary, path);
+
+	if (error)
+		remove(temporary);
+
+	free(temporary);
+	free(refs);
+	return error;
+}
+
+/* method:exportWordlist ******************************************************/
+static PyObject* m_exportWordlist(PyObject* self, PyObject* args) {
+	PyObject* path;
+	WordCollector words;
+	int error = 0;
+
+	if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path))
+		return NULL;
+
+	memset(&words, 0, sizeof(words));
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	if (collect_words(&words, aspell_speller_main_word_list(Speller(self))) < 0
+	 || collect_words(&words, aspell_speller_personal_word_list(Speller(self))) < 0)
+		error = -1;
+	Py_END_ALLOW_THREADS
+	speller_unlock(self);
+
+	if (error == 0 && words.used > 0xffffffffUL)
+		error = EFBIG;
+
+	if (error == 0) {
+		Py_BEGIN_ALLOW_THREADS
+		error = write_word_list(PyBytes_AS_STRING(path), Encoding(self), &words);
+		Py_END_ALLOW_THREADS
+	}
+
+	free(words.buffer);
+	free(words.offsets);
+
+	if (error == -1) {
+		Py_DECREF(path);
+		return PyErr_NoMemory();
+	}
+
+	if (error) {
+		errno = error;
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+
+	Py_DECREF(path);
+	Py_RETURN_NONE;
+}
+
+/* method:clone ***************************************************************/
+static PyObject* m_clone(PyObject* self, PyObject* args) {
+	aspell_AspellObject* obj = (aspell_AspellObject*)self;
+	aspell_AspellObject* clone;
+	AspellSpeller* speller;
+	ReplacementLog replacements;
+	Py_ssize_t max_entries, max_bytes;
+	char error[256];
+
+	memset(&replacements, 0, sizeof(ReplacementLog));
+	error[0] = '\0';
+
+	/* dictionaries loaded by the speller are reused by aspell, so this
+	   is much cheaper than creating a speller from scratch */
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	speller = new_speller_like(obj->speller, error, sizeof(error));
+	if (speller) {
+		copy_words(speller, aspell_speller_session_word_list(obj->speller), aspell_speller_add_to_session);
+		copy_words(speller, aspell_speller_personal_word_list(obj->speller), aspell_speller_add_to_personal);
+		replay_replacements(speller, &obj->replacements, 0);
+
+		if (obj->replacements.used > 0) {
+			replacements.data = malloc(obj->replacements.used);
+			if (replacements.data) {
+				memcpy(replacements.data, obj->replacements.data, obj->replacements.used);
+				replacements.used = replacements.capacity = obj->replacements.used;
+			}
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	max_entries = SuggestCacheOf(self)->max_entries;
+	max_bytes = SuggestCacheOf(self)->max_bytes;
+	speller_unlock(self);
+
+	if (speller == NULL) {
+		error[sizeof(error) - 1] = '\0';
+		PyErr_SetString(SpellerError(self), error);
+		return NULL;
+	}
+
+	if (obj->replacements.used > 0 && replacements.data == NULL) {
+		delete_aspell_speller(speller);
+		return PyErr_NoMemory();
+	}
+
+	clone = (aspell_AspellObject*)wrap_speller(state_of(self), speller);
+	if (clone == NULL) {
+		free(replacements.data);
+		return NULL;
+	}
+
+	clone->replacements = replacements;
+	if (obj->encoding_kind == ENCODING_RAW)
+		clone->encoding_kind = ENCODING_RAW;
+	if (obj->private_id)
+		update_fingerprint((PyObject*)clone, 0, 1);
+
+	if ((max_entries || max_bytes) && cache_configure(SuggestCacheOf(clone), max_entries, max_bytes) < 0) {
+		Py_DECREF(clone);
+		return NULL;
+	}
+
+	return (PyObject*)clone;
+}
+
+/* Snapshots ******************************************************************/
+
+/* Snapshot is a portable image of speller's state, which lets to rebuild
+   the speller without replaying all calls:
+
+	"aspl", version, flags		header, 6 bytes
+	count, (key, value)*		explicitly set config keys
+	count, word*				session word list
+	count, word*				personal word list
+	count, (mis, cor)*			replacement pairs
+
+   Numbers are 32-bit little endian, a string is its length followed by
+   bytes; config keys and values include the terminating NUL. */
+
+#define SNAPSHOT_MAGIC		"aspl"
+#define SNAPSHOT_VERSION	1
+#define SNAPSHOT_RAW		0x01	/* raw speller */
+#define SNAPSHOT_PRIVATE	0x02	/* word lists were modified */
+
+static void put_u32(unsigned char* p, size_t value) {
+	p[0] = (unsigned char)(value);
+	p[1] = (unsigned char)(value >> 8);
+	p[2] = (unsigned char)(value >> 16);
+	p[3] = (unsigned char)(value >> 24);
+}
+
+static void append_u32(StringBuffer* buffer, size_t value) {
+	unsigned char bytes[4];
+
+	put_u32(bytes, value);
+	append_bytes(buffer, bytes, 4);
+}
+
+static void append_field(StringBuffer* buffer, const char* data, size_t length) {
+	append_u32(buffer, length);
+	append_bytes(buffer, data, length);
+}
+
+/* helper function: sets count written at given position */
+static void patch_count(StringBuffer* buffer, size_t pos, size_t count) {
+	if (!buffer->failed)
+		put_u32((unsigned char*)buffer->data + pos, count);
+}
+
+static void snapshot_config(StringBuffer* buffer, AspellConfig* config) {
+	AspellKeyInfoEnumeration* keys;
+	const AspellKeyInfo* info;
+	AspellStringList* lst;
+	AspellStringEnumeration* elements;
+	const char* string;
+	char name[256];
+	size_t pos, count = 0;
+	int lists;
+
+	pos = buffer->used;
+	append_u32(buffer, 0);
+
+	/* lists go last, as setting other keys (like mode) might alter them */
+	for (lists=0; lists < 2; lists++) {
+		keys = aspell_config_possible_elements(config, 1);
+		if (keys == NULL)
+			break;
+
+		while ((info = aspell_key_info_enumeration_next(keys))) {
+			if (!aspell_config_have(config, info->name))
+				continue;
+
+			if ((info->type == AspellKeyInfoList) != lists)
+				continue;
+
+			if (!lists) {
+				string = aspell_config_retrieve(config, info->name);
+				if (string == NULL)
+					continue;
+
+				append_field(buffer, info->name, strlen(info->name) + 1);
+				append_field(buffer, string, strlen(string) + 1);
+				count += 1;
+				continue;
+			}
+
+			/* list is replaced with clear-key & add-key entries */
+			if (strlen(info->name) + 7 > sizeof(name))
+				continue;
+
+			sprintf(name, "clear-%s", info->name);
+			append_field(buffer, name, strlen(name) + 1);
+			append_field(buffer, "", 1);
+			count += 1;
+
+			sprintf(name, "add-%s", info->name);
+			lst = new_aspell_string_list();
+			aspell_config_retrieve_list(config, info->name, aspell_string_list_to_mutable_container(lst));
+			elements = aspell_string_list_elements(lst);
+			while ((string = aspell_string_enumeration_next(elements))) {
+				append_field(buffer, name, strlen(name) + 1);
+				append_field(buffer, string, strlen(string) + 1);
+				count += 1;
+			}
+			delete_aspell_string_enumeration(elements);
+			delete_aspell_string_list(lst);
+		}
+
+		delete_aspell_key_info_enumeration(keys);
+	}
+
+	patch_count(buffer, pos, count);
+}
+
+static void snapshot_words(StringBuffer* buffer, const AspellWordList* wordlist) {
+	AspellStringEnumeration* elements;
+	const char* word;
+	size_t pos, count = 0;
+
+	pos = buffer->used;
+	append_u32(buffer, 0);
+	if (wordlist == NULL)
+		return;
+
+	elements = aspell_word_list_elements(wordlist);
+	while ((word = aspell_string_enumeration_next(elements)) != NULL) {
+		append_field(buffer, word, strlen(word));
+		count += 1;
+	}
+	delete_aspell_string_enumeration(elements);
+
+	patch_count(buffer, pos, count);
+}
+
+static void snapshot_replacements(StringBuffer* buffer, const ReplacementLog* log) {
+	size_t pos, count = 0;
+	size_t ml, cl;
+	size_t i;
+
+	pos = buffer->used;
+	append_u32(buffer, 0);
+
+	for (i=0; i < log->used; i += 2*sizeof(size_t) + ml + cl) {
+		memcpy(&ml, log->data + i, sizeof(size_t));
+		memcpy(&cl, log->data + i + sizeof(size_t) + ml, sizeof(size_t));
+		append_field(buffer, log->data + i + sizeof(size_t), ml);
+		append_field(buffer, log->data + i + 2*sizeof(size_t) + ml, cl);
+		count += 1;
+	}
+
+	patch_count(buffer, pos, count);
+}
+
+/* method:snapshot ************************************************************/
+static PyObject* m_snapshot(PyObject* self, PyObject* args) {
+	aspell_AspellObject* obj = (aspell_AspellObject*)self;
+	StringBuffer buffer;
+	PyObject* result;
+	unsigned char header[2];
+
+	memset(&buffer, 0, sizeof(buffer));
+	header[0] = SNAPSHOT_VERSION;
+	header[1] = (obj->encoding_kind == ENCODING_RAW ? SNAPSHOT_RAW : 0)
+	          | (obj->private_id ? SNAPSHOT_PRIVATE : 0);
+
+	speller_lock(self);
+	Py_BEGIN_ALLOW_THREADS
+	append_bytes(&buffer, SNAPSHOT_MAGIC, 4);
+	append_bytes(&buffer, header, 2);
+	snapshot_config(&buffer, aspell_speller_config(obj->speller));
+	snapshot_words(&buffer, aspell_speller_session_word_list(obj->speller));
+	snapshot_words(&buffer, aspell_speller_personal_word_list(obj->speller));
+	snapshot_replacements(&buffer, &obj->replacements);
+	Py_END_ALLOW_THREADS
+	speller_unlock(self);
+
+	if (buffer.failed) {
+		free(buffer.data);
+		return PyErr_NoMemory();
+	}
+
+	result = PyBytes_FromStringAndSize(buffer.data, buffer.used);
+	free(buffer.data);
+	return result;
+}
+
+typedef struct {
+	const unsigned char* p;
+	const unsigned char* end;
+	int failed;
+} SnapshotReader;
+
+static size_t read_u32(SnapshotReader* reader) {
+	const unsigned char* p = reader->p;
+
+	if (reader->failed || reader->end - p < 4) {
+		reader->failed = 1;
+		return 0;
+	}
+
+	reader->p += 4;
+	return (size_t)p[0] | ((size_t)p[1] << 8) | ((size_t)p[2] << 16) | ((size_t)p[3] << 24);
+}
+
+/* returns string's data, or NULL if the snapshot is truncated; when
+   cstring is set the string must be NUL-terminated */
+static const char* read_field(SnapshotReader* reader, size_t* length, int cstring) {
+	const unsigned char* data;
+
+	*length = read_u32(reader);
+	if (reader->failed || (size_t)(reader->end - reader->p) < *length || (cstring && (*length == 0 || reader->p[*length - 1] != '\0'))) {
+		reader->failed = 1;
+		return NULL;
+	}
+
+	data = reader->p;
+	reader->p += *length;
+	return (const char*)data;
+}
+
+typedef enum {
+	RESTORE_OK,
+	RESTORE_INVALID,	/* malformed snapshot */
+	RESTORE_CONFIG,		/* aspell refused config */
+	RESTORE_SPELLER,	/* aspell failed to create speller or add a word */
+	RESTORE_MEMORY
+} RestoreStatus;
+
+/* helper function: adds words from snapshot's word list section */
+static RestoreStatus restore_words(SnapshotReader* reader, AspellSpeller* speller, AddWordFunction add, char* error, size_t error_size) {
+	size_t i, count, length;
+	const char* word;
+
+	count = read_u32(reader);
+	for (i=0; i < count; i++) {
+		word = read_field(reader, &length, 0);
+		if (word == NULL)
+			return RESTORE_INVALID;
+
+		if (add(speller, word, (int)length) == 0) {
+			strncpy(error, aspell_speller_error_message(speller), error_size - 1);
+			return RESTORE_SPELLER;
+		}
+	}
+
+	return reader->failed ? RESTORE_INVALID : RESTORE_OK;
+}
+
+/* helper function: creates speller from snapshot; doesn't need the GIL,
+   on error message is copied into error */
+static RestoreStatus restore_speller(
+	const unsigned char* data, size_t size,
+	AspellSpeller** speller, int* flags, ReplacementLog* log,
+	char* error, size_t error_size
+) {
+	SnapshotReader reader;
+	AspellConfig* config;
+	AspellCanHaveError* possible_error;
+	RestoreStatus status;
+	const char *key, *value, *mis, *cor;
+	size_t i, count, kl, vl, ml, cl;
+
+	*speller = NULL;
+	if (size < 6 || memcmp(data, SNAPSHOT_MAGIC, 4) != 0) {
+		strncpy(error, "not a speller snapshot", error_size - 1);
+		return RESTORE_INVALID;
+	}
+
+	if (data[4] != SNAPSHOT_VERSION) {
+		snprintf(error, error_size, "unsupported snapshot version %d", data[4]);
+		return RESTORE_INVALID;
+	}
+
+	*flags = data[5];
+	reader.p = data + 6;
+	reader.end = data + size;
+	reader.failed = 0;
+
+	/* 1. config */
+	config = new_aspell_config();
+	if (config == NULL) {
+		strncpy(error, "can't create config", error_size - 1);
+		return RESTORE_MEMORY;
+	}
+
+	count = read_u32(&reader);
+	for (i=0; i < count && !reader.failed; i++) {
+		key = read_field(&reader, &kl, 1);
+		value = read_field(&reader, &vl, 1);
+		if (reader.failed)
+			break;
+
+		if (!aspell_config_replace(config, key, value)) {
+			strncpy(error, aspell_config_error_message(config), error_size - 1);
+			delete_aspell_config(config);
+			return RESTORE_CONFIG;
+		}
+	}
+
+	if (reader.failed) {
+		delete_aspell_config(config);
+		strncpy(error, "snapshot is truncated", error_size - 1);
+		return RESTORE_INVALID;
+	}
+
+	/* 2. speller */
+	possible_error = new_aspell_speller(config);
+	delete_aspell_config(config);
+	if (aspell_error_number(possible_error) != 0) {
+		strncpy(error, aspell_error_message(possible_error), error_size - 1);
+		delete_aspell_can_have_error(possible_error);
+		return RESTORE_SPELLER;
+	}
+
+	*speller = to_aspell_speller(possible_error);
+
+	/* 3. word lists */
+	status = restore_words(&reader, *speller, aspell_speller_add_to_session, error, error_size);
+	if (status == RESTORE_OK)
+		status = restore_words(&reader, *speller, aspell_speller_add_to_personal, error, error_size);
+
+	/* 4. replacements */
+	if (status == RESTORE_OK) {
+		count = read_u32(&reader);
+		for (i=0; i < count && !reader.failed; i++) {
+			mis = read_field(&reader, &ml, 0);
+			cor = read_field(&reader, &cl, 0);
+			if (reader.failed)
+				break;
+
+			aspell_speller_store_replacement(*speller, mis, (int)ml, cor, (int)cl);
+			if (replacements_append(log, mis, ml, cor, cl) < 0) {
+				status = RESTORE_MEMORY;
+				break;
+			}
+		}
+
+		if (reader.failed || (status == RESTORE_OK && reader.p != reader.end))
+			status = RESTORE_INVALID;
+	}
+
+	if (status == RESTORE_INVALID)
+		strncpy(error, "snapshot is truncated or corrupted", error_size - 1);
+
+	if (status != RESTORE_OK) {
+		delete_aspell_speller(*speller);
+		*speller = NULL;
+	}
+
+	return status;
+}
+
+/* method:restore *************************************************************/
+static PyObject* m_restore(PyObject* type, PyObject* blob) {
+	ModuleState* state = state_of_type((PyTypeObject*)type);
+	aspell_AspellObject* speller;
+	AspellSpeller* restored;
+	ReplacementLog replacements;
+	RestoreStatus status;
+	Py_buffer view;
+	int flags = 0;
+	char error[256];
+
+	if (PyObject_GetBuffer(blob, &view, PyBUF_SIMPLE) < 0)
+		return NULL;
+
+	memset(&replacements, 0, sizeof(ReplacementLog));
+	error[0] = '\0';
+
+	Py_BEGIN_ALLOW_THREADS
+	status = restore_speller(view.buf, (size_t)view.len, &restored, &flags, &replacements, error, sizeof(error));
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&view);
+
+	error[sizeof(error) - 1] = '\0';
+	switch (status) {
+		case RESTORE_OK:
+			break;
+
+		case RESTORE_INVALID:
+			PyErr_SetString(PyExc_ValueError, error);
+			break;
+
+		case RESTORE_CONFIG:
+			PyErr_SetString(state->config_error, error);
+			break;
+
+		case RESTORE_SPELLER:
+			PyErr_SetString(state->speller_error, error);
+			break;
+
+		case RESTORE_MEMORY:
+			PyErr_NoMemory();
+			break;
+	}
+
+	if (status != RESTORE_OK) {
+		free(replacements.data);
+		return NULL;
+	}
+
+	speller = (aspell_AspellObject*)wrap_speller(state, restored);
+	if (speller == NULL) {
+		free(replacements.data);
+		return NULL;
+	}
+
+	speller->replacements = replacements;
+	if (flags & SNAPSHOT_RAW)
+		speller->encoding_kind = ENCODING_RAW;
+	if (flags & SNAPSHOT_PRIVATE)
+		update_fingerprint((PyObject*)speller, 0, 1);
+
+	return (PyObject*)speller;
+}
+
+/* method:__reduce__ **********************************************************/
+static PyObject* m_reduce(PyObject* self, PyObject* args) {
+	PyObject* restore;
+	PyObject* snapshot;
+
+	restore = PyObject_GetAttrString((PyObject*)Py_TYPE(self), "restore");
+	if (restore == NULL)
+		return NULL;
+
+	snapshot = m_snapshot(self, NULL);
+	if (snapshot == NULL) {
+		Py_DECREF(restore);
+		return NULL;
+	}
+
+	return Py_BuildValue("(N(N))", restore, snapshot);
+}
+
+/* method:setSuggestCache ****************************************************/
+static PyObject* m_setSuggestCache(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"entries", "bytes", NULL};
+	Py_ssize_t entries;
+	Py_ssize_t bytes = 0;
+	int result;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|n", kwlist, &entries, &bytes))
+		return NULL;
+
+	if (entries < 0 || bytes < 0) {
+		PyErr_SetString(PyExc_ValueError, "limits must not be negative");
+		return NULL;
+	}
+
+	speller_lock(self);
+	result = cache_configure(SuggestCacheOf(self), entries, bytes);
+	speller_unlock(self);
+
+	if (result < 0)
+		return NULL;
+	else
+		Py_RETURN_NONE;
+}
+
+/* method:clearSuggestCache **************************************************/
+static PyObject* m_clearSuggestCache(PyObject* self, PyObject* args) {
+	speller_lock(self);
+	cache_clear(SuggestCacheOf(self));
+	speller_unlock(self);
+
+	Py_RETURN_NONE;
+}
+
+/* method:suggestCacheStats **************************************************/
+static PyObject* m_suggestCacheStats(PyObject* self, PyObject* args) {
+	SuggestCache cache;
+
+	/* counters are copied, the dictionary is built after unlocking;
+	   only plain fields of the copy are used */
+	speller_lock(self);
+	cache = *SuggestCacheOf(self);
+	speller_unlock(self);
+
+	return Py_BuildValue(
+		"{s:O,s:n,s:n,s:n,s:n,s:K,s:K,s:K,s:K}",
+		"enabled",			cache.nbuckets ? Py_True : Py_False,
+		"entries",			cache.entries,
+		"bytes",			cache.bytes,
+		"max_entries",		cache.max_entries,
+		"max_bytes",		cache.max_bytes,
+		"hits",				cache.hits,
+		"misses",			cache.misses,
+		"evictions",		cache.evictions,
+		"invalidations",	cache.invalidations
+	);
+}
+
+/* helper function: converts histogram into dictionary
+   {upper bound of bucket in ns: count}, empty buckets are skipped */
+static PyObject* histogram2dict(const unsigned long long* histogram) {
+	PyObject* dict;
+	PyObject* key;
+	PyObject* value;
+	int i;
+
+	dict = PyDict_New();
+	if (dict == NULL)
+		return NULL;
+
+	for (i=0; i < STATS_BUCKETS; i++) {
+		if (histogram[i] == 0)
+			continue;
+
+		key = PyLong_FromUnsignedLongLong(1ULL << (i + 1));
+		value = PyLong_FromUnsignedLongLong(histogram[i]);
+		if (key == NULL || value == NULL || PyDict_SetItem(dict, key, value) < 0) {
+			Py_XDECREF(key);
+			Py_XDECREF(value);
+			Py_DECREF(dict);
+			return NULL;
+		}
+
+		Py_DECREF(key);
+		Py_DECREF(value);
+	}
+
+	return dict;
+}
+
+/* method:stats ***************************************************************/
+static PyObject* m_stats(PyObject* self, PyObject* args) {
+	SpellerStats speller_stats;
+	const OperationStats* stats;
+	PyObject* dict;
+	PyObject* item;
+	int i;
+
+	/* copy, as other threads might record calls meanwhile */
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (((aspell_AspellObject*)self)->stats)
+		speller_stats = *((aspell_AspellObject*)self)->stats;
+	else
+		memset(&speller_stats, 0, sizeof(SpellerStats));
+	Py_END_CRITICAL_SECTION();
+
+	dict = PyDict_New();
+	if (dict == NULL)
+		return NULL;
+
+	for (i=0; i < STATS_OPERATIONS; i++) {
+		stats = &speller_stats.operations[i];
+		item = Py_BuildValue(
+			"{s:K,s:K,s:K,s:K,s:d,s:d,s:N,s:N}",
+			"calls",			stats->calls,
+			"words",			stats->words,
+			"errors",			stats->errors,
+			"exceptions",		stats->exceptions,
+			"aspell_time",		stats->aspell_ns / 1e9,
+			"convert_time",		stats->convert_ns / 1e9,
+			"aspell_histogram",	histogram2dict(stats->aspell_histogram),
+			"convert_histogram",histogram2dict(stats->convert_histogram)
+		);
+
+		if (item == NULL || PyDict_SetItemString(dict, stats_names[i], item) < 0) {
+			Py_XDECREF(item);
+			Py_DECREF(dict);
+			return NULL;
+		}
+		Py_DECREF(item);
+	}
+
+	return dict;
+}
+
+/* method:resetStats **********************************************************/
+static PyObject* m_resetStats(PyObject* self, PyObject* args) {
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (((aspell_AspellObject*)self)->stats)
+		memset(((aspell_AspellObject*)self)->stats, 0, sizeof(SpellerStats));
+	Py_END_CRITICAL_SECTION();
+
+	Py_RETURN_NONE;
+}
+
+/* AspellSpeller methods table */
+static PyMethodDef aspell_object_methods[] = {
+	{
+		"ConfigKeys",
+		(PyCFunction)m_configkeys,
+		METH_VARARGS,
+		"ConfigKeys() => dictionary of config keys\n"
+        "Keys are string, values are 3-touple:\n"
+		"\t1. key type={string|integer|boolean|list}\n"
+		"\t2. current value\n"
+		"\t3. description (if 'internal' no description available)"
+	},
+	{
+		"setConfigKey",
+		(PyCFunction)m_set_config_key,
+		METH_VARARGS,
+		"changeConfig(key, value)\n"
+		"Sets a new config value for given key"
+	},
+	{
+		"check",
+		(PyCFunction)(void(*)(void))m_check,
+		METH_FASTCALL,
+		"check(word) => bool\n"
+ 		"Checks spelling of word.\n"
+		"Returns if word is correct."
+	},
+	{
+		"checkMany",
+		(PyCFunction)m_checkMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkMany(words, indices=False) => bytearray or list of integers\n"
+		"Checks spelling of all words from an iterable in a single call.\n"
+		"By default returns a bytearray, where i-th byte is 1 if i-th word\n"
+		"is correct and 0 otherwise. If indices is true, returns a list of\n"
+		"indices of misspelled words."
+	},
+	{
+		"checkBuffer",
+		(PyCFunction)m_checkBuffer,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkBuffer(buffer, sep=b'\\n', offsets=False) => bytearray or array('q')\n"
+		"Checks spelling of words separated by sep, read directly from\n"
+		"a bytes-like object. By default returns a bytearray, where i-th\n"
+		"byte is 1 if i-th word is correct and 0 otherwise. If offsets\n"
+		"is true, returns an array of byte offsets of misspelled words."
+	},
+	{
+		"checkDocument",
+		(PyCFunction)m_checkDocument,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkDocument(text, mode=None) => list of (offset, length)\n"
+		"Checks spelling of a whole document using aspell's filters\n"
+		"for given mode ('none', 'url', 'html', 'tex', 'email', ...);\n"
+		"if mode is None, speller's mode is used. Returns positions\n"
+		"of misspelled words: in characters if text is str, in bytes\n"
+		"if text is bytes."
+	},
+	{
+		"checkFile",
+		(PyCFunction)m_checkFile,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkFile(path, mode=None) => iterator of (offset, line, word)\n"
+		"Checks spelling of a file, which is memory mapped and scanned\n"
+		"in chunks without the GIL; mode is used as in checkDocument.\n"
+		"Yields byte offset, line number (from 1) and misspelled word."
+	},
+	{
+		"suggest",
+		(PyCFunction)(void(*)(void))m_suggest,
+		METH_FASTCALL | METH_KEYWORDS,
+		"suggest(word, limit=None, mode=None) => list of words\n"
+ 		"Returns a list of suggested spelling for given word.\n"
+		"Even if word is correct (i.e. check(word) returned 1) aspell performs action.\n"
+		"At most limit words are returned; if mode is given, it's used\n"
+		"as sug-mode for this call only."
+	},
+	{
+		"getMainwordlist",
+		(PyCFunction)m_getMainwordlist,
+		METH_VARARGS,
+		"getMainwordlist() => list of words\n"
+		"Return a list of words stored in the main dictionary."
+
+	},
+	{
+		"getPersonalwordlist",
+		(PyCFunction)m_getPersonalwordlist,
+		METH_VARARGS,
+		"getPersonalwordlist() => list of words\n"
+		"Return a list of words stored in the personal dictionary."
+	},
+	{
+		"getSessionwordlist",
+		(PyCFunction)m_getSessionwordlist,
+		METH_VARARGS,
+		"getSessionwordlist() => list of words\n"
+		"Return a list of words stored in the session dictionary."
+	},
+	{
+		"iterMainwordlist",
+		(PyCFunction)m_iterMainwordlist,
+		METH_NOARGS,
+		"iterMainwordlist() => iterator\n"
+		"Return an iterator over words stored in the main dictionary."
+	},
+	{
+		"iterPersonalwordlist",
+		(PyCFunction)m_iterPersonalwordlist,
+		METH_NOARGS,
+		"iterPersonalwordlist() => iterator\n"
+		"Return an iterator over words stored in the personal dictionary."
+	},
+	{
+		"iterSessionwordlist",
+		(PyCFunction)m_iterSessionwordlist,
+		METH_NOARGS,
+		"iterSessionwordlist() => iterator\n"
+		"Return an iterator over words stored in the session dictionary."
+	},
+	{
+		"getMainwordlistSize",
+		(PyCFunction)m_getMainwordlistSize,
+		METH_NOARGS,
+		"getMainwordlistSize() => integer\n"
+		"Return number of words stored in the main dictionary."
+	},
+	{
+		"getPersonalwordlistSize",
+		(PyCFunction)m_getPersonalwordlistSize,
+		METH_NOARGS,
+		"getPersonalwordlistSize() => integer\n"
+		"Return number of words stored in the personal dictionary."
+	},
+	{
+		"getSessionwordlistSize",
+		(PyCFunction)m_getSessionwordlistSize,
+		METH_NOARGS,
+		"getSessionwordlistSize() => integer\n"
+		"Return number of words stored in the session dictionary."
+	},
+	{
+		"clearSession",
+		(PyCFunction)m_clearsession,
+		METH_VARARGS,
+		"clearSession() => None\n"
+		"Clear current session, i.e. erases all words added thru addtoSession method since last saveallwords() call."
+	},
+	{
+		"saveAllwords",
+		(PyCFunction)m_saveallwords,
+		METH_VARARGS,
+		"saveAllwords() => None\n"
+ 		"Save all words added thru addtoPersonal() and addtoSession() methods."
+	},
+	{
+		"addtoPersonal",
+		(PyCFunction)m_addtoPersonal,
+		METH_VARARGS,
+		"addtoPersonal(word) => None\n"
+		"Add word to the personal dictionary"
+	},
+	{
+		"addtoSession",
+		(PyCFunction)(void(*)(void))m_addtoSession,
+		METH_FASTCALL,
+		"addtoSession(word) => None\n"
+		"Add word to the session dictionary"
+	},
+	{
+		"addtoSessionMany",
+		(PyCFunction)(void(*)(void))m_addtoSessionMany,
+		METH_FASTCALL,
+		"addtoSessionMany(iterable) => None\n"
+		"Add all words to the session dictionary at once; on error\n"
+		"words preceding the failing one remain added"
+	},
+	{
+		"addtoPersonalMany",
+		(PyCFunction)(void(*)(void))m_addtoPersonalMany,
+		METH_FASTCALL,
+		"addtoPersonalMany(iterable) => None\n"
+		"Add all words to the personal dictionary at once; on error\n"
+		"words preceding the failing one remain added"
+	},
+	{
+		"snapshot",
+		(PyCFunction)m_snapshot,
+		METH_NOARGS,
+		"snapshot() => bytes\n"
+		"Return config, session and personal word lists and replacement\n"
+		"pairs of the speller as bytes, which Speller.restore() accepts"
+	},
+	{
+		"restore",
+		(PyCFunction)m_restore,
+		METH_O | METH_CLASS,
+		"Speller.restore(snapshot) => Speller\n"
+		"Create speller from a result of snapshot()"
+	},
+	{
+		"__reduce__",
+		(PyCFunction)m_reduce,
+		METH_NOARGS,
+		"Support pickling, based on snapshot() and restore()"
+	},
+	{
+		"loadSessionFile",
+		(PyCFunction)m_loadSessionFile,
+		METH_VARARGS,
+		"loadSessionFile(path) => int\n"
+		"Add words from file, one per line in the speller's encoding,\n"
+		"to the session dictionary; returns number of words added"
+	},
+	{
+		"suggestMany",
+		(PyCFunction)m_suggestMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"suggestMany(words, threads=None) => list of lists of words\n"
+		"Returns suggestions for each word, computed in parallel by given\n"
+		"number of threads (by default one). Each additional thread uses\n"
+		"own speller, with own copy of the dictionary."
+	},
+	{
+		"addReplacement",
+		(PyCFunction)(void(*)(void))m_addReplacement,
+		METH_FASTCALL,
+		"addReplacement(misspeled word, correct word) => None\n"
+		"Add a replacement pair, i.e. a misspeled and correct words.\n"
+		"For example 'teh' and 'the'."
+	},
+	{
+		"exportWordlist",
+		(PyCFunction)m_exportWordlist,
+		METH_VARARGS,
+		"exportWordlist(path) => None\n"
+		"Writes words of the main and personal word lists into a sorted\n"
+		"binary file, which can be opened with aspell.MappedWordlist.\n"
+		"Only root words are written, forms made by affix rules are not."
+	},
+	{
+		"clone",
+		(PyCFunction)m_clone,
+		METH_NOARGS,
+		"clone() => Speller\n"
+		"Creates a new speller with the same config, session and personal\n"
+		"words and replacements; dictionaries already loaded are reused."
+	},
+	{
+		"setSuggestCache",
+		(PyCFunction)m_setSuggestCache,
+		METH_VARARGS | METH_KEYWORDS,
+		"setSuggestCache(entries, bytes=0) => None\n"
+		"Enables LRU cache of suggest() results limited to given number\n"
+		"of entries and/or estimated size in bytes (0 means no limit).\n"
+		"setSuggestCache(0) disables the cache."
+	},
+	{
+		"clearSuggestCache",
+		(PyCFunction)m_clearSuggestCache,
+		METH_NOARGS,
+		"clearSuggestCache() => None\n"
+		"Removes all entries from the suggestions cache."
+	},
+	{
+		"suggestCacheStats",
+		(PyCFunction)m_suggestCacheStats,
+		METH_NOARGS,
+		"suggestCacheStats() => dictionary\n"
+		"Returns state and counters of the suggestions cache."
+	},
+	{
+		"stats",
+		(PyCFunction)m_stats,
+		METH_NOARGS,
+		"stats() => dictionary\n"
+		"Returns counters and latency histograms of check, checkMany,\n"
+		"checkDocument, suggest and suggestMany."
+	},
+	{
+		"resetStats",
+		(PyCFunction)m_resetStats,
+		METH_NOARGS,
+		"resetStats() => None\n"
+		"Zeroes all counters returned by stats()."
+	},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot speller_slots[] = {
+	{Py_tp_dealloc, speller_dealloc},
+	{Py_tp_traverse, speller_traverse},
+	{Py_tp_methods, aspell_object_methods},
+	{Py_tp_new, new_speller},
+	{Py_sq_contains, m_contains},
+	{0, NULL}
+};
+
+static PyType_Spec speller_spec = {
+	"aspell.Speller",
+	sizeof(aspell_AspellObject),
+	0,
+	ASPELL_TPFLAGS,
+	speller_slots
+};
+
+
+/* SpellerPool ****************************************************************/
+
+/* A pool of spellers sharing the same config. Spellers are checked out
+   and returned; bookkeeping is done under the GIL (a critical section on
+   the pool in free-threaded builds), while threads waiting for a free
+   speller sleep on lock 'available' with the GIL released. */
+typedef struct {
+	PyObject_HEAD
+	PyObject* spellers;		/* list of all spellers */
+	Py_ssize_t size;		/* number of spellers */
+	Py_ssize_t* free;		/* stack of indices of free spellers */
+	Py_ssize_t nfree;
+	long long* busy_since;	/* checkout time of each speller, -1 if free */
+	long long timeout;		/* default timeout [us], -1 means wait forever */
+
+	PyThread_type_lock available;	/* released when a waiter may try again */
+	int signaled;			/* 'available' is released */
+	Py_ssize_t waiting;		/* number of threads waiting for a speller */
+
+	/* statistics */
+	long long created;
+	unsigned long long checkouts;
+	unsigned long long waits;
+	unsigned long long timeouts;
+	long long wait_time;
+	long long busy_time;
+	Py_ssize_t max_busy;
+} aspell_PoolObject;
+
+#define Pool(pyobject) ((aspell_PoolObject*)pyobject)
+
+/* helper function: converts timeout given in seconds (or None) to us */
+static int parse_timeout(PyObject* obj, long long* timeout) {
+	double seconds;
+
+	if (obj == NULL || obj == Py_None) {
+		*timeout = -1;
+		return 0;
+	}
+
+	seconds = PyFloat_AsDouble(obj);
+	if (seconds == -1.0 && PyErr_Occurred())
+		return -1;
+
+	if (seconds < 0) {
+		PyErr_SetString(PyExc_ValueError, "timeout must be a non-negative number or None");
+		return -1;
+	}
+
+	if (seconds * 1e6 > (double)PY_TIMEOUT_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "timeout is too large");
+		return -1;
+	}
+
+	*timeout = (long long)(seconds * 1e6);
+	return 0;
+}
+
+/* lets one waiting thread check the pool again */
+static void pool_signal(aspell_PoolObject* pool) {
+	if (pool->waiting > 0 && pool->nfree > 0 && !pool->signaled) {
+		pool->signaled = 1;
+		PyThread_release_lock(pool->available);
+	}
+}
+
+/* helper function: takes a free speller out of the pool,
+   returns its index or -1 when timeout expired; must be called within
+   a critical section on the pool, which is suspended while waiting */
+static Py_ssize_t pool_acquire_locked(aspell_PoolObject* pool, long long timeout) {
+	Py_ssize_t index;
+	long long start, now, remaining;
+	PyLockStatus status;
+
+	start = monotonic_ns();
+	if (pool->nfree == 0 || pool->waiting > 0) {
+		pool->waits += 1;
+		pool->waiting += 1;
+
+		remaining = timeout;
+		while (1) {
+			Py_BEGIN_ALLOW_THREADS
+			status = PyThread_acquire_lock_timed(pool->available, remaining, 0);
+			Py_END_ALLOW_THREADS
+
+			now = monotonic_ns();
+			if (status == PY_LOCK_ACQUIRED) {
+				pool->signaled = 0;
+				if (pool->nfree > 0)
+					break;
+			}
+
+			if (timeout >= 0) {
+				remaining = timeout - (now - start) / 1000;
+				if (remaining <= 0 && pool->nfree == 0) {
+					pool->waiting -= 1;
+					pool->timeouts += 1;
+					pool->wait_time += now - start;
+					PyErr_SetString(PyExc_TimeoutError, "no speller available in the pool");
+					return -1;
+				}
+
+				if (remaining < 0)
+					remaining = 0;
+			}
+		}
+
+		pool->waiting -= 1;
+		pool->wait_time += now - start;
+	}
+	else
+		now = start;
+
+	index = pool->free[--pool->nfree];
+	pool->busy_since[index] = now;
+	pool->checkouts += 1;
+	if (pool->size - pool->nfree > pool->max_busy)
+		pool->max_busy = pool->size - pool->nfree;
+
+	/* pass the baton if there are still free spellers */
+	pool_signal(pool);
+	return index;
+}
+
+static Py_ssize_t pool_acquire(aspell_PoolObject* pool, long long timeout) {
+	Py_ssize_t index;
+
+	Py_BEGIN_CRITICAL_SECTION(pool);
+	index = pool_acquire_locked(pool, timeout);
+	Py_END_CRITICAL_SECTION();
+
+	return index;
+}
+
+/* helper function: puts back a speller; must be called within
+   a critical section on the pool */
+static void pool_release_locked(aspell_PoolObject* pool, Py_ssize_t index) {
+	pool->busy_time += monotonic_ns() - pool->busy_since[index];
+	pool->busy_since[index] = -1;
+	pool->free[pool->nfree++] = index;
+	pool_signal(pool);
+}
+
+static void pool_release(aspell_PoolObject* pool, Py_ssize_t index) {
+	Py_BEGIN_CRITICAL_SECTION(pool);
+	pool_release_locked(pool, index);
+	Py_END_CRITICAL_SECTION();
+}
+
+/* Create a new pool **********************************************************/
+static PyObject* new_pool(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+	aspell_PoolObject* pool;
+	PyObject* config;
+	PyObject* speller;
+	PyObject* timeout = NULL;
+	Py_ssize_t size;
+	Py_ssize_t i;
+
+	if (kwargs != NULL && PyDict_Size(kwargs) > 0) {
+		timeout = PyDict_GetItemString(kwargs, "timeout");
+		if (timeout == NULL || PyDict_Size(kwargs) > 1) {
+			PyErr_SetString(PyExc_TypeError, "the only keyword argument accepted is 'timeout'");
+			return NULL;
+		}
+	}
+
+	if (PyTuple_Size(args) < 1) {
+		PyErr_SetString(PyExc_TypeError, "SpellerPool(size, *config) expected");
+		return NULL;
+	}
+
+	size = PyLong_AsSsize_t(PyTuple_GET_ITEM(args, 0));
+	if (size == -1 && PyErr_Occurred())
+		return NULL;
+
+	if (size < 1) {
+		PyErr_SetString(PyExc_ValueError, "size of pool must be positive");
+		return NULL;
+	}
+
+	pool = (aspell_PoolObject*)type->tp_alloc(type, 0);
+	if (pool == NULL)
+		return NULL;
+
+	pool->size		= size;
+	pool->spellers	= NULL;
+	pool->free		= PyMem_New(Py_ssize_t, size);
+	pool->busy_since = PyMem_New(long long, size);
+	pool->available = PyThread_allocate_lock();
+	pool->nfree		= 0;
+	pool->signaled	= 0;
+	pool->waiting	= 0;
+	pool->checkouts	= 0;
+	pool->waits		= 0;
+	pool->timeouts	= 0;
+	pool->wait_time	= 0;
+	pool->busy_time	= 0;
+	pool->max_busy	= 0;
+
+	/* waiters have to block until a speller is returned */
+	if (pool->available)
+		PyThread_acquire_lock(pool->available, WAIT_LOCK);
+
+	if (pool->free == NULL || pool->busy_since == NULL || pool->available == NULL) {
+		Py_DECREF(pool);
+		return PyErr_NoMemory();
+	}
+
+	if (parse_timeout(timeout, &pool->timeout) < 0) {
+		Py_DECREF(pool);
+		return NULL;
+	}
+
+	pool->spellers = PyList_New(size);
+	config = PyTuple_GetSlice(args, 1, PyTuple_GET_SIZE(args));
+	if (pool->spellers == NULL || config == NULL) {
+		Py_XDECREF(config);
+		Py_DECREF(pool);
+		return NULL;
+	}
+
+	for (i=0; i < size; i++) {
+		speller = PyObject_Call((PyObject*)state_of_type(type)->speller_type, config, NULL);
+		if (speller == NULL) {
+			Py_DECREF(config);
+			Py_DECREF(pool);
+			return NULL;
+		}
+
+		PyList_SET_ITEM(pool->spellers, i, speller);
+		pool->free[pool->nfree++] = size - 1 - i;
+		pool->busy_since[i] = -1;
+	}
+
+	Py_DECREF(config);
+	pool->created = monotonic_ns();
+	return (PyObject*)pool;
+}
+
+/* Delete pool ****************************************************************/
+static void pool_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	aspell_PoolObject* pool = Pool(self);
+
+	PyObject_GC_UnTrack(self);
+	Py_XDECREF(pool->spellers);
+	PyMem_Free(pool->free);
+	PyMem_Free(pool->busy_since);
+	if (pool->available) {
+		if (!pool->signaled)
+			PyThread_release_lock(pool->available);
+		PyThread_free_lock(pool->available);
+	}
+
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+static int pool_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(Pool(self)->spellers);
+	return 0;
+}
+
+static int pool_clear(PyObject* self) {
+	Py_CLEAR(Pool(self)->spellers);
+	return 0;
+}
+
+/* method:checkout ************************************************************/
+static PyObject* pool_checkout(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"timeout", NULL};
+	aspell_PoolObject* pool = Pool(self);
+	PyObject* obj = NULL;
+	long long timeout;
+	Py_ssize_t index;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwlist, &obj))
+		return NULL;
+
+	if (obj == NULL)
+		timeout = pool->timeout;
+	else if (parse_timeout(obj, &timeout) < 0)
+		return NULL;
+
+	index = pool_acquire(pool, timeout);
+	if (index < 0)
+		return NULL;
+
+	obj = PyList_GET_ITEM(pool->spellers, index);
+	Py_INCREF(obj);
+	return obj;
+}
+
+/* method:checkin *************************************************************/
+static PyObject* pool_checkin(PyObject* self, PyObject* args) {
+	aspell_PoolObject* pool = Pool(self);
+	PyObject* speller;
+	const char* error = NULL;
+	Py_ssize_t i;
+
+	if (!PyArg_ParseTuple(args, "O", &speller))
+		return NULL;
+
+	for (i=0; i < pool->size; i++)
+		if (PyList_GET_ITEM(pool->spellers, i) == speller)
+			break;
+
+	if (i == pool->size) {
+		PyErr_SetString(PyExc_ValueError, "speller doesn't belong to the pool");
+		return NULL;
+	}
+
+	/* two threads mustn't return the same speller */
+	Py_BEGIN_CRITICAL_SECTION(pool);
+	if (pool->busy_since[i] < 0)
+		error = "speller is not checked out";
+	else
+		pool_release_locked(pool, i);
+	Py_END_CRITICAL_SECTION();
+
+	if (error) {
+		PyErr_SetString(PyExc_ValueError, error);
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+/* helper function: calls a speller's method on a free speller */
+static PyObject* pool_call(
+	PyObject* self,
+	PyObject* (*method)(PyObject*, PyObject*, PyObject*),
+	PyObject* args,
+	PyObject* kwargs
+) {
+	aspell_PoolObject* pool = Pool(self);
+	PyObject* result;
+	Py_ssize_t index;
+
+	index = pool_acquire(pool, pool->timeout);
+	if (index < 0)
+		return NULL;
+
+	result = method(PyList_GET_ITEM(pool->spellers, index), args, kwargs);
+	pool_release(pool, index);
+	return result;
+}
+
+static PyObject* m_check_kw(PyObject* self, PyObject* args, PyObject* kwargs) {
+	return m_check(self, &PyTuple_GET_ITEM(args, 0), PyTuple_GET_SIZE(args));
+}
+
+static PyObject* m_suggest_kw(PyObject* self, PyObject* args, PyObject* kwargs) {
+	PyObject* word;
+	PyObject* limit_obj = NULL;
+	PyObject* mode_obj = NULL;
+	Py_ssize_t limit;
+	const char* mode;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", (char**)suggest_kwlist, &word, &limit_obj, &mode_obj))
+		return NULL;
+
+	if (parse_suggest_options(limit_obj, mode_obj, &limit, &mode) < 0)
+		return NULL;
+
+	return suggest_word(self, word, limit, mode);
+}
+
+/* method:check ***************************************************************/
+static PyObject* pool_check(PyObject* self, PyObject* args) {
+	return pool_call(self, m_check_kw, args, NULL);
+}
+
+/* method:checkMany ***********************************************************/
+static PyObject* pool_checkMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	return pool_call(self, m_checkMany, args, kwargs);
+}
+
+/* method:suggest *************************************************************/
+static PyObject* pool_suggest(PyObject* self, PyObject* args, PyObject* kwargs) {
+	return pool_call(self, m_suggest_kw, args, kwargs);
+}
+
+/* method:stats ***************************************************************/
+static PyObject* pool_stats(PyObject* self, PyObject* args) {
+	aspell_PoolObject* pool = Pool(self);
+	PyObject* result;
+	long long now, busy_time, elapsed;
+	Py_ssize_t i;
+
+	Py_BEGIN_CRITICAL_SECTION(pool);
+	now = monotonic_ns();
+	busy_time = pool->busy_time;
+	for (i=0; i < pool->size; i++)
+		if (pool->busy_since[i] >= 0)
+			busy_time += now - pool->busy_since[i];
+
+	elapsed = now - pool->created;
+
+	result = Py_BuildValue(
+		"{s:n,s:n,s:n,s:n,s:K,s:K,s:K,s:d,s:d,s:d}",
+		"size",			pool->size,
+		"free",			pool->nfree,
+		"waiting",		pool->waiting,
+		"max_busy",		pool->max_busy,
+		"checkouts",	pool->checkouts,
+		"waits",		pool->waits,
+		"timeouts",		pool->timeouts,
+		"wait_time",	pool->wait_time / 1e9,
+		"busy_time",	busy_time / 1e9,
+		"utilisation",	elapsed > 0 ? (double)busy_time / ((double)elapsed * pool->size) : 0.0
+	);
+	Py_END_CRITICAL_SECTION();
+
+	return result;
+}
+
+/* len(pool) ******************************************************************/
+static Py_ssize_t pool_length(PyObject* self) {
+	return Pool(self)->size;
+}
+
+static PyMethodDef aspell_pool_methods[] = {
+	{
+		"checkout",
+		(PyCFunction)pool_checkout,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkout(timeout=pool's timeout) => Speller\n"
+		"Takes a free speller from the pool, waits if all are in use.\n"
+		"TimeoutError is raised if no speller became free in time.\n"
+		"The speller has to be returned with checkin()."
+	},
+	{
+		"checkin",
+		(PyCFunction)pool_checkin,
+		METH_VARARGS,
+		"checkin(speller) => None\n"
+		"Returns a speller obtained with checkout() to the pool."
+	},
+	{
+		"check",
+		(PyCFunction)pool_check,
+		METH_VARARGS,
+		"check(word) => bool\n"
+		"Checks spelling of word using a free speller."
+	},
+	{
+		"checkMany",
+		(PyCFunction)pool_checkMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkMany(words, indices=False) => bytearray or list of integers\n"
+		"Same as Speller.checkMany(), uses a free speller."
+	},
+	{
+		"suggest",
+		(PyCFunction)pool_suggest,
+		METH_VARARGS | METH_KEYWORDS,
+		"suggest(word, limit=None, mode=None) => list of words\n"
+		"Returns a list of suggested spelling for given word using a free speller."
+	},
+	{
+		"stats",
+		(PyCFunction)pool_stats,
+		METH_NOARGS,
+		"stats() => dictionary\n"
+		"Returns pool statistics: size, free, waiting, max_busy, checkouts,\n"
+		"waits, timeouts, wait_time and busy_time (in seconds) and utilisation\n"
+		"(busy time of all spellers divided by pool's lifetime times size)."
+	},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot pool_slots[] = {
+	{Py_tp_dealloc, pool_dealloc},
+	{Py_tp_traverse, pool_traverse},
+	{Py_tp_clear, pool_clear},
+	{Py_tp_doc,
+		"SpellerPool(size, *config, timeout=None)\n"
+		"A pool of spellers created with the same config."},
+	{Py_tp_methods, aspell_pool_methods},
+	{Py_tp_new, new_pool},
+	{Py_sq_length, pool_length},
+	{0, NULL}
+};
+
+static PyType_Spec pool_spec = {
+	"aspell.SpellerPool",
+	sizeof(aspell_PoolObject),
+	0,
+	ASPELL_TPFLAGS,
+	pool_slots
+};
+
+
+/* ThreadLocalSpeller *********************************************************/
+
+/* Each thread gets its own speller, created on the first use. */
+typedef struct {
+	PyObject_HEAD
+	PyObject* config;	/* constructor arguments of spellers */
+	PyObject* local;	/* threading.local instance */
+	unsigned long long created;	/* number of spellers created so far */
+} aspell_LocalObject;
+
+#define Local(pyobject) ((aspell_LocalObject*)pyobject)
+
+/* Create a new thread-local speller ******************************************/
+static PyObject* new_local(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+	aspell_LocalObject* local;
+	PyObject* module;
+	PyObject* speller;
+
+	if (kwargs != NULL && PyDict_Size(kwargs) > 0) {
+		PyErr_SetString(PyExc_TypeError, "keyword arguments are not accepted");
+		return NULL;
+	}
+
+	/* create a speller in the current thread, this validates config */
+	speller = PyObject_Call((PyObject*)state_of_type(type)->speller_type, args, NULL);
+	if (speller == NULL)
+		return NULL;
+
+	local = (aspell_LocalObject*)type->tp_alloc(type, 0);
+	if (local == NULL) {
+		Py_DECREF(speller);
+		return NULL;
+	}
+
+	Py_INCREF(args);
+	local->config  = args;
+	local->local   = NULL;
+	local->created = 1;
+
+	module = PyImport_ImportModule("threading");
+	if (module != NULL) {
+		local->local = PyObject_CallMethod(module, "local", NULL);
+		Py_DECREF(module);
+	}
+
+	if (local->local == NULL || PyObject_SetAttrString(local->local, "speller", speller) < 0) {
+		Py_DECREF(speller);
+		Py_DECREF(local);
+		return NULL;
+	}
+
+	Py_DECREF(speller);
+	return (PyObject*)local;
+}
+
+/* Delete thread-local speller ************************************************/
+static void local_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+
+	PyObject_GC_UnTrack(self);
+	Py_XDECREF(Local(self)->config);
+	Py_XDECREF(Local(self)->local);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+static int local_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(Local(self)->config);
+	Py_VISIT(Local(self)->local);
+	return 0;
+}
+
+static int local_clear(PyObject* self) {
+	Py_CLEAR(Local(self)->config);
+	Py_CLEAR(Local(self)->local);
+	return 0;
+}
+
+/* helper function: returns speller of the current thread (new reference) */
+static PyObject* local_get(PyObject* self) {
+	aspell_LocalObject* local = Local(self);
+	PyObject* speller;
+
+	speller = PyObject_GetAttrString(local->local, "speller");
+	if (speller != NULL || !PyErr_ExceptionMatches(PyExc_AttributeError))
+		return speller;
+
+	PyErr_Clear();
+	speller = PyObject_Call((PyObject*)state_of(self)->speller_type, local->config, NULL);
+	if (speller == NULL)
+		return NULL;
+
+	if (PyObject_SetAttrString(local->local, "speller", speller) < 0) {
+		Py_DECREF(speller);
+		return NULL;
+	}
+
+	Py_BEGIN_CRITICAL_SECTION(local);
+	local->created += 1;
+	Py_END_CRITICAL_SECTION();
+	return speller;
+}
+
+/* helper function: calls a speller's method on the thread's speller */
+static PyObject* local_call(
+	PyObject* self,
+	PyObject* (*method)(PyObject*, PyObject*, PyObject*),
+	PyObject* args,
+	PyObject* kwargs
+) {
+	PyObject* speller;
+	PyObject* result;
+
+	speller = local_get(self);
+	if (speller == NULL)
+		return NULL;
+
+	result = method(speller, args, kwargs);
+	Py_DECREF(speller);
+	return result;
+}
+
+/* method:speller *************************************************************/
+static PyObject* local_speller(PyObject* self, PyObject* args) {
+	return local_get(self);
+}
+
+/* method:check ***************************************************************/
+static PyObject* local_check(PyObject* self, PyObject* args) {
+	return local_call(self, m_check_kw, args, NULL);
+}
+
+/* method:checkMany ***********************************************************/
+static PyObject* local_checkMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	return local_call(self, m_checkMany, args, kwargs);
+}
+
+/* method:suggest *************************************************************/
+static PyObject* local_suggest(PyObject* self, PyObject* args, PyObject* kwargs) {
+	return local_call(self, m_suggest_kw, args, kwargs);
+}
+
+/* method:stats ***************************************************************/
+static PyObject* local_stats(PyObject* self, PyObject* args) {
+	unsigned long long created;
+
+	Py_BEGIN_CRITICAL_SECTION(self);
+	created = Local(self)->created;
+	Py_END_CRITICAL_SECTION();
+
+	return Py_BuildValue("{s:K}", "created", created);
+}
+
+static PyMethodDef aspell_local_methods[] = {
+	{
+		"speller",
+		(PyCFunction)local_speller,
+		METH_NOARGS,
+		"speller() => Speller\n"
+		"Returns speller of the current thread, creates it if needed."
+	},
+	{
+		"check",
+		(PyCFunction)local_check,
+		METH_VARARGS,
+		"check(word) => bool\n"
+		"Checks spelling of word using speller of the current thread."
+	},
+	{
+		"checkMany",
+		(PyCFunction)local_checkMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkMany(words, indices=False) => bytearray or list of integers\n"
+		"Same as Speller.checkMany(), uses speller of the current thread."
+	},
+	{
+		"suggest",
+		(PyCFunction)local_suggest,
+		METH_VARARGS | METH_KEYWORDS,
+		"suggest(word, limit=None, mode=None) => list of words\n"
+		"Returns a list of suggested spelling for given word using speller of the current thread."
+	},
+	{
+		"stats",
+		(PyCFunction)local_stats,
+		METH_NOARGS,
+		"stats() => dictionary\n"
+		"Returns number of spellers created so far."
+	},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot local_slots[] = {
+	{Py_tp_dealloc, local_dealloc},
+	{Py_tp_traverse, local_traverse},
+	{Py_tp_clear, local_clear},
+	{Py_tp_doc,
+		"ThreadLocalSpeller(*config)\n"
+		"Creates a separate speller for each thread using it."},
+	{Py_tp_methods, aspell_local_methods},
+	{Py_tp_new, new_local},
+	{0, NULL}
+};
+
+static PyType_Spec local_spec = {
+	"aspell.ThreadLocalSpeller",
+	sizeof(aspell_LocalObject),
+	0,
+	ASPELL_TPFLAGS,
+	local_slots
+};
+
+
+/* MultiSpeller ***************************************************************/
+
+/* Checks words against several spellers, e.g. dictionaries of different
+   languages; a word is correct if any of them accepts it. Spellers are
+   asked in the given order and the first one accepting a word wins.
+   Methods reuse methods of spellers, thus caches, statistics and
+   releasing the GIL work as for a single speller. */
+typedef struct {
+	PyObject_HEAD
+	PyObject* spellers;		/* tuple of member spellers */
+	PyObject* order;		/* tuple of indices of spellers, in order of asking;
+							   replaced as a whole under a critical section */
+} aspell_MultiObject;
+
+#define Multi(pyobject) ((aspell_MultiObject*)pyobject)
+
+/* index of the i-th speller to ask; order holds validated integers */
+#define OrderAt(order, i) PyLong_AsSsize_t(PyTuple_GET_ITEM(order, i))
+
+/* helper function: returns current order (new reference); methods keep
+   it while asking spellers, thus it may be replaced meanwhile */
+static PyObject* multi_order(aspell_MultiObject* multi) {
+	PyObject* order;
+
+	Py_BEGIN_CRITICAL_SECTION(multi);
+	order = multi->order;
+	Py_INCREF(order);
+	Py_END_CRITICAL_SECTION();
+
+	return order;
+}
+
+/* helper function: sets order of spellers from a sequence of distinct indices */
+static int multi_set_order(aspell_MultiObject* multi, PyObject* obj) {
+	PyObject* seq = NULL;
+	PyObject* order;
+	PyObject* index;
+	PyObject* previous;
+	Py_ssize_t n, i, j, k, size;
+
+	size = PyTuple_GET_SIZE(multi->spellers);
+	if (obj == NULL || obj == Py_None) {
+		order = PyTuple_New(size);
+		if (order == NULL)
+			return -1;
+
+		for (i=0; i < size; i++) {
+			index = PyLong_FromSsize_t(i);
+			if (index == NULL)
+				goto error;
+
+			PyTuple_SET_ITEM(order, i, index);
+		}
+	}
+	else {
+		seq = PySequence_Fast(obj, "order must be a sequence of indices of spellers");
+		if (seq == NULL)
+			return -1;
+
+		n = PySequence_Fast_GET_SIZE(seq);
+		if (n == 0) {
+			Py_DECREF(seq);
+			PyErr_SetString(PyExc_ValueError, "order must not be empty");
+			return -1;
+		}
+
+		order = PyTuple_New(n);
+		if (order == NULL) {
+			Py_DECREF(seq);
+			return -1;
+		}
+
+		for (i=0; i < n; i++) {
+			k = PyNumber_AsSsize_t(PySequence_Fast_GET_ITEM(seq, i), PyExc_OverflowError);
+			if (k == -1 && PyErr_Occurred())
+				goto error;
+
+			if (k < 0 || k >= size) {
+				PyErr_Format(PyExc_ValueError, "index of speller %zd out of range", k);
+				goto error;
+			}
+
+			for (j=0; j < i; j++)
+				if (OrderAt(order, j) == k) {
+					PyErr_Format(PyExc_ValueError, "speller %zd given twice", k);
+					goto error;
+				}
+
+			index = PyLong_FromSsize_t(k);
+			if (index == NULL)
+				goto error;
+
+			PyTuple_SET_ITEM(order, i, index);
+		}
+
+		Py_DECREF(seq);
+	}
+
+	Py_BEGIN_CRITICAL_SECTION(multi);
+	previous = multi->order;
+	multi->order = order;
+	Py_END_CRITICAL_SECTION();
+
+	Py_XDECREF(previous);
+	return 0;
+
+error:
+	Py_DECREF(order);
+	Py_XDECREF(seq);
+	return -1;
+}
+
+/* Create a new multi-speller *************************************************/
+static PyObject* new_multi(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"spellers", "order", NULL};
+	aspell_MultiObject* multi;
+	PyObject* configs;
+	PyObject* order = NULL;
+	PyObject* seq;
+	PyObject* item;
+	PyObject* config;
+	PyObject* speller;
+	Py_ssize_t i, n;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:MultiSpeller", kwlist, &configs, &order))
+		return NULL;
+
+	seq = PySequence_Fast(configs, "MultiSpeller() argument must be a sequence of configs or spellers");
+	if (seq == NULL)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE(seq);
+	if (n == 0) {
+		Py_DECREF(seq);
+		PyErr_SetString(PyExc_ValueError, "at least one speller is required");
+		return NULL;
+	}
+
+	multi = (aspell_MultiObject*)type->tp_alloc(type, 0);
+	if (multi == NULL) {
+		Py_DECREF(seq);
+		return NULL;
+	}
+
+	multi->order	= NULL;
+	multi->spellers	= PyTuple_New(n);
+	if (multi->spellers == NULL)
+		goto error;
+
+	/* a config is passed to Speller() as is: a pair of strings
+	   or a sequence of pairs; existing spellers are shared */
+	for (i=0; i < n; i++) {
+		item = PySequence_Fast_GET_ITEM(seq, i);
+		if (PyObject_TypeCheck(item, state_of_type(type)->speller_type)) {
+			Py_INCREF(item);
+			speller = item;
+		}
+		else {
+			config = PySequence_Tuple(item);
+			if (config == NULL) {
+				PyErr_Format(PyExc_TypeError, "speller #%zd: config or Speller expected", i);
+				goto error;
+			}
+
+			speller = PyObject_Call((PyObject*)state_of_type(type)->speller_type, config, NULL);
+			Py_DECREF(config);
+			if (speller == NULL)
+				goto error;
+		}
+
+		PyTuple_SET_ITEM(multi->spellers, i, speller);
+	}
+
+	if (multi_set_order(multi, order) < 0)
+		goto error;
+
+	Py_DECREF(seq);
+	return (PyObject*)multi;
+
+error:
+	Py_DECREF(seq);
+	Py_DECREF(multi);
+	return NULL;
+}
+
+/* Delete multi-speller *******************************************************/
+static void multi_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+
+	PyObject_GC_UnTrack(self);
+	Py_XDECREF(Multi(self)->spellers);
+	Py_XDECREF(Multi(self)->order);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+static int multi_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(Multi(self)->spellers);
+	Py_VISIT(Multi(self)->order);
+	return 0;
+}
+
+static int multi_clear(PyObject* self) {
+	Py_CLEAR(Multi(self)->spellers);
+	Py_CLEAR(Multi(self)->order);
+	return 0;
+}
+
+/* helper function: true if the error means that word can't be expressed
+   in speller's encoding, thus the speller can't accept it */
+static int multi_unencodable(void) {
+	if (PyErr_ExceptionMatches(PyExc_UnicodeEncodeError)) {
+		PyErr_Clear();
+		return 1;
+	}
+
+	return 0;
+}
+
+/* helper function: returns index of the first speller accepting word,
+   -1 if none does, -2 on error */
+static Py_ssize_t multi_which_word(aspell_MultiObject* multi, PyObject* word) {
+	PyObject* order;
+	Py_ssize_t i, k, which = -1;
+
+	order = multi_order(multi);
+	for (i=0; i < PyTuple_GET_SIZE(order); i++) {
+		k = OrderAt(order, i);
+		switch (m_contains(PyTuple_GET_ITEM(multi->spellers, k), word)) {
+			case 1:
+				which = k;
+				goto done;
+
+			case 0:
+				break;
+
+			default:
+				if (!multi_unencodable()) {
+					which = -2;
+					goto done;
+				}
+		}
+	}
+
+done:
+	Py_DECREF(order);
+	return which;
+}
+
+/* __contains__ ***************************************************************/
+static int multi_contains(PyObject* self, PyObject* word) {
+	Py_ssize_t k;
+
+	k = multi_which_word(Multi(self), word);
+	if (k == -2)
+		return -1;
+
+	return k >= 0;
+}
+
+/* method:check ***************************************************************/
+static PyObject* multi_check(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	if (check_nargs("check", nargs, 1) < 0)
+		return NULL;
+
+	switch (multi_contains(self, args[0])) {
+		case 0:
+			Py_RETURN_FALSE;
+
+		case 1:
+			Py_RETURN_TRUE;
+
+		default:
+			return NULL;
+	}
+}
+
+/* method:which ***************************************************************/
+static PyObject* multi_which(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	Py_ssize_t k;
+
+	if (check_nargs("which", nargs, 1) < 0)
+		return NULL;
+
+	k = multi_which_word(Multi(self), args[0]);
+	if (k == -2)
+		return NULL;
+
+	return PyLong_FromSsize_t(k);
+}
+
+/* helper function: checks all words with a single speller; mask[i] is set
+   to 1 for accepted words; returns -1 on error */
+static int multi_check_with(PyObject* speller, PyObject* words, char* mask) {
+	PyObject* args;
+	PyObject* result;
+	Py_ssize_t i, n;
+	int correct;
+
+	args = PyTuple_Pack(1, words);
+	if (args == NULL)
+		return -1;
+
+	result = m_checkMany(speller, args, NULL);
+	Py_DECREF(args);
+	if (result != NULL) {
+		memcpy(mask, PyByteArray_AS_STRING(result), PyByteArray_GET_SIZE(result));
+		Py_DECREF(result);
+		return 0;
+	}
+
+	if (!PyErr_ExceptionMatches(PyExc_UnicodeEncodeError))
+		return -1;
+
+	/* some words aren't representable in speller's encoding */
+	PyErr_Clear();
+	n = PyList_GET_SIZE(words);
+	for (i=0; i < n; i++) {
+		correct = m_contains(speller, PyList_GET_ITEM(words, i));
+		if (correct < 0) {
+			if (!multi_unencodable())
+				return -1;
+
+			correct = 0;
+		}
+
+		mask[i] = (char)correct;
+	}
+
+	return 0;
+}
+
+/* helper function: returns list of indices of spellers accepting words,
+   -1 for rejected words; each speller checks in a single call all words
+   rejected by the preceding ones */
+static PyObject* multi_which_many(aspell_MultiObject* multi, PyObject* words) {
+	PyObject* seq;
+	PyObject* order;
+	PyObject* pending = NULL;	/* words not accepted yet */
+	PyObject* rest;
+	PyObject* result = NULL;
+	PyObject* index;
+	Py_ssize_t* which = NULL;
+	Py_ssize_t* position = NULL;	/* index of pending word in words */
+	char* mask = NULL;
+	Py_ssize_t i, j, k, n, npending, nrest;
+
+	seq = PySequence_Fast(words, "argument must be an iterable of strings");
+	if (seq == NULL)
 		return NULL;
+
+	order = multi_order(multi);
+	n = PySequence_Fast_GET_SIZE(seq);
+	which    = PyMem_New(Py_ssize_t, n);
+	position = PyMem_New(Py_ssize_t, n);
+	mask     = PyMem_Malloc(n > 0 ? n : 1);
+	pending  = PySequence_List(seq);
+	if (which == NULL || position == NULL || mask == NULL) {
+		PyErr_NoMemory();
+		goto cleanup;
 	}
 
-	switch (info->type) {
-		case AspellKeyInfoList:
-			// Can't figure out the splitting char for lists,
-			// it seems to be the ':', but doesn't work.
-		case AspellKeyInfoString:
-			value = get_single_arg_string(self, arg1, &string, &length);
-			if (value == NULL) {
-				PyErr_Format(PyExc_TypeError, "second argument have to be string");
-				return NULL;
-			}
+	if (pending == NULL)
+		goto cleanup;
 
-			aspell_config_replace(config, key, string);
-			Py_DECREF(value);
-			break;
+	for (i=0; i < n; i++) {
+		which[i] = -1;
+		position[i] = i;
+	}
 
-		case AspellKeyInfoInt:
-			number = PyLong_AsLong(arg1);
-			if (number == -1 && PyErr_Occurred()) {
-				return NULL;
-			}
+	npending = n;
+	for (k=0; k < PyTuple_GET_SIZE(order) && npending > 0; k++) {
+		if (multi_check_with(PyTuple_GET_ITEM(multi->spellers, OrderAt(order, k)), pending, mask) < 0)
+			goto cleanup;
 
-			snprintf(buffer, 32, "%ld", number);
-			aspell_config_replace(config, key, buffer);
-			break;
+		nrest = 0;
+		for (i=0; i < npending; i++) {
+			if (mask[i])
+				which[position[i]] = OrderAt(order, k);
+			else
+				nrest += 1;
+		}
 
-		case AspellKeyInfoBool:
-			if (PyBool_Check(arg1)) {
-				aspell_config_replace(config, key, (arg1 == Py_True) ? "true" : "false");
-			} else {
-				PyErr_Format(PyExc_TypeError, "second argument have to be boolean");
-				return NULL;
-			}
-			break;
+		if (nrest == npending)
+			continue;
 
-		default:
-			PyErr_Format(_AspellModuleException, "unsupported aspell config item type");
-			return NULL;
+		rest = PyList_New(nrest);
+		if (rest == NULL)
+			goto cleanup;
+
+		for (i=0, j=0; i < npending; i++) {
+			if (mask[i])
+				continue;
+
+			index = PyList_GET_ITEM(pending, i);
+			Py_INCREF(index);
+			PyList_SET_ITEM(rest, j, index);
+			position[j++] = position[i];
+		}
+
+		Py_DECREF(pending);
+		pending = rest;
+		npending = nrest;
 	}
 
-	if (aspell_config_error(config) != 0) {
-		PyErr_SetString(_AspellConfigException, aspell_config_error_message(config));
-		return NULL;
+	result = PyList_New(n);
+	if (result == NULL)
+		goto cleanup;
+
+	for (i=0; i < n; i++) {
+		index = PyLong_FromSsize_t(which[i]);
+		if (index == NULL) {
+			Py_CLEAR(result);
+			goto cleanup;
+		}
+
+		PyList_SET_ITEM(result, i, index);
 	}
 
-	Py_RETURN_NONE;
+cleanup:
+	PyMem_Free(which);
+	PyMem_Free(position);
+	PyMem_Free(mask);
+	Py_XDECREF(pending);
+	Py_DECREF(order);
+	Py_DECREF(seq);
+	return result;
 }
 
+/* method:checkMany ***********************************************************/
+static PyObject* multi_checkMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"words", "indices", NULL};
+	PyObject* words;
+	PyObject* which;
+	PyObject* result = NULL;
+	PyObject* index;
+	Py_ssize_t i, n;
+	int indices = 0;
 
-static PyObject* get_single_arg_string(
-	PyObject* self,	// [in]
-	PyObject* obj,	// [in]
-	char** word,		// [out]
-	Py_ssize_t* size	// [out]
-) {
-	PyObject* buf;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", kwlist, &words, &indices))
+		return NULL;
 
-	/* unicode */
-	if (PyUnicode_Check(obj))
-		/* convert to buffer */
-		buf = PyUnicode_AsEncodedString(obj, Encoding(self), "strict");
-	else
-	/* buffer */
-	if (PyBytes_Check(obj)) {
-		buf = obj;
-		Py_INCREF(buf);	// PyTuple_GetItem returns borrowed reference
+	which = multi_which_many(Multi(self), words);
+	if (which == NULL)
+		return NULL;
+
+	n = PyList_GET_SIZE(which);
+	if (!indices) {
+		result = PyByteArray_FromStringAndSize(NULL, n);
+		if (result != NULL)
+			for (i=0; i < n; i++)
+				PyByteArray_AS_STRING(result)[i] = PyLong_AsSsize_t(PyList_GET_ITEM(which, i)) >= 0;
+
+		Py_DECREF(which);
+		return result;
 	}
-	else {
-		PyErr_SetString(PyExc_TypeError, "string of bytes required");
+
+	result = PyList_New(0);
+	for (i=0; result != NULL && i < n; i++) {
+		if (PyLong_AsSsize_t(PyList_GET_ITEM(which, i)) >= 0)
+			continue;
+
+		index = PyLong_FromSsize_t(i);
+		if (index == NULL || PyList_Append(result, index) == -1)
+			Py_CLEAR(result);
+
+		Py_XDECREF(index);
+	}
+
+	Py_DECREF(which);
+	return result;
+}
+
+/* method:whichMany ***********************************************************/
+static PyObject* multi_whichMany(PyObject* self, PyObject* const* args, Py_ssize_t nargs) {
+	if (check_nargs("whichMany", nargs, 1) < 0)
 		return NULL;
+
+	return multi_which_many(Multi(self), args[0]);
+}
+
+/* helper function: appends the first limit words from list to result,
+   skipping words already present */
+static int multi_merge(PyObject* result, PyObject* seen, PyObject* list, Py_ssize_t limit) {
+	PyObject* word;
+	Py_ssize_t i, n;
+	int present;
+
+	n = PyList_GET_SIZE(list);
+	if (limit >= 0 && limit < n)
+		n = limit;
+
+	for (i=0; i < n; i++) {
+		word = PyList_GET_ITEM(list, i);
+		present = PySet_Contains(seen, word);
+		if (present < 0)
+			return -1;
+
+		if (present)
+			continue;
+
+		if (PySet_Add(seen, word) < 0 || PyList_Append(result, word) < 0)
+			return -1;
 	}
 
-	/* unpack buffer */
-	if (buf) {
-		if (PyBytes_AsStringAndSize(buf, word, size) != -1) {
-			return buf;
+	return 0;
+}
+
+/* method:suggest *************************************************************/
+static PyObject* multi_suggest(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"word", "limit", NULL};
+	aspell_MultiObject* multi = Multi(self);
+	PyObject* word;
+	PyObject* limit_obj = NULL;
+	PyObject* order;
+	PyObject* result;
+	PyObject* seen;
+	PyObject* list;
+	Py_ssize_t limit, i;
+	const char* mode;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", kwlist, &word, &limit_obj))
+		return NULL;
+
+	if (parse_suggest_options(limit_obj, NULL, &limit, &mode) < 0)
+		return NULL;
+
+	order = multi_order(multi);
+	result = PyList_New(0);
+	seen = PySet_New(NULL);
+	if (result == NULL || seen == NULL)
+		goto error;
+
+	for (i=0; i < PyTuple_GET_SIZE(order); i++) {
+		list = suggest_word(PyTuple_GET_ITEM(multi->spellers, OrderAt(order, i)), word, limit, NULL);
+		if (list == NULL) {
+			if (multi_unencodable())
+				continue;
+
+			goto error;
 		}
-		else {
-			Py_DECREF(buf);
-			return NULL;
+
+		if (multi_merge(result, seen, list, limit) < 0) {
+			Py_DECREF(list);
+			goto error;
 		}
+
+		Py_DECREF(list);
 	}
-	else
+
+	Py_DECREF(seen);
+	Py_DECREF(order);
+	return result;
+
+error:
+	Py_XDECREF(seen);
+	Py_XDECREF(result);
+	Py_DECREF(order);
+	return NULL;
+}
+
+/* helper function: returns suggestions of a single speller for all words;
+   None for words not representable in speller's encoding */
+static PyObject* multi_suggest_with(PyObject* speller, PyObject* words, PyObject* threads) {
+	PyObject* args;
+	PyObject* kwargs;
+	PyObject* result;
+	PyObject* list;
+	Py_ssize_t i, n;
+
+	args = PyTuple_Pack(1, words);
+	kwargs = Py_BuildValue("{s:O}", "threads", threads);
+	if (args == NULL || kwargs == NULL) {
+		Py_XDECREF(args);
+		Py_XDECREF(kwargs);
+		return NULL;
+	}
+
+	result = m_suggestMany(speller, args, kwargs);
+	Py_DECREF(args);
+	Py_DECREF(kwargs);
+	if (result != NULL || !multi_unencodable())
+		return result;
+
+	n = PyList_GET_SIZE(words);
+	result = PyList_New(n);
+	for (i=0; result != NULL && i < n; i++) {
+		list = suggest_word(speller, PyList_GET_ITEM(words, i), -1, NULL);
+		if (list == NULL) {
+			if (!multi_unencodable()) {
+				Py_CLEAR(result);
+				break;
+			}
+
+			list = Py_None;
+			Py_INCREF(list);
+		}
+
+		PyList_SET_ITEM(result, i, list);
+	}
+
+	return result;
+}
+
+/* method:suggestMany *********************************************************/
+static PyObject* multi_suggestMany(PyObject* self, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"words", "limit", "threads", NULL};
+	aspell_MultiObject* multi = Multi(self);
+	PyObject* words;
+	PyObject* limit_obj = NULL;
+	PyObject* threads = Py_None;
+	PyObject* seq;
+	PyObject* order;
+	PyObject* result = NULL;
+	PyObject* seen = NULL;
+	PyObject* lists = NULL;
+	PyObject* list;
+	Py_ssize_t limit, i, j, n;
+	const char* mode;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", kwlist, &words, &limit_obj, &threads))
+		return NULL;
+
+	if (parse_suggest_options(limit_obj, NULL, &limit, &mode) < 0)
+		return NULL;
+
+	seq = PySequence_List(words);
+	if (seq == NULL)
 		return NULL;
+
+	order = multi_order(multi);
+	n = PyList_GET_SIZE(seq);
+	result = PyList_New(n);
+	seen = PyList_New(n);
+	if (result == NULL || seen == NULL)
+		goto error;
+
+	for (j=0; j < n; j++) {
+		PyList_SET_ITEM(result, j, PyList_New(0));
+		PyList_SET_ITEM(seen, j, PySet_New(NULL));
+		if (PyList_GET_ITEM(result, j) == NULL || PyList_GET_ITEM(seen, j) == NULL)
+			goto error;
+	}
+
+	/* each speller makes suggestions for all words in parallel */
+	for (i=0; i < PyTuple_GET_SIZE(order); i++) {
+		lists = multi_suggest_with(PyTuple_GET_ITEM(multi->spellers, OrderAt(order, i)), seq, threads);
+		if (lists == NULL)
+			goto error;
+
+		for (j=0; j < n; j++) {
+			list = PyList_GET_ITEM(lists, j);
+			if (list == Py_None)
+				continue;
+
+			if (multi_merge(PyList_GET_ITEM(result, j), PyList_GET_ITEM(seen, j), list, limit) < 0)
+				goto error;
+		}
+
+		Py_CLEAR(lists);
+	}
+
+	Py_DECREF(seen);
+	Py_DECREF(seq);
+	Py_DECREF(order);
+	return result;
+
+error:
+	Py_XDECREF(lists);
+	Py_XDECREF(seen);
+	Py_XDECREF(result);
+	Py_DECREF(seq);
+	Py_DECREF(order);
+	return NULL;
 }
 
+/* attribute:spellers *********************************************************/
+static PyObject* multi_spellers(PyObject* self, void* closure) {
+	Py_INCREF(Multi(self)->spellers);
+	return Multi(self)->spellers;
+}
 
-static PyObject* get_arg_string(
-	PyObject* self,	// [in]
-	PyObject* args,	// [in]
-	const int index,// [in] args[index]
-	char** word,		// [out]
-	Py_ssize_t* size	// [out]
-) {
-	PyObject* obj;
+/* attribute:order ************************************************************/
+static PyObject* multi_get_order(PyObject* self, void* closure) {
+	return multi_order(Multi(self));
+}
 
-	obj = PyTuple_GetItem(args, index);
-	if (obj)
-		return get_single_arg_string(self, obj, word, size);
-	else
+static int multi_set_order_attr(PyObject* self, PyObject* value, void* closure) {
+	if (value == NULL) {
+		PyErr_SetString(PyExc_AttributeError, "can't delete order");
+		return -1;
+	}
+
+	return multi_set_order(Multi(self), value);
+}
+
+/* len(multi) *****************************************************************/
+static Py_ssize_t multi_length(PyObject* self) {
+	return PyTuple_GET_SIZE(Multi(self)->spellers);
+}
+
+static PyMethodDef aspell_multi_methods[] = {
+	{
+		"check",
+		(PyCFunction)(void(*)(void))multi_check,
+		METH_FASTCALL,
+		"check(word) => bool\n"
+		"Checks spelling of word; True if any speller accepts it."
+	},
+	{
+		"which",
+		(PyCFunction)(void(*)(void))multi_which,
+		METH_FASTCALL,
+		"which(word) => int\n"
+		"Returns index of the first speller accepting word, -1 if none does."
+	},
+	{
+		"checkMany",
+		(PyCFunction)multi_checkMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"checkMany(words, indices=False) => bytearray or list of integers\n"
+		"Same as Speller.checkMany(); each speller checks in a single call\n"
+		"the words rejected by the preceding spellers."
+	},
+	{
+		"whichMany",
+		(PyCFunction)(void(*)(void))multi_whichMany,
+		METH_FASTCALL,
+		"whichMany(words) => list of integers\n"
+		"Returns result of which() for each word."
+	},
+	{
+		"suggest",
+		(PyCFunction)multi_suggest,
+		METH_VARARGS | METH_KEYWORDS,
+		"suggest(word, limit=None) => list of words\n"
+		"Returns suggestions of all spellers, in spellers' order and without\n"
+		"duplicates; limit applies to each speller."
+	},
+	{
+		"suggestMany",
+		(PyCFunction)multi_suggestMany,
+		METH_VARARGS | METH_KEYWORDS,
+		"suggestMany(words, limit=None, threads=None) => list of lists of words\n"
+		"Returns result of suggest() for each word; each speller computes\n"
+		"suggestions as Speller.suggestMany() does."
+	},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef aspell_multi_getset[] = {
+	{"spellers", (getter)multi_spellers, NULL, "tuple of spellers", NULL},
+	{"order", (getter)multi_get_order, (setter)multi_set_order_attr, "indices of spellers, in order of asking", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot multi_slots[] = {
+	{Py_tp_dealloc, multi_dealloc},
+	{Py_tp_traverse, multi_traverse},
+	{Py_tp_clear, multi_clear},
+	{Py_tp_doc,
+		"MultiSpeller(spellers, order=None)\n"
+		"Checks words against several spellers, given as configs or Speller objects."},
+	{Py_tp_methods, aspell_multi_methods},
+	{Py_tp_getset, aspell_multi_getset},
+	{Py_tp_new, new_multi},
+	{Py_sq_length, multi_length},
+	{Py_sq_contains, multi_contains},
+	{0, NULL}
+};
+
+static PyType_Spec multi_spec = {
+	"aspell.MultiSpeller",
+	sizeof(aspell_MultiObject),
+	0,
+	ASPELL_TPFLAGS,
+	multi_slots
+};
+
+
+/* MappedWordlist *************************************************************/
+
+/* Read-only view of a file written by Speller.exportWordlist(); the file
+   is memory mapped and searched with binary search, thus it can be shared
+   between processes without loading any dictionary. Words not found are
+   optionally checked by a fallback speller; the file contains only root
+   words, since aspell's API enumerates a dictionary without expanding
+   affixes. */
+typedef struct {
+	PyObject_HEAD
+	MappedFile file;			/* whole file */
+	size_t count;				/* number of words */
+	const unsigned char* offsets;
+	const char* words;
+	char encoding[WORDLIST_ENCODING_SIZE + 1];
+	EncodingKind encoding_kind;
+	PyObject* encoder;			/* for ENCODING_OTHER */
+	PyObject* fallback;			/* speller or NULL */
+} aspell_MappedObject;
+
+#define Mapped(pyobject) ((aspell_MappedObject*)pyobject)
+
+/* helper function: validates header and offsets table; lookups trust
+   the offsets, thus all of them are checked */
+static int parse_mapped_header(aspell_MappedObject* self) {
+	const unsigned char* data = self->file.data;
+	size_t size = self->file.size;
+	size_t table, area, i, offset, previous;
+
+	/* header and at least the offset of the end of words area */
+	if (size < WORDLIST_HEADER_SIZE + 4 || memcmp(data, WORDLIST_MAGIC, 8) != 0)
+		return -1;
+
+	memcpy(self->encoding, data + 8, WORDLIST_ENCODING_SIZE);
+	self->encoding[WORDLIST_ENCODING_SIZE] = '\0';
+
+	self->count = get_uint32(data + 40);
+	if (self->count > (size - WORDLIST_HEADER_SIZE) / 4 - 1)
+		return -1;
+
+	table = 4*(self->count + 1);
+	area = size - WORDLIST_HEADER_SIZE - table;
+	self->offsets = data + WORDLIST_HEADER_SIZE;
+	self->words = (const char*)self->offsets + table;
+
+	/* offsets start at 0, never decrease and the last one is the size
+	   of words area */
+	for (i=0, previous=0; i <= self->count; i++) {
+		offset = get_uint32(self->offsets + 4*i);
+		if ((i == 0 && offset != 0) || offset < previous || offset > area)
+			return -1;
+
+		previous = offset;
+	}
+
+	if (previous != area)
+		return -1;
+
+	return 0;
+}
+
+/* helper function: binary search of an encoded word */
+static int mapped_lookup(aspell_MappedObject* self, const char* word, Py_ssize_t length) {
+	size_t lo = 0;
+	size_t hi = self->count;
+	size_t mid, start, end, n;
+	int result;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo)/2;
+		start = get_uint32(self->offsets + 4*mid);
+		end   = get_uint32(self->offsets + 4*mid + 4);
+		n = end - start;
+
+		result = memcmp(self->words + start, word, n < (size_t)length ? n : (size_t)length);
+		if (result == 0)
+			result = (n > (size_t)length) - (n < (size_t)length);
+
+		if (result == 0)
+			return 1;
+		else if (result < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0;
+}
+
+/* Open a mapped word list ****************************************************/
+static PyObject* new_mapped(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+	static char* kwlist[] = {"path", "fallback", NULL};
+	aspell_MappedObject* self;
+	PyObject* path;
+	PyObject* fallback = Py_None;
+	int error;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|O", kwlist, PyUnicode_FSConverter, &path, &fallback))
+		return NULL;
+
+	if (fallback != Py_None && !PyObject_TypeCheck(fallback, state_of_type(type)->speller_type)) {
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_TypeError, "fallback must be a Speller or None");
+		return NULL;
+	}
+
+	self = (aspell_MappedObject*)type->tp_alloc(type, 0);
+	if (self == NULL) {
+		Py_DECREF(path);
 		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	error = map_file(&self->file, PyBytes_AS_STRING(path));
+	Py_END_ALLOW_THREADS
+
+	if (error == 0 && parse_mapped_header(self) < 0)
+		error = EINVAL;
+
+	if (error == EINVAL) {
+		PyErr_Format(state_of_type(type)->module_error, "'%s' is not a valid word list file", PyBytes_AS_STRING(path));
+		goto error;
+	}
+
+	if (error) {
+		errno = error;
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		goto error;
+	}
+
+	self->encoding_kind = get_encoding_kind(self->encoding);
+	if (self->encoding_kind == ENCODING_OTHER) {
+		self->encoder = PyCodec_Encoder(self->encoding);
+		if (self->encoder == NULL)
+			goto error;
+	}
+
+	if (fallback != Py_None) {
+		Py_INCREF(fallback);
+		self->fallback = fallback;
+	}
+
+	Py_DECREF(path);
+	return (PyObject*)self;
+
+error:
+	Py_DECREF(path);
+	Py_DECREF(self);
+	return NULL;
+}
+
+/* Delete mapped word list ****************************************************/
+static void mapped_dealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+
+	PyObject_GC_UnTrack(self);
+	unmap_file(&Mapped(self)->file);
+	Py_XDECREF(Mapped(self)->encoder);
+	Py_XDECREF(Mapped(self)->fallback);
+	type->tp_free(self);
+	Py_DECREF(type);
+}
+
+static int mapped_traverse(PyObject* self, visitproc visit, void* arg) {
+	Py_VISIT(Py_TYPE(self));
+	Py_VISIT(Mapped(self)->encoder);
+	Py_VISIT(Mapped(self)->fallback);
+	return 0;
 }
 
+/* the encoder is used by lookups, only the fallback is released */
+static int mapped_clear(PyObject* self) {
+	Py_CLEAR(Mapped(self)->fallback);
+	return 0;
+}
 
 /* method:__contains__ ********************************************************/
-static int
-m_contains(PyObject* self, PyObject* args) {
-	char*	word;
+static int mapped_contains(PyObject* self, PyObject* obj) {
+	char* word;
 	Py_ssize_t length;
 	PyObject* buf;
+	int result;
 
-	buf = get_single_arg_string(self, args, &word, &length);
-	if (buf != NULL)
-		switch (aspell_speller_check(Speller(self), word, length)) {
-			case 0:
-				Py_DECREF(buf);
-				return 0;
+	buf = encode_string(
+		Mapped(self)->encoding,
+		Mapped(self)->encoding_kind,
+		Mapped(self)->encoder,
+		obj,
+		&word,
+		&length
+	);
+	if (buf == NULL)
+		return -1;
 
-			case 1:
-				Py_DECREF(buf);
-				return 1;
+	result = mapped_lookup(Mapped(self), word, length);
+	Py_DECREF(buf);
 
-			default:
-				Py_DECREF(buf);
-				PyErr_SetString(_AspellSpellerException, aspell_speller_error_message(Speller(self)));
-				return -1;
-		} // switch
+	if (result == 0 && Mapped(self)->fallback)
+		return m_contains(Mapped(self)->fallback, obj);
 	else
-		return -1;
+		return result;
 }
 
+/* method:__len__ *************************************************************/
+static Py_ssize_t mapped_length(PyObject* self) {
+	return (Py_ssize_t)Mapped(self)->count;
+}
 
 /* method:check ***************************************************************/
-static PyObject* m_check(PyObject* self, PyObject* args) {
+static PyObject* mapped_check(PyObject* self, PyObject* args) {
 	PyObject* word;
 
-	word = PyTuple_GetItem(args, 0);
-	if (word)
-		switch (m_contains(self, word)) {
-			case 0:
-				Py_RETURN_FALSE;
-			
-			case 1:
-				Py_RETURN_TRUE;
-
-			default:
-				return NULL;
-		}
-	else
+	if (!PyArg_ParseTuple(args, "O", &word))
 		return NULL;
+
+	switch (mapped_contains(self, word)) {
+		case 0:
+			Py_RETURN_FALSE;
+		case 1:
+			Py_RETURN_TRUE;
+		default:
+			return NULL;
+	}
 }
 
-/* method:suggest ************************************************************/
-static PyObject* m_suggest(PyObject* self, PyObject* args) {
-	char* word;
-	Py_ssize_t length;
-	PyObject* buf;
-	PyObject* list;
+/* method:encoding ************************************************************/
+static PyObject* mapped_encoding(PyObject* self, void* closure) {
+	return PyUnicode_FromString(Mapped(self)->encoding);
+}
 
-	buf = get_arg_string(self, args, 0, &word, &length);
-	if (buf) {
-		list = AspellWordList2PythonList(
-			self,
-			aspell_speller_suggest(Speller(self),
-			word,
-			length)
-		);
-		Py_DECREF(buf);
-		return list;
-	}
-	else
+static PyMethodDef aspell_mapped_methods[] = {
+	{
+		"check",
+		(PyCFunction)mapped_check,
+		METH_VARARGS,
+		"check(word) => bool\n"
+		"Checks if word is present in the word list; if not and fallback\n"
+		"speller was given, the speller checks the word."
+	},
+	{NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef aspell_mapped_getset[] = {
+	{"encoding", (getter)mapped_encoding, NULL, "encoding of words stored in the file", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot mapped_slots[] = {
+	{Py_tp_dealloc, mapped_dealloc},
+	{Py_tp_traverse, mapped_traverse},
+	{Py_tp_clear, mapped_clear},
+	{Py_tp_doc,
+		"MappedWordlist(path, fallback=None)\n"
+		"Memory maps word list saved by Speller.exportWordlist().\n"
+		"The list has no affix rules, thus inflected forms are found\n"
+		"only by the fallback speller."},
+	{Py_tp_methods, aspell_mapped_methods},
+	{Py_tp_getset, aspell_mapped_getset},
+	{Py_tp_new, new_mapped},
+	{Py_sq_length, mapped_length},
+	{Py_sq_contains, mapped_contains},
+	{0, NULL}
+};
+
+static PyType_Spec mapped_spec = {
+	"aspell.MappedWordlist",
+	sizeof(aspell_MappedObject),
+	0,
+	ASPELL_TPFLAGS,
+	mapped_slots
+};
+
+
+/* setCheckCache **************************************************************/
+static PyObject* set_check_cache(PyObject* module, PyObject* args) {
+	ModuleState* state = state_of_module(module);
+	Py_ssize_t entries;
+	CheckCache* cache = NULL;
+	CheckCache* previous;
+
+	if (!PyArg_ParseTuple(args, "n", &entries))
 		return NULL;
-}
 
-/* method:getMainwordlist *****************************************************/
-static PyObject* m_getMainwordlist(PyObject* self, PyObject* args) {
-	return AspellWordList2PythonList(self, aspell_speller_main_word_list(Speller(self)));
+	if (entries < 0) {
+		PyErr_SetString(PyExc_ValueError, "number of entries must not be negative");
+		return NULL;
+	}
+
+	if (entries > 0) {
+		cache = check_cache_new(entries);
+		if (cache == NULL)
+			return NULL;
+	}
+
+	/* calls in progress keep their references to the old cache */
+	Py_BEGIN_CRITICAL_SECTION(module);
+	previous = state->check_cache;
+	state->check_cache = cache;
+	Py_END_CRITICAL_SECTION();
+
+	check_cache_put(previous);
+
+	Py_RETURN_NONE;
 }
 
-/* method:getPersonalwordlist *************************************************/
-static PyObject* m_getPersonalwordlist(PyObject* self, PyObject* args) {
-	return AspellWordList2PythonList(self, aspell_speller_personal_word_list(Speller(self)));
+/* checkCacheStats ************************************************************/
+static PyObject* check_cache_stats(PyObject* module, PyObject* args) {
+	CheckCache* cache;
+	CheckCacheStripe* stripe;
+	unsigned long long hits = 0, misses = 0, evictions = 0;
+	Py_ssize_t used = 0;
+	Py_ssize_t capacity = 0;
+	int i;
+
+	cache = check_cache_get(module);
+	if (cache) {
+		capacity = cache->nsets * CHECK_CACHE_WAYS * CHECK_CACHE_STRIPES;
+		for (i=0; i < CHECK_CACHE_STRIPES; i++) {
+			stripe = &cache->stripes[i];
+			PyThread_acquire_lock(stripe->lock, WAIT_LOCK);
+			hits		+= stripe->hits;
+			misses		+= stripe->misses;
+			evictions	+= stripe->evictions;
+			used		+= stripe->used;
+			PyThread_release_lock(stripe->lock);
+		}
+	}
+
+	check_cache_put(cache);
+	return Py_BuildValue(
+		"{s:O,s:n,s:n,s:K,s:K,s:K,s:d}",
+		"enabled",		cache ? Py_True : Py_False,
+		"capacity",		capacity,
+		"entries",		used,
+		"hits",			hits,
+		"misses",		misses,
+		"evictions",	evictions,
+		"hit_rate",		hits + misses ? (double)hits / (double)(hits + misses) : 0.0
+	);
 }
 
-/* method:getSessionwordlist **************************************************/
-static PyObject* m_getSessionwordlist(PyObject* self, PyObject* args) {
-	return AspellWordList2PythonList(self, aspell_speller_session_word_list(Speller(self)));
+/* Speller registry ***********************************************************/
+
+/* spellers returned by getSpeller() are kept in module's state, keyed by
+   config_key(); the dictionary is created together with the module */
+
+/* helper function: returns registered speller (new reference),
+   NULL without exception if there's none */
+static PyObject* registry_lookup(PyObject* registry, PyObject* key) {
+	PyObject* speller;
+
+#if PY_VERSION_HEX >= 0x030D0000
+	if (PyDict_GetItemRef(registry, key, &speller) < 0)
+		return NULL;
+#else
+	speller = PyDict_GetItemWithError(registry, key);
+	Py_XINCREF(speller);
+#endif
+	return speller;
 }
 
-/* check for any aspell error after a lib call
-   and either raises exception one or returns none  */
-static PyObject* AspellCheckError(PyObject* self) {
-	if (aspell_speller_error(Speller(self)) != 0) {
-		PyErr_SetString(_AspellSpellerException, aspell_speller_error_message(Speller(self)));
+/* helper function: registers speller unless there's one already;
+   returns the registered speller (new reference) */
+static PyObject* registry_insert(PyObject* registry, PyObject* key, PyObject* speller) {
+	PyObject* existing;
+
+#if PY_VERSION_HEX >= 0x030D0000
+	if (PyDict_SetDefaultRef(registry, key, speller, &existing) < 0)
 		return NULL;
-	}
-	else
-		Py_RETURN_NONE;
+#else
+	existing = PyDict_SetDefault(registry, key, speller);
+	Py_XINCREF(existing);
+#endif
+	return existing;
 }
 
-/* method:addtoPersonal *******************************************************/
-static PyObject* m_addtoPersonal(PyObject* self, PyObject* args) {
-	char *word;
-	Py_ssize_t length;
+/* getSpeller *****************************************************************/
+static PyObject* get_speller(PyObject* module, PyObject* args) {
+	ModuleState* state = state_of_module(module);
+	AspellConfig* config;
+	PyObject* key;
+	PyObject* speller;
+	PyObject* existing;
 
-	if (!PyArg_ParseTuple(args, "s#", &word, &length)) {
-		PyErr_SetString(PyExc_TypeError, "a string is required");
+	config = config_from_args(state, args);
+	if (config == NULL)
+		return NULL;
+
+	key = config_key(config);
+	if (key == NULL) {
+		delete_aspell_config(config);
 		return NULL;
 	}
 
-	aspell_speller_add_to_personal(Speller(self), word, length);
-	return AspellCheckError(self);
-}
+	speller = registry_lookup(state->registry, key);
+	if (speller) {
+		Py_BEGIN_CRITICAL_SECTION(module);
+		state->registry_hits += 1;
+		Py_END_CRITICAL_SECTION();
+		goto done;
+	}
+	else if (PyErr_Occurred())
+		goto error;
 
-/* method:addtoSession ********************************************************/
-static PyObject* m_addtoSession(PyObject* self, PyObject* args) {
-	char *word;
-	Py_ssize_t length;
-	PyObject* buf;
+	Py_BEGIN_CRITICAL_SECTION(module);
+	state->registry_misses += 1;
+	Py_END_CRITICAL_SECTION();
 
-	buf = get_arg_string(self, args, 0, &word, &length);
-	if (buf) {
-		aspell_speller_add_to_session(Speller(self), word, length);
-		Py_DECREF(buf);
-		return AspellCheckError(self);
-	}
-	else
-		return NULL;
+	speller = speller_from_config(state, config);
+	if (speller == NULL)
+		goto error;
 
+	/* the GIL was released, another thread might have added a speller */
+	existing = registry_insert(state->registry, key, speller);
+	Py_DECREF(speller);
+	speller = existing;
+
+done:
+	Py_DECREF(key);
+	delete_aspell_config(config);
+	return speller;
+
+error:
+	Py_DECREF(key);
+	delete_aspell_config(config);
+	return NULL;
 }
 
-/* method:clearsession ********************************************************/
-static PyObject* m_clearsession(PyObject* self, PyObject* args) {
-	aspell_speller_clear_session(Speller(self));
-	return AspellCheckError(self);
+/* spellerRegistryStats *******************************************************/
+static PyObject* speller_registry_stats(PyObject* module, PyObject* args) {
+	ModuleState* state = state_of_module(module);
+	unsigned long long hits, misses;
+
+	Py_BEGIN_CRITICAL_SECTION(module);
+	hits	= state->registry_hits;
+	misses	= state->registry_misses;
+	Py_END_CRITICAL_SECTION();
+
+	return Py_BuildValue(
+		"{s:n,s:K,s:K}",
+		"configs",	PyDict_Size(state->registry),
+		"hits",		hits,
+		"misses",	misses
+	);
 }
 
-/* method:saveallwords ********************************************************/
-static PyObject* m_saveallwords(PyObject* self, PyObject* args) {
-	aspell_speller_save_all_word_lists(Speller(self));
-	return AspellCheckError(self);
+/* clearSpellerRegistry *******************************************************/
+static PyObject* clear_speller_registry(PyObject* module, PyObject* args) {
+	ModuleState* state = state_of_module(module);
+
+	PyDict_Clear(state->registry);
+
+	Py_BEGIN_CRITICAL_SECTION(module);
+	state->registry_hits = 0;
+	state->registry_misses = 0;
+	Py_END_CRITICAL_SECTION();
+
+	Py_RETURN_NONE;
 }
 
-/* method:addReplacement ******************************************************/
-static PyObject* m_addReplacement(PyObject* self, PyObject* args) {
-	char *mis; Py_ssize_t ml;
-	char *cor; Py_ssize_t cl;
-	PyObject* Mbuf;
-	PyObject* Cbuf;
+/* setStatsEnabled ************************************************************/
+static PyObject* set_stats_enabled(PyObject* module, PyObject* args) {
+	int enabled;
 
-	Mbuf = get_arg_string(self, args, 0, &mis, &ml);
-	if (Mbuf == NULL) {
-		PyErr_SetString(PyExc_TypeError, "first argument have to be a string or bytes");
+	if (!PyArg_ParseTuple(args, "p", &enabled))
 		return NULL;
-	}
 
-	Cbuf = get_arg_string(self, args, 1, &cor, &cl);
-	if (Cbuf == NULL) {
-		Py_DECREF(Mbuf);
-		PyErr_SetString(PyExc_TypeError, "second argument have to be a string or bytes");
-		return NULL;
-	}
+	store_flag(&state_of_module(module)->stats_enabled, enabled);
+	Py_RETURN_NONE;
+}
 
-	aspell_speller_store_replacement(Speller(self), mis, ml, cor, cl);
-	Py_DECREF(Mbuf);
-	Py_DECREF(Cbuf);
-	return AspellCheckError(self);
+/* statsEnabled ***************************************************************/
+static PyObject* get_stats_enabled(PyObject* module, PyObject* args) {
+	return PyBool_FromLong(load_flag(&state_of_module(module)->stats_enabled));
 }
 
-/* AspellSpeller methods table */
-static PyMethodDef aspell_object_methods[] = {
+static PyMethodDef aspell_module_methods[] = {
 	{
 		"ConfigKeys",
-		(PyCFunction)m_configkeys,
+		(PyCFunction)configkeys,
 		METH_VARARGS,
 		"ConfigKeys() => dictionary of config keys\n"
         "Keys are string, values are 3-touple:\n"
@@ -670,182 +7272,218 @@ static PyMethodDef aspell_object_methods[] = {
 		"\t3. description (if 'internal' no description available)"
 	},
 	{
-		"setConfigKey",
-		(PyCFunction)m_set_config_key,
-		METH_VARARGS,
-		"changeConfig(key, value)\n"
-		"Sets a new config value for given key"
-	},
-	{
-		"check",
-		(PyCFunction)m_check,
-		METH_VARARGS,
-		"check(word) => bool\n"
- 		"Checks spelling of word.\n"
-		"Returns if word is correct."
-	},
-	{
-		"suggest",
-		(PyCFunction)m_suggest,
-		METH_VARARGS,
-		"suggest(word) => list of words\n"
- 		"Returns a list of suggested spelling for given word.\n"
-		"Even if word is correct (i.e. check(word) returned 1) aspell performs action."
-	},
-	{
-		"getMainwordlist",
-		(PyCFunction)m_getMainwordlist,
-		METH_VARARGS,
-		"getMainwordlist() => list of words\n"
-		"Return a list of words stored in the main dictionary."
-
-	},
-	{
-		"getPersonalwordlist",
-		(PyCFunction)m_getPersonalwordlist,
+		"setCheckCache",
+		(PyCFunction)set_check_cache,
 		METH_VARARGS,
-		"getPersonalwordlist() => list of words\n"
-		"Return a list of words stored in the personal dictionary."
+		"setCheckCache(entries) => None\n"
+		"Enables process-wide cache of check() results shared by all\n"
+		"spellers with the same config; setCheckCache(0) disables it."
 	},
 	{
-		"getSessionwordlist",
-		(PyCFunction)m_getSessionwordlist,
-		METH_VARARGS,
-		"getSessionwordlist() => list of words\n"
-		"Return a list of words stored in the session dictionary."
+		"checkCacheStats",
+		(PyCFunction)check_cache_stats,
+		METH_NOARGS,
+		"checkCacheStats() => dictionary\n"
+		"Returns capacity, number of entries, hits, misses, evictions\n"
+		"and hit rate of the check cache."
 	},
 	{
-		"clearSession",
-		(PyCFunction)m_clearsession,
+		"getSpeller",
+		(PyCFunction)get_speller,
 		METH_VARARGS,
-		"clearSession() => None\n"
-		"Clear current session, i.e. erases all words added thru addtoSession method since last saveallwords() call."
+		"getSpeller(*config) => Speller\n"
+		"Returns speller for given config (passed as to Speller), spellers\n"
+		"are created once per config and shared by all callers."
 	},
 	{
-		"saveAllwords",
-		(PyCFunction)m_saveallwords,
-		METH_VARARGS,
-		"saveAllwords() => None\n"
- 		"Save all words added thru addtoPersonal() and addtoSession() methods."
+		"spellerRegistryStats",
+		(PyCFunction)speller_registry_stats,
+		METH_NOARGS,
+		"spellerRegistryStats() => dictionary\n"
+		"Returns number of configs held by getSpeller(), hits and misses."
 	},
 	{
-		"addtoPersonal",
-		(PyCFunction)m_addtoPersonal,
-		METH_VARARGS,
-		"addtoPersonal(word) => None\n"
-		"Add word to the personal dictionary"
+		"clearSpellerRegistry",
+		(PyCFunction)clear_speller_registry,
+		METH_NOARGS,
+		"clearSpellerRegistry() => None\n"
+		"Forgets all spellers returned by getSpeller() and zeroes counters."
 	},
 	{
-		"addtoSession",
-		(PyCFunction)m_addtoSession,
+		"setStatsEnabled",
+		(PyCFunction)set_stats_enabled,
 		METH_VARARGS,
-		"addtoSession(word) => None\n"
-		"Add word to the session dictionary"
+		"setStatsEnabled(enabled) => None\n"
+		"Turns collecting of speller's stats on or off for all spellers\n"
+		"of the interpreter."
 	},
 	{
-		"addReplacement",
-		(PyCFunction)m_addReplacement,
-		METH_VARARGS,
-		"addReplacement(misspeled word, correct word) => None\n"
-		"Add a replacement pair, i.e. a misspeled and correct words.\n"
-		"For example 'teh' and 'the'."
+		"statsEnabled",
+		(PyCFunction)get_stats_enabled,
+		METH_NOARGS,
+		"statsEnabled() => bool\n"
+		"Returns if speller's stats are collected."
 	},
 	{NULL, NULL, 0, NULL}
 };
 
-static PyTypeObject aspell_AspellType = {
-	PyVarObject_HEAD_INIT(&PyType_Type, 0)
-	"AspellSpeller",												/* tp_name */
-	sizeof(aspell_AspellObject),						/* tp_size */
-	0,																			/* tp_itemsize? */
-	(destructor)speller_dealloc,            /* tp_dealloc */
-	0,                                      /* tp_print */
-	0,                                         /* tp_getattr */
-	0,                                          /* tp_setattr */
-	0,                                          /* tp_reserved */
-	0,														              /* tp_repr */
-	0,                                          /* tp_as_number */
-	0,                                          /* tp_as_sequence */
-	0,                                          /* tp_as_mapping */
-	0,                                          /* tp_hash */
-	0,                                          /* tp_call */
-	0,                                          /* tp_str */
-	PyObject_GenericGetAttr,                    /* tp_getattro */
-	0,                                          /* tp_setattro */
-	0,                                          /* tp_as_buffer */
-	Py_TPFLAGS_DEFAULT,                         /* tp_flags */
-	0,                                          /* tp_doc */
-	0,                                          /* tp_traverse */
-	0,                                          /* tp_clear */
-	0,                                          /* tp_richcompare */
-	0,                                          /* tp_weaklistoffset */
-	0,                                          /* tp_iter */
-	0,                                          /* tp_iternext */
-	aspell_object_methods,                      /* tp_methods */
-	0,							                            /* tp_members */
-	0,                                          /* tp_getset */
-	0,                                          /* tp_base */
-	0,                                          /* tp_dict */
-	0,                                          /* tp_descr_get */
-	0,                                          /* tp_descr_set */
-	0,                                          /* tp_dictoffset */
-	0,                                          /* tp_init */
-	0,                                          /* tp_alloc */
-	new_speller,																/* tp_new */
-};
+/* helper function: creates a type bound to the module */
+static PyTypeObject* add_type(PyObject* module, PyType_Spec* spec, int public) {
+	PyTypeObject* type;
 
+	type = (PyTypeObject*)PyType_FromModuleAndSpec(module, spec, NULL);
+	if (type == NULL)
+		return NULL;
 
-static PySequenceMethods speller_as_sequence;
+#ifndef Py_TPFLAGS_DISALLOW_INSTANTIATION
+	if (spec->flags & ASPELL_TPFLAGS_NOINIT)
+		type->tp_new = NULL;
+#endif
 
-static PyMethodDef aspell_module_methods[] = {
-	{
-		"ConfigKeys",
-		(PyCFunction)configkeys,
-		METH_VARARGS,
-		"ConfigKeys() => dictionary of config keys\n"
-        "Keys are string, values are 3-touple:\n"
-		"\t1. key type={string|integer|boolean|list}\n"
-		"\t2. current value\n"
-		"\t3. description (if 'internal' no description available)"
-	},
-	{NULL, NULL, 0, NULL}
-};
+	if (public && PyModule_AddType(module, type) < 0) {
+		Py_DECREF(type);
+		return NULL;
+	}
 
-static PyModuleDef aspellmodule = {
-	PyModuleDef_HEAD_INIT,
-	"aspell",
-	"aspell wrapper",
-	-1,
-	aspell_module_methods,
-};
+	return type;
+}
 
-PyMODINIT_FUNC
-PyInit_aspell(void) {
-	PyObject *module;
+/* helper function: creates an exception class */
+static PyObject* add_exception(PyObject* module, const char* name) {
+	PyObject* exception;
+	char qualname[64];
 
-	module = PyModule_Create(&aspellmodule);
-	if (module == NULL)
+	PyOS_snprintf(qualname, sizeof(qualname), "aspell.%s", name);
+	exception = PyErr_NewException(qualname, NULL, NULL);
+	if (exception == NULL)
 		return NULL;
 
-	speller_as_sequence.sq_contains = m_contains;
-	aspell_AspellType.tp_as_sequence = &speller_as_sequence;
-
-	if (PyType_Ready(&aspell_AspellType) < 0) {
-		Py_DECREF(module);
+	Py_INCREF(exception);
+	if (PyModule_AddObject(module, name, exception) < 0) {
+		Py_DECREF(exception);
+		Py_DECREF(exception);
 		return NULL;
 	}
-	else
-		PyModule_AddObject(module, "Speller", (PyObject*)&aspell_AspellType);
 
-	_AspellSpellerException = PyErr_NewException("aspell.AspellSpellerError", NULL, NULL);
-	_AspellModuleException  = PyErr_NewException("aspell.AspellModuleError", NULL, NULL);
-	_AspellConfigException  = PyErr_NewException("aspell.AspellConfigError", NULL, NULL);
+	return exception;
+}
+
+static int aspell_exec(PyObject* module) {
+	ModuleState* state = state_of_module(module);
+
+	state->speller_type = add_type(module, &speller_spec, 1);
+	if (state->speller_type == NULL)
+		return -1;
+
+	state->wordlist_iter_type	= add_type(module, &wordlist_iter_spec, 0);
+	state->file_checker_type	= add_type(module, &file_checker_spec, 0);
+	state->pool_type			= add_type(module, &pool_spec, 1);
+	state->local_type			= add_type(module, &local_spec, 1);
+	state->multi_type			= add_type(module, &multi_spec, 1);
+	state->mapped_type			= add_type(module, &mapped_spec, 1);
+	if (state->wordlist_iter_type == NULL
+	 || state->file_checker_type == NULL
+	 || state->pool_type == NULL
+	 || state->local_type == NULL
+	 || state->multi_type == NULL
+	 || state->mapped_type == NULL)
+		return -1;
+
+	state->speller_error	= add_exception(module, "AspellSpellerError");
+	state->module_error		= add_exception(module, "AspellModuleError");
+	state->config_error		= add_exception(module, "AspellConfigError");
+	if (state->speller_error == NULL
+	 || state->module_error == NULL
+	 || state->config_error == NULL)
+		return -1;
+
+	state->registry = PyDict_New();
+	if (state->registry == NULL)
+		return -1;
+
+	state->check_cache = NULL;
+	state->fingerprint_counter = 0;
+	state->registry_hits = 0;
+	state->registry_misses = 0;
+	state->stats_enabled = 0;
+	return 0;
+}
+
+static int aspell_traverse(PyObject* module, visitproc visit, void* arg) {
+	ModuleState* state = state_of_module(module);
+
+	Py_VISIT(state->speller_error);
+	Py_VISIT(state->config_error);
+	Py_VISIT(state->module_error);
+	Py_VISIT(state->speller_type);
+	Py_VISIT(state->wordlist_iter_type);
+	Py_VISIT(state->file_checker_type);
+	Py_VISIT(state->pool_type);
+	Py_VISIT(state->local_type);
+	Py_VISIT(state->multi_type);
+	Py_VISIT(state->mapped_type);
+	Py_VISIT(state->registry);
+	return 0;
+}
+
+static int aspell_clear(PyObject* module) {
+	ModuleState* state = state_of_module(module);
+
+	Py_CLEAR(state->speller_error);
+	Py_CLEAR(state->config_error);
+	Py_CLEAR(state->module_error);
+	Py_CLEAR(state->speller_type);
+	Py_CLEAR(state->wordlist_iter_type);
+	Py_CLEAR(state->file_checker_type);
+	Py_CLEAR(state->pool_type);
+	Py_CLEAR(state->local_type);
+	Py_CLEAR(state->multi_type);
+	Py_CLEAR(state->mapped_type);
+	Py_CLEAR(state->registry);
+	return 0;
+}
+
+static void aspell_free(void* module) {
+	ModuleState* state = state_of_module((PyObject*)module);
+
+	aspell_clear((PyObject*)module);
+
+	/* no speller refers to the module anymore, thus nobody else
+	   holds a reference to the cache */
+	if (state->check_cache) {
+		check_cache_free(state->check_cache);
+		state->check_cache = NULL;
+	}
+}
+
+static PyModuleDef_Slot aspell_slots[] = {
+	{Py_mod_exec, aspell_exec},
+#ifdef Py_mod_multiple_interpreters
+	{Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+	{Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+	{0, NULL}
+};
 
-	PyModule_AddObject(module, "AspellSpellerError", _AspellSpellerException);
-	PyModule_AddObject(module, "AspellModuleError", _AspellModuleException);
-	PyModule_AddObject(module, "AspellConfigError", _AspellConfigException);
+/* the extension is imported by package aspell (aspell/__init__.py);
+   each interpreter gets own instance of the module with own state */
+static PyModuleDef aspellmodule = {
+	PyModuleDef_HEAD_INIT,
+	"aspell._aspell",
+	"aspell wrapper",
+	sizeof(ModuleState),
+	aspell_module_methods,
+	aspell_slots,
+	aspell_traverse,
+	aspell_clear,
+	aspell_free,
+};
 
-	return module;
+PyMODINIT_FUNC
+PyInit__aspell(void) {
+	return PyModuleDef_Init(&aspellmodule);
 }
 
 /*
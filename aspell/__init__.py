@@ -0,0 +1,14 @@
+"""
+aspell-python - interface to GNU Aspell.
+
+The speller is implemented by the C extension aspell._aspell; this
+package adds helpers written in Python.
+"""
+
+from ._aspell import *
+
+try:
+	from ._async import AsyncSpeller
+except (ImportError, SyntaxError):
+	# asyncio is not available (Python 2)
+	pass
@@ -0,0 +1,235 @@
+# Command line spell checker of text corpora:
+#
+#	python3 -m aspell [options] file-or-glob ...
+#
+# Files are distributed among worker processes, each with own speller
+# created once at start. Workers scan files with Speller.checkFile(),
+# thus files are memory mapped and tokenized by aspell's document
+# checker. Misspellings are counted and printed as JSONL or TSV, most
+# frequent first; suggestions can be added for the top-K of them.
+# Per-worker throughput is reported on stderr.
+
+import argparse
+import collections
+import glob
+import json
+import multiprocessing
+import os
+import sys
+import time
+
+from ._aspell import Speller, AspellConfigError, AspellSpellerError
+
+
+# worker process state, set by init_worker
+_speller	= None
+_mode		= None
+
+
+def init_worker(config, mode):
+	global _speller, _mode
+
+	_speller = Speller(*config, raw=True)
+	_mode = mode
+
+
+def check_file(path):
+	"""checks a single file in a worker; returns counts of misspelled
+	   words (as bytes) and throughput data"""
+
+	counts = collections.Counter()
+	start = time.perf_counter()
+	try:
+		checker = _speller.checkFile(path, mode=_mode)
+		for offset, line, word in checker:
+			counts[word] += 1
+
+		words	= checker.words
+		size	= checker.position
+		error	= None
+	except (OSError, AspellSpellerError, AspellConfigError) as e:
+		words	= 0
+		size	= 0
+		error	= '%s: %s' % (path, e)
+
+	return {
+		'pid'		: os.getpid(),
+		'counts'	: counts,
+		'words'		: words,
+		'bytes'		: size,
+		'seconds'	: time.perf_counter() - start,
+		'error'		: error,
+	}
+
+
+def expand(patterns):
+	"returns sorted list of files matching patterns, without duplicates"
+
+	result = []
+	seen = set()
+	for pattern in patterns:
+		paths = glob.glob(pattern, recursive=True)
+		if not paths and os.path.exists(pattern):
+			paths = [pattern]
+
+		if not paths:
+			raise ValueError("no files match '%s'" % pattern)
+
+		for path in sorted(paths):
+			if os.path.isfile(path) and path not in seen:
+				seen.add(path)
+				result.append(path)
+
+	return result
+
+
+def parse_config(options):
+	config = []
+	if options.lang:
+		config.append(('lang', options.lang))
+	if options.encoding:
+		config.append(('encoding', options.encoding))
+
+	for item in options.config:
+		key, sep, value = item.partition('=')
+		if not sep:
+			raise ValueError("config must be given as key=value, not '%s'" % item)
+
+		config.append((key, value))
+
+	return config
+
+
+def run(files, config, options):
+	"""checks files; returns counter of misspellings and per-worker
+	   statistics"""
+
+	counts = collections.Counter()
+	workers = collections.OrderedDict()
+	errors = []
+
+	def collect(result):
+		counts.update(result['counts'])
+		worker = workers.setdefault(result['pid'], {'files': 0, 'words': 0, 'bytes': 0, 'seconds': 0.0})
+		worker['files']		+= 1
+		worker['words']		+= result['words']
+		worker['bytes']		+= result['bytes']
+		worker['seconds']	+= result['seconds']
+		if result['error']:
+			errors.append(result['error'])
+
+	jobs = min(options.jobs, len(files))
+	if jobs <= 1:
+		init_worker(config, options.mode)
+		for path in files:
+			collect(check_file(path))
+	else:
+		# largest files first, so that workers finish at similar time
+		files = sorted(files, key=os.path.getsize, reverse=True)
+		pool = multiprocessing.Pool(jobs, initializer=init_worker, initargs=(config, options.mode))
+		try:
+			for result in pool.imap_unordered(check_file, files):
+				collect(result)
+		finally:
+			pool.close()
+			pool.join()
+
+	return counts, workers, errors
+
+
+def write_results(out, records, options):
+	if options.format == 'jsonl':
+		for record in records:
+			out.write(json.dumps(record, ensure_ascii=False, sort_keys=True))
+			out.write('\n')
+	else:
+		for record in records:
+			fields = [record['word'], str(record['count'])]
+			if 'suggestions' in record:
+				fields.append(','.join(record['suggestions']))
+			out.write('\t'.join(fields))
+			out.write('\n')
+
+
+def report(workers, elapsed, err):
+	total_words = 0
+	for pid, worker in workers.items():
+		total_words += worker['words']
+		rate = worker['words'] / worker['seconds'] if worker['seconds'] > 0 else 0.0
+		err.write('worker %d: %d files, %d words, %d bytes, %.2f s, %.0f words/s\n' % (
+			pid, worker['files'], worker['words'], worker['bytes'], worker['seconds'], rate
+		))
+
+	rate = total_words / elapsed if elapsed > 0 else 0.0
+	err.write('total: %d words in %.2f s, %.0f words/s\n' % (total_words, elapsed, rate))
+
+
+def main(argv=None, out=None, err=None):
+	parser = argparse.ArgumentParser(
+		prog='python -m aspell',
+		description='Counts misspelled words in text files using worker processes.'
+	)
+	parser.add_argument('files', nargs='+', metavar='file', help='file or glob pattern (** is recursive)')
+	parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count() or 1, help='number of worker processes (default: number of processors)')
+	parser.add_argument('-l', '--lang', help='dictionary')
+	parser.add_argument('-e', '--encoding', help='encoding of files and dictionary')
+	parser.add_argument('-c', '--config', action='append', default=[], metavar='KEY=VALUE', help='aspell config key, might be repeated')
+	parser.add_argument('-m', '--mode', default='none', help="aspell's filter mode, e.g. none, html, tex, email (default: none)")
+	parser.add_argument('-f', '--format', choices=['jsonl', 'tsv'], default='jsonl', help='output format (default: jsonl)')
+	parser.add_argument('-s', '--suggest', type=int, default=0, metavar='K', help='add suggestions for K most frequent misspellings')
+	parser.add_argument('--suggestions', type=int, default=5, metavar='N', help='number of suggestions per word (default: 5)')
+	parser.add_argument('-o', '--output', help='output file (default: stdout)')
+	parser.add_argument('-q', '--quiet', action='store_true', help="don't report throughput")
+	options = parser.parse_args(argv)
+
+	out = out or sys.stdout
+	err = err or sys.stderr
+
+	if options.jobs < 1:
+		parser.error('number of jobs must be positive')
+
+	try:
+		config = parse_config(options)
+		files = expand(options.files)
+		speller = Speller(*config, raw=True)	# reports errors in config early
+	except (ValueError, AspellConfigError, AspellSpellerError) as e:
+		parser.error(str(e))
+
+	encoding = speller.ConfigKeys()['encoding'][1]
+
+	start = time.perf_counter()
+	counts, workers, errors = run(files, config, options)
+	elapsed = time.perf_counter() - start
+
+	# most frequent first, then alphabetically
+	ranking = sorted(counts.items(), key=lambda item: (-item[1], item[0]))
+
+	records = []
+	for word, count in ranking:
+		records.append({'word': word.decode(encoding, 'replace'), 'count': count})
+
+	if options.suggest > 0:
+		top = [word for word, count in ranking[:options.suggest]]
+		# a single thread: each thread would load another dictionary
+		for record, suggestions in zip(records, speller.suggestMany(top, threads=1)):
+			record['suggestions'] = [word.decode(encoding, 'replace') for word in suggestions[:options.suggestions]]
+
+	if options.output:
+		with open(options.output, 'w', encoding='utf-8') as f:
+			write_results(f, records, options)
+	else:
+		write_results(out, records, options)
+
+	for error in errors:
+		err.write('error: %s\n' % error)
+
+	if not options.quiet:
+		report(workers, elapsed, err)
+
+	return 1 if errors else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -0,0 +1,207 @@
+# asyncio front-end of Speller. Calls of check() and suggest() made
+# within a short time are collected and sent to a worker thread as a
+# single checkMany() or suggestMany() call, which runs without the GIL;
+# results complete futures back on the event loop.
+
+import asyncio
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
+from ._aspell import Speller
+
+
+class _Failure(object):
+	"exception raised for a single word of a batch"
+
+	def __init__(self, exception):
+		self.exception = exception
+
+
+class _Queue(object):
+	"words waiting for a batch"
+
+	def __init__(self, run):
+		self.run = run			# called in a worker thread with list of words
+		self.words = []
+		self.futures = []
+		self.timer = None		# scheduled flush
+
+
+class AsyncSpeller(object):
+	"""
+	AsyncSpeller(*config, max_batch=256, delay=0.0005, threads=1)
+
+	Speller for asyncio programs; config is passed as to Speller.
+
+	Words passed to check() and suggest() are collected for at most
+	``delay`` seconds or until ``max_batch`` words are waiting, then
+	the batch is processed by one of ``threads`` worker threads. Each
+	worker thread uses own clone of the speller.
+	"""
+
+	def __init__(self, *config, max_batch=256, delay=0.0005, threads=1):
+		self.max_batch	= max_batch
+		self.delay		= delay
+
+		if self.max_batch < 1:
+			raise ValueError("max_batch must be positive")
+		if self.delay < 0:
+			raise ValueError("delay must not be negative")
+		if threads < 1:
+			raise ValueError("number of threads must be positive")
+
+		# created here, thus errors in config are reported at once
+		self._speller	= Speller(*config)
+		self._local		= threading.local()
+		self._executor	= ThreadPoolExecutor(max_workers=threads)
+		self._check		= _Queue(self._run_check)
+		self._suggest	= _Queue(self._run_suggest)
+		self._jobs		= set()
+		self._closed	= False
+
+		self._requests	= 0
+		self._batches	= 0
+		self._largest	= 0
+
+	def check(self, word):
+		"""check(word) => awaitable bool
+		Checks spelling of word."""
+		return self._submit(self._check, word)
+
+	def suggest(self, word):
+		"""suggest(word) => awaitable list of words
+		Returns a list of suggested spellings for given word."""
+		return self._submit(self._suggest, word)
+
+	def flush(self):
+		"""flush() => None
+		Sends waiting words to worker threads without further delay."""
+		self._flush(self._check)
+		self._flush(self._suggest)
+
+	async def close(self):
+		"""close() => None
+		Processes waiting words and stops worker threads."""
+		if self._closed:
+			return
+
+		self._closed = True
+		self.flush()
+		if self._jobs:
+			await asyncio.wait(list(self._jobs))
+
+		# all jobs are done, nothing blocks the event loop
+		self._executor.shutdown(wait=False)
+
+	def stats(self):
+		"""stats() => dictionary
+		Returns number of requests, number of batches and size of
+		the largest batch."""
+		return {
+			'requests'	: self._requests,
+			'batches'	: self._batches,
+			'largest'	: self._largest,
+		}
+
+	async def __aenter__(self):
+		return self
+
+	async def __aexit__(self, *exc_info):
+		await self.close()
+
+	# event loop side
+
+	def _submit(self, queue, word):
+		if self._closed:
+			raise RuntimeError("speller is closed")
+
+		if not isinstance(word, (str, bytes)):
+			raise TypeError("string or bytes required")
+
+		loop = asyncio.get_running_loop()
+		future = loop.create_future()
+		queue.words.append(word)
+		queue.futures.append(future)
+		self._requests += 1
+
+		if len(queue.words) >= self.max_batch:
+			self._flush(queue)
+		elif queue.timer is None:
+			queue.timer = loop.call_later(self.delay, self._flush, queue)
+
+		return future
+
+	def _flush(self, queue):
+		if queue.timer is not None:
+			queue.timer.cancel()
+			queue.timer = None
+
+		if not queue.words:
+			return
+
+		words	= queue.words
+		futures	= queue.futures
+		queue.words		= []
+		queue.futures	= []
+
+		self._batches += 1
+		self._largest = max(self._largest, len(words))
+
+		loop = asyncio.get_running_loop()
+		job = loop.run_in_executor(self._executor, queue.run, words)
+		self._jobs.add(job)
+		job.add_done_callback(lambda job: self._complete(job, futures))
+
+	def _complete(self, job, futures):
+		self._jobs.discard(job)
+
+		try:
+			results = job.result()
+		except BaseException as e:
+			for future in futures:
+				if not future.done():
+					future.set_exception(e)
+			return
+
+		for future, result in zip(futures, results):
+			if future.done():		# cancelled by caller
+				continue
+
+			if isinstance(result, _Failure):
+				future.set_exception(result.exception)
+			else:
+				future.set_result(result)
+
+	# worker threads
+
+	def _worker_speller(self):
+		speller = getattr(self._local, 'speller', None)
+		if speller is None:
+			speller = self._speller.clone()
+			self._local.speller = speller
+
+		return speller
+
+	def _run_check(self, words):
+		speller = self._worker_speller()
+		try:
+			return [bool(correct) for correct in speller.checkMany(words)]
+		except Exception:
+			# a single bad word mustn't fail the others
+			return [self._call(speller.check, word) for word in words]
+
+	def _run_suggest(self, words):
+		speller = self._worker_speller()
+		try:
+			return speller.suggestMany(words, threads=1)
+		except Exception:
+			return [self._call(speller.suggest, word) for word in words]
+
+	@staticmethod
+	def _call(function, word):
+		try:
+			return function(word)
+		except Exception as e:
+			return _Failure(e)
+
+# vim: ts=4 sw=4 nowrap noexpandtab
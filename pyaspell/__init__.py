@@ -1 +1 @@
-from pyaspell import *
+from .pyaspell import *
@@ -28,6 +28,9 @@ try:
 except ImportError:
 	raise ImportError("ctypes library is needed")
 
+import codecs
+import threading
+
 
 class AspellError(Exception): pass
 class AspellConfigError(AspellError): pass
@@ -36,20 +39,94 @@ class AspellSpellerError(AspellError): pass
 try:
 	bytes
 
-	def _to_bytes(s):
-		return s.encode()
+	def _to_bytes(s, encoding='utf-8'):
+		return s.encode(encoding)
 
-	def _from_bytes(s):
-		return str(s)
+	def _from_bytes(s, encoding='utf-8'):
+		return s.decode(encoding)
 
 except NameError:
-	def _to_bytes(s):
+	def _to_bytes(s, encoding=None):
 		return s
 
-	def _from_bytes(s):
+	def _from_bytes(s, encoding=None):
 		return s
 
 
+class _KeyInfo(ctypes.Structure):
+	_fields_ = [
+		("name",	ctypes.c_char_p),
+		("type",	ctypes.c_int),
+		("default",	ctypes.c_char_p),
+		("desc",	ctypes.c_char_p),
+		("flags",	ctypes.c_int),
+		("other_data", ctypes.c_int),
+	]
+
+
+# Signatures of used functions: (name, restype, argtypes). All aspell
+# objects are opaque pointers; words are passed as c_void_p, which
+# accepts both bytes and addresses inside a ctypes buffer.
+_pointer	= ctypes.c_void_p
+_string		= ctypes.c_char_p
+_int		= ctypes.c_int
+
+_prototypes = [
+	("new_aspell_config",						_pointer,	[]),
+	("delete_aspell_config",					None,		[_pointer]),
+	("aspell_config_replace",					_int,		[_pointer, _string, _string]),
+	("aspell_config_retrieve",					_string,	[_pointer, _string]),
+	("aspell_config_error_message",				_string,	[_pointer]),
+	("aspell_config_possible_elements",			_pointer,	[_pointer, _int]),
+	("aspell_key_info_enumeration_next",		ctypes.POINTER(_KeyInfo), [_pointer]),
+	("delete_aspell_key_info_enumeration",		None,		[_pointer]),
+	("new_aspell_speller",						_pointer,	[_pointer]),
+	("aspell_error_number",						ctypes.c_uint, [_pointer]),
+	("delete_aspell_can_have_error",			None,		[_pointer]),
+	("to_aspell_speller",						_pointer,	[_pointer]),
+	("delete_aspell_speller",					None,		[_pointer]),
+	("aspell_speller_config",					_pointer,	[_pointer]),
+	("aspell_speller_error",					_pointer,	[_pointer]),
+	("aspell_speller_error_message",			_string,	[_pointer]),
+	("aspell_speller_check",					_int,		[_pointer, _pointer, _int]),
+	("aspell_speller_suggest",					_pointer,	[_pointer, _pointer, _int]),
+	("aspell_speller_add_to_personal",			_int,		[_pointer, _pointer, _int]),
+	("aspell_speller_add_to_session",			_int,		[_pointer, _pointer, _int]),
+	("aspell_speller_personal_word_list",		_pointer,	[_pointer]),
+	("aspell_speller_session_word_list",		_pointer,	[_pointer]),
+	("aspell_speller_clear_session",			_int,		[_pointer]),
+	("aspell_speller_store_replacement",		_int,		[_pointer, _pointer, _int, _pointer, _int]),
+	("aspell_speller_save_all_word_lists",		_int,		[_pointer]),
+	("aspell_word_list_elements",				_pointer,	[_pointer]),
+	("aspell_string_enumeration_next",			_string,	[_pointer]),
+	("delete_aspell_string_enumeration",		None,		[_pointer]),
+]
+
+
+# libraries are loaded and their functions bound once per process
+_libraries = {}
+_libraries_lock = threading.Lock()
+
+def _load_library(libname):
+	if libname is None:
+		libname = ctypes.util.find_library('aspell')
+		if libname is None:
+			raise AspellError("Can't find aspell library")
+
+	with _libraries_lock:
+		lib = _libraries.get(libname)
+		if lib is None:
+			lib = ctypes.CDLL(libname)
+			for name, restype, argtypes in _prototypes:
+				function = getattr(lib, name)
+				function.restype = restype
+				function.argtypes = argtypes
+
+			_libraries[libname] = lib
+
+	return lib
+
+
 class AspellLinux(object):
 	"""
 	Aspell speller object.  Allows to check spelling, get suggested
@@ -68,15 +145,13 @@ class AspellLinux(object):
 		* libname - explicitly set aspell library name;
 		  if None then default name is used
 		"""
-		if libname is None:
-			libname = ctypes.util.find_library('aspell')
-		self.__lib = ctypes.CDLL(libname)
+		self.__lib = _load_library(libname)
 
 		# Initialize speller
 
 		# 1. create configuration
 		config = self.__lib.new_aspell_config()
-		if config == None:
+		if not config:
 			raise AspellError("Can't create aspell config object")
 
 		# 2. parse configkeys arg.
@@ -103,40 +178,84 @@ class AspellLinux(object):
 
 		self.__speller = self.__lib.to_aspell_speller(possible_error)
 
+		# 4. words are passed in speller's encoding
+		self.__encoding = 'utf-8'
+		encoding = self.__lib.aspell_config_retrieve(
+			self.__lib.aspell_speller_config(self.__speller),
+			b"encoding"
+		)
+		if encoding:
+			try:
+				self.__encoding = codecs.lookup(_from_bytes(encoding, 'ascii')).name
+			except LookupError:
+				pass
+
 
-	def check(self, word):
+	def _encode(self, word):
 		"""
-		Check if word is present in main, personal or session
-		dictionary.  Boolean value is returned
+		XXX: internal function
+
+		Returns word in speller's encoding.
 		"""
 		if type(word) is str:
-			return bool(
-				self.__lib.aspell_speller_check(
-					self.__speller,
-					_to_bytes(word),
-					len(word)
-				))
+			return _to_bytes(word, self.__encoding)
 		else:
 			raise TypeError("String expected")
 
 
+	def check(self, word):
+		"""
+		Check if word is present in main, personal or session
+		dictionary.  Boolean value is returned
+		"""
+		word = self._encode(word)
+		result = self.__lib.aspell_speller_check(self.__speller, word, len(word))
+		if result < 0:
+			self._aspell_check_error()
+
+		return bool(result)
+
+
 	__contains__ = check
 
 
+	def check_many(self, words):
+		"""
+		Check spelling of all words from iterable.  Returns bytearray,
+		where 1 means that word at the same position is correct.
+
+		Words are encoded and copied into a single buffer once,
+		then aspell is called with addresses inside the buffer.
+		"""
+		encoded = [self._encode(word) for word in words]
+		data = b"".join(encoded)
+		buffer = ctypes.create_string_buffer(data, len(data) + 1)
+
+		check = self.__lib.aspell_speller_check
+		speller = self.__speller
+		address = ctypes.addressof(buffer)
+		result = bytearray(len(encoded))
+		for i, word in enumerate(encoded):
+			length = len(word)
+			correct = check(speller, address, length)
+			if correct < 0:
+				self._aspell_check_error()
+
+			result[i] = correct
+			address += length
+
+		return result
+
+
 	def suggest(self, word):
 		"""
 		Return list of spelling suggestions of given word.
 		Works even if word is correct.
 		"""
-		if type(word) is str:
-			return self._aspellwordlist(
-				self.__lib.aspell_speller_suggest(
-					self.__speller,
-					_to_bytes(word),
-					len(word)
-				))
-		else:
-			raise TypeError("String expected")
+		word = self._encode(word)
+		return self._aspellwordlist(
+			self.__lib.aspell_speller_suggest(self.__speller, word, len(word))
+		)
 
 
 	def personal_dict(self, word=None):
@@ -151,11 +270,8 @@ class AspellLinux(object):
 		if word is not None:
 			# add new word
 			assert type(word) is str, "String expected"
-			self.__lib.aspell_speller_add_to_personal(
-				self.__speller,
-				_to_bytes(word),
-				len(word)
-			)
+			word = self._encode(word)
+			self.__lib.aspell_speller_add_to_personal(self.__speller, word, len(word))
 			self._aspell_check_error()
 		else:
 			# return list of words from personal dictionary
@@ -182,11 +298,8 @@ class AspellLinux(object):
 		if word is not None:
 			# add new word
 			assert type(word) is str, "String expected"
-			self.__lib.aspell_speller_add_to_session(
-				self.__speller,
-				_to_bytes(word),
-				len(word)
-			)
+			word = self._encode(word)
+			self.__lib.aspell_speller_add_to_session(self.__speller, word, len(word))
 			self._aspell_check_error()
 		else:
 			# return list of words from personal dictionary
@@ -204,11 +317,13 @@ class AspellLinux(object):
 		assert type(misspelled) is str, "String is required"
 		assert type(correct) is str, "String is required"
 
+		misspelled = self._encode(misspelled)
+		correct = self._encode(correct)
 		self.__lib.aspell_speller_store_replacement(
 			self.__speller,
-			_to_bytes(misspelled),
+			misspelled,
 			len(misspelled),
-			_to_bytes(correct),
+			correct,
 			len(correct)
 		)
 		self._aspell_check_error()
@@ -241,25 +356,20 @@ class AspellLinux(object):
 		"""
 		
 		config = self.__lib.aspell_speller_config(self.__speller)
-		if config is None:
+		if not config:
 			raise AspellConfigError("Can't get speller's config")
 
 		keys_enum = self.__lib.aspell_config_possible_elements(config, 1)
-		if keys_enum is None:
+		if not keys_enum:
 			raise AspellError("Can't get list of config keys")
 
-		class KeyInfo(ctypes.Structure):
-			_fields_ = [
-				("name",	ctypes.c_char_p),
-				("type",	ctypes.c_int),
-				("default",	ctypes.c_char_p),
-				("desc",	ctypes.c_char_p),
-				("flags",	ctypes.c_int),
-				("other_data", ctypes.c_int),
-			]
-
 		key_next = self.__lib.aspell_key_info_enumeration_next
-		key_next.restype = ctypes.POINTER(KeyInfo)
+
+		def string(value):
+			if value is None:
+				return None
+			else:
+				return _from_bytes(value)
 
 		list = []
 		while True:
@@ -272,38 +382,38 @@ class AspellLinux(object):
 			if key_info.type == 0:
 				# string
 				list.append((
-					_from_bytes(key_info.name),
-					_from_bytes(key_info.default),
-					_from_bytes(key_info.desc),
+					string(key_info.name),
+					string(key_info.default),
+					string(key_info.desc),
 				))
 
 			elif key_info.type == 1:
 				# integer
 				list.append((
-					_from_bytes(key_info.name),
+					string(key_info.name),
 					int(key_info.default),
-					_from_bytes(key_info.desc),
+					string(key_info.desc),
 				))
 			elif key_info.type == 2:
 				# boolean
-				if _from_bytes(key_info.default.lower()) == 'true':
+				if string(key_info.default).lower() == 'true':
 					list.append((
-						_from_bytes(key_info.name),
+						string(key_info.name),
 						True,
-						_from_bytes(key_info.desc),
+						string(key_info.desc),
 					))
 				else:
 					list.append((
-						_from_bytes(key_info.name),
+						string(key_info.name),
 						False,
-						_from_bytes(key_info.desc),
+						string(key_info.desc),
 					))
 			elif key_info.type == 3:
 				# list
 				list.append((
-					_from_bytes(key_info.name),
-					_from_bytes(key_info.default.split()),
-					_from_bytes(key_info.desc),
+					string(key_info.name),
+					string(key_info.default).split(),
+					string(key_info.desc),
 					))
 
 		self.__lib.delete_aspell_key_info_enumeration(keys_enum)
@@ -324,15 +434,19 @@ class AspellLinux(object):
 
 		Converts aspell list into python list.
 		"""
+		if not wordlist_id:
+			self._aspell_check_error()
+			return []
+
 		elements = self.__lib.aspell_word_list_elements(wordlist_id)
+		next_word = self.__lib.aspell_string_enumeration_next
 		list = []
 		while True:
-			wordptr = self.__lib.aspell_string_enumeration_next(elements)
-			if not wordptr:
+			word = next_word(elements)
+			if word is None:
 				break
 			else:
-				word = ctypes.c_char_p(wordptr)
-				list.append(_from_bytes(word.value))
+				list.append(_from_bytes(word, self.__encoding))
 
 		self.__lib.delete_aspell_string_enumeration(elements)
 		return list
@@ -347,9 +461,7 @@ class AspellLinux(object):
 		"""
 		# make exception object & copy error msg 
 		exc = AspellConfigError(
-			_from_bytes(ctypes.c_char_p(
-				self.__lib.aspell_config_error_message(config)
-			).value)
+			_from_bytes(self.__lib.aspell_config_error_message(config))
 		)
 	
 		# then destroy config objcet
@@ -366,7 +478,7 @@ class AspellLinux(object):
 		Raise exception if previous speller operation
 		caused an error.
 		"""
-		if self.__lib.aspell_speller_error(self.__speller) != 0:
+		if self.__lib.aspell_speller_error(self.__speller):
 			msg = self.__lib.aspell_speller_error_message(self.__speller)
 			raise AspellSpellerError(_from_bytes(msg))
 #class
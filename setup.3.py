@@ -8,7 +8,8 @@ def get_include_dirs():
     else:
         return []
 
-module = Extension('aspell',
+# the extension is imported by package aspell
+module = Extension('aspell._aspell',
     libraries = ['aspell'],
     library_dirs = ['/usr/local/lib/'],
     include_dirs = get_include_dirs(),
@@ -18,6 +19,7 @@ module = Extension('aspell',
 setup (name = 'aspell-python-py3',
     version = '1.15',
     ext_modules = [module],
+    packages = ['aspell'],
 
     description      = "Wrapper around GNU Aspell for Python 3",
     author           = "Wojciech Muła",
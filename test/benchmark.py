@@ -0,0 +1,278 @@
+# Benchmark of check and suggest: throughput and latency percentiles
+# for different encodings, suggestion modes, word lengths, batch sizes
+# and numbers of threads. The C extension is compared with the ctypes
+# module (pyaspell.AspellLinux). Words come from benchmark_corpus.py,
+# thus no external data is needed.
+#
+# Results are printed and saved as JSON, so runs of two versions can
+# be compared by a script.
+#
+# usage: python3 test/benchmark.py [--quick] [--output file.json]
+#                                  [--lang en] [--ctypes-lib path]
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import aspell
+import benchmark_corpus as corpus
+
+
+encodings	= ['ascii', 'iso-8859-1', 'utf-8']
+sug_modes	= ['ultra', 'fast', 'normal', 'slow', 'bad-spellers']
+batch_sizes	= [1, 10, 100, 1000]
+threads		= [1, 2, 4, 8]
+
+clock = time.perf_counter
+
+
+def percentile(sorted_values, q):
+	if not sorted_values:
+		return None
+
+	i = min(len(sorted_values) - 1, int(q * len(sorted_values)))
+	return sorted_values[i]
+
+
+def measure(function, items, words_per_item=1):
+	"""calls function for each item: once to get throughput, then
+	   again timing each call to get latency percentiles"""
+
+	start = clock()
+	for item in items:
+		function(item)
+	elapsed = clock() - start
+
+	latency = []
+	for item in items:
+		t0 = clock()
+		function(item)
+		latency.append(clock() - t0)
+
+	latency.sort()
+	calls = len(items)
+	words = calls * words_per_item
+	return {
+		'calls'			: calls,
+		'words'			: words,
+		'seconds'		: elapsed,
+		'words_per_sec'	: words / elapsed if elapsed > 0 else None,
+		'p50_us'		: percentile(latency, 0.50) * 1e6,
+		'p99_us'		: percentile(latency, 0.99) * 1e6,
+		'p999_us'		: percentile(latency, 0.999) * 1e6,
+	}
+
+
+def measure_threads(make_function, items, nthreads):
+	"""each thread calls its own function for a share of items;
+	   returns aggregated throughput and latency"""
+
+	shares = [items[i::nthreads] for i in range(nthreads)]
+	latencies = [[] for i in range(nthreads)]
+	barrier = threading.Barrier(nthreads + 1)
+
+	def worker(index):
+		function = make_function()
+		latency = latencies[index]
+		barrier.wait()
+		for item in shares[index]:
+			t0 = clock()
+			function(item)
+			latency.append(clock() - t0)
+
+	workers = [threading.Thread(target=worker, args=(i,)) for i in range(nthreads)]
+	for thread in workers:
+		thread.start()
+
+	barrier.wait()
+	start = clock()
+	for thread in workers:
+		thread.join()
+	elapsed = clock() - start
+
+	latency = sorted(sum(latencies, []))
+	return {
+		'calls'			: len(items),
+		'words'			: len(items),
+		'seconds'		: elapsed,
+		'words_per_sec'	: len(items) / elapsed if elapsed > 0 else None,
+		'p50_us'		: percentile(latency, 0.50) * 1e6,
+		'p99_us'		: percentile(latency, 0.99) * 1e6,
+		'p999_us'		: percentile(latency, 0.999) * 1e6,
+	}
+
+
+class Benchmark(object):
+	def __init__(self, options):
+		self.options = options
+		self.results = []
+		self.notes = {}
+		self.size = 2000 if options.quick else 50000
+		self.suggest_size = 100 if options.quick else 2000
+
+	def config(self, *pairs):
+		return (('lang', self.options.lang),) + pairs
+
+	def speller(self, *pairs):
+		return aspell.Speller(*self.config(*pairs))
+
+	def report(self, result, **params):
+		params.update(result)
+		self.results.append(params)
+
+		keys = ['op', 'impl', 'encoding', 'sug_mode', 'bucket', 'batch', 'threads']
+		label = ' '.join('%s=%s' % (key, params[key]) for key in keys if key in params)
+		print('%-60s %12.0f words/s  p50 %8.1f us  p99 %8.1f us  p999 %8.1f us' % (
+			label,
+			result['words_per_sec'] or 0,
+			result['p50_us'],
+			result['p99_us'],
+			result['p999_us'],
+		))
+
+	def run_check(self):
+		for encoding in encodings:
+			speller = self.speller(('encoding', encoding))
+			words = corpus.corpus(self.size, non_ascii=(encoding != 'ascii'))
+			if encoding == 'ascii':
+				words = [word for word in words if all(ord(c) < 128 for c in word)]
+
+			for bucket, wordlist in sorted(corpus.by_length(words).items()):
+				if wordlist:
+					self.report(measure(speller.check, wordlist), op='check', impl='c', encoding=encoding, bucket=bucket)
+
+	def run_suggest(self):
+		wordlist = corpus.typos(self.suggest_size)
+		for mode in sug_modes:
+			try:
+				speller = self.speller(('sug-mode', mode))
+			except (aspell.AspellConfigError, aspell.AspellSpellerError) as e:
+				print('sug-mode %s: %s' % (mode, e))
+				continue
+
+			for bucket, words in sorted(corpus.by_length(wordlist).items()):
+				if words:
+					self.report(measure(speller.suggest, words), op='suggest', impl='c', sug_mode=mode, bucket=bucket)
+
+	def run_batches(self):
+		speller = self.speller()
+		words = corpus.corpus(self.size)
+		for size in batch_sizes:
+			batches = [words[i:i+size] for i in range(0, len(words) - size + 1, size)]
+			self.report(measure(speller.checkMany, batches, size), op='checkMany', impl='c', batch=size)
+
+	def run_threads(self):
+		config = self.config()
+		words = corpus.corpus(self.size)
+		typos = corpus.typos(self.suggest_size)
+		for n in threads:
+			self.report(measure_threads(lambda: aspell.Speller(*config).check, words, n), op='check', impl='c', threads=n)
+			self.report(measure_threads(lambda: aspell.Speller(*config).suggest, typos, n), op='suggest', impl='c', threads=n)
+
+	def run_ctypes(self):
+		try:
+			try:
+				from pyaspell.pyaspell import AspellLinux	# package from setup.ctypes.py
+			except ImportError:
+				from pyaspell import AspellLinux
+
+			speller = AspellLinux(self.config(), self.options.ctypes_lib)
+		except Exception as e:
+			print('ctypes module skipped: %s' % e)
+			return
+
+		words = corpus.corpus(self.size)
+		typos = corpus.typos(self.suggest_size)
+		c_speller = self.speller()
+		try:
+			self.report(measure(speller.check, words), op='check', impl='ctypes')
+			self.report(measure(c_speller.check, words), op='check', impl='c')
+			self.report(measure(speller.suggest, typos), op='suggest', impl='ctypes')
+			self.report(measure(c_speller.suggest, typos), op='suggest', impl='c')
+			for size in batch_sizes:
+				batches = [words[i:i+size] for i in range(0, len(words) - size + 1, size)]
+				self.report(measure(speller.check_many, batches, size), op='checkMany', impl='ctypes', batch=size)
+				self.report(measure(c_speller.checkMany, batches, size), op='checkMany', impl='c', batch=size)
+		finally:
+			speller.close()
+
+	def run_ctypes_process(self):
+		"runs ctypes benchmark in a child process, a crash doesn't lose other results"
+
+		fd, path = tempfile.mkstemp(suffix='.json')
+		os.close(fd)
+		try:
+			args = [sys.executable, os.path.abspath(__file__), '--ctypes-only', '--output', path, '--lang', self.options.lang]
+			if self.options.quick:
+				args.append('--quick')
+			if self.options.ctypes_lib:
+				args.extend(['--ctypes-lib', self.options.ctypes_lib])
+
+			code = subprocess.call(args)
+			if code != 0:
+				self.notes['ctypes'] = 'child process failed with code %d' % code
+				print('ctypes benchmark: %s' % self.notes['ctypes'])
+				return
+
+			with open(path) as f:
+				self.results.extend(json.load(f)['results'])
+		finally:
+			os.remove(path)
+
+	def run(self):
+		if self.options.ctypes_only:
+			self.run_ctypes()
+			return
+
+		self.run_check()
+		self.run_suggest()
+		self.run_batches()
+		self.run_threads()
+		self.run_ctypes_process()
+
+	def save(self, path):
+		data = {
+			'meta': {
+				'time'		: time.strftime('%Y-%m-%dT%H:%M:%S'),
+				'python'	: platform.python_version(),
+				'platform'	: platform.platform(),
+				'cpus'		: os.cpu_count(),
+				'lang'		: self.options.lang,
+				'quick'		: self.options.quick,
+			},
+			'notes': self.notes,
+			'results': self.results,
+		}
+
+		with open(path, 'w') as f:
+			json.dump(data, f, indent=1, sort_keys=True)
+
+
+def main():
+	parser = argparse.ArgumentParser(description='check and suggest benchmark')
+	parser.add_argument('--quick', action='store_true', help='use small corpus')
+	parser.add_argument('--output', default='bench.json', help='JSON file with results')
+	parser.add_argument('--lang', default='en', help='dictionary')
+	parser.add_argument('--ctypes-lib', default=None, help='aspell library used by the ctypes module')
+	parser.add_argument('--ctypes-only', action='store_true', help=argparse.SUPPRESS)
+	options = parser.parse_args()
+
+	benchmark = Benchmark(options)
+	benchmark.run()
+	benchmark.save(options.output)
+	if not options.ctypes_only:
+		print('results saved in %s' % options.output)
+
+
+if __name__ == '__main__':
+	main()
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -0,0 +1,45 @@
+# Measures time of a single call of the most frequently used methods,
+# i.e. mostly the cost of calling convention and argument parsing.
+# Run against two builds of the module to compare them.
+#
+# usage: python3 test/benchmark_calls.py [number of calls]
+
+import sys
+import timeit
+
+import aspell
+
+
+def measure(function, number):
+	best = min(timeit.repeat(function, number=number, repeat=5))
+	return best / number * 1e9
+
+
+def main():
+	number = 100000
+	if len(sys.argv) > 1:
+		number = int(sys.argv[1])
+
+	speller = aspell.Speller(('lang', 'en'))
+	check			= speller.check
+	suggest			= speller.suggest
+	addtoSession	= speller.addtoSession
+	addReplacement	= speller.addReplacement
+
+	calls = [
+		('check',			lambda: check('word')),
+		('in',				lambda: 'word' in speller),
+		('suggest',			lambda: suggest('wrod')),
+		('addtoSession',	lambda: addtoSession('pyaspell')),
+		('addReplacement',	lambda: addReplacement('wrod', 'word')),
+	]
+
+	print("%-16s %12s" % ("method", "ns/call"))
+	for name, function in calls:
+		print("%-16s %12.1f" % (name, measure(function, number)))
+
+
+if __name__ == '__main__':
+	main()
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -0,0 +1,199 @@
+# Synthetic corpus for benchmark.py: common English words and typos
+# made by a simple keyboard model (neighbouring key pressed instead,
+# key pressed twice, key missed, two keys swapped). The corpus is
+# generated from a fixed seed, thus all runs use the same words.
+
+import random
+
+
+words = '''
+a about above accept account across act action activity actually add address
+administration admit adult affect after again against age agency agent ago agree
+agreement ahead air all allow almost alone along already also although always
+among amount analysis and animal another answer any anyone anything appear apply
+approach area argue arm around arrive art article artist as ask assume at attack
+attention attorney audience author authority available avoid away baby back bad
+bag ball bank bar base be beat beautiful because become bed before begin behavior
+behind believe benefit best better between beyond big bill billion bit black
+blood blue board body book born both box boy break bring brother budget build
+building business but buy by call camera campaign can cancer candidate capital
+car card care career carry case catch cause cell center central century certain
+certainly chair challenge chance change character charge check child choice
+choose church citizen city civil claim class clear clearly close coach cold
+collection college color come commercial common community company compare
+computer concern condition conference congress consider consumer contain continue
+control cost could country couple course court cover create crime cultural
+culture cup current customer cut dark data daughter day dead deal death debate
+decade decide decision deep defense degree democrat democratic describe design
+despite detail determine develop development difference different difficult
+dinner direction director discover discuss discussion disease do doctor dog door
+down draw dream drive drop drug during each early east easy eat economic economy
+edge education effect effort eight either election else employee end energy
+enjoy enough enter entire environment environmental especially establish even
+evening event ever every everybody everyone everything evidence exactly example
+executive exist expect experience expert explain eye face fact factor fail fall
+family far fast father fear federal feel feeling few field fight figure fill
+film final finally financial find fine finger finish fire firm first fish five
+floor fly focus follow food foot for force foreign forget form former forward
+four free friend from front full fund future game garden gas general generation
+get girl give glass go goal good government great green ground group grow growth
+guess gun guy hair half hand hang happen happy hard have he head health hear
+heart heat heavy help her here herself high him himself his history hit hold
+home hope hospital hot hotel hour house how however huge human hundred husband
+idea identify if image imagine impact important improve in include including
+increase indeed indicate individual industry information inside instead
+institution interest interesting international interview into investment
+involve issue it item its itself job join just keep key kid kill kind kitchen
+know knowledge land language large last late later laugh law lawyer lay lead
+leader learn least leave left leg legal less let letter level lie life light
+like likely line list listen little live local long look lose loss lot love low
+machine magazine main maintain major majority make man manage management manager
+many market marriage material matter may maybe me mean measure media medical
+meet meeting member memory mention message method middle might military million
+mind minute miss mission model modern moment money month more morning most
+mother mouth move movement movie much music must my myself name nation national
+natural nature near nearly necessary need network never new news newspaper next
+nice night no none nor north not note nothing notice now number occur of off
+offer office officer official often oil old on once one only onto open operation
+opportunity option or order organization other others our out outside over own
+owner page pain painting paper parent part participant particular particularly
+partner party pass past patient pattern pay peace people per perform performance
+perhaps period person personal phone physical pick picture piece place plan
+plant play player point police policy political politics poor popular population
+position positive possible power practice prepare present president pressure
+pretty prevent price private probably problem process produce product production
+professional professor program project property protect prove provide public
+pull purpose push put quality question quickly quite race radio raise range rate
+rather reach read ready real reality realize really reason receive recent
+recently recognize record red reduce reflect region relate relationship religious
+remain remember remove report represent republican require research resource
+respond response responsibility rest result return reveal rich right rise risk
+road rock role room rule run safe same save say scene school science scientist
+score sea season seat second section security see seek seem sell send senior
+sense series serious serve service set seven several shake share she shoot short
+shot should shoulder show side sign significant similar simple simply since sing
+single sister sit site situation six size skill skin small smile so social
+society soldier some somebody someone something sometimes son song soon sort
+sound source south southern space speak special specific speech spend sport
+spring staff stage stand standard star start state statement station stay step
+still stock stop store story strategy street strong structure student study stuff
+style subject success successful such suddenly suffer suggest summer support sure
+surface system table take talk task tax teach teacher team technology television
+tell ten tend term test than thank that the their them themselves then theory
+there these they thing think third this those though thought thousand threat
+three through throughout throw thus time to today together tonight too top total
+tough toward town trade traditional training travel treat treatment tree trial
+trip trouble true truth try turn two type under understand unit until up upon us
+use usually value various very victim view violence visit voice vote wait walk
+wall want war watch water way we weapon wear week weight well west western what
+whatever when where whether which while white who whole whom whose why wide wife
+will win wind window wish with within without woman wonder word work worker world
+worry would write writer wrong yard yeah year yes yet you young your yourself
+'''.split()
+
+# words with characters outside ASCII, for non-ASCII encodings
+words_latin1 = [
+	u'caf\xe9', u'na\xefve', u'd\xe9j\xe0', u'cr\xe8me', u'fa\xe7ade',
+	u'r\xe9sum\xe9', u'pi\xf1ata', u'se\xf1or', u'\xfcber', u'jalape\xf1o',
+	u'fianc\xe9e', u'na\xefvet\xe9', u'attach\xe9', u'entr\xe9e', u'prot\xe9g\xe9',
+]
+
+keyboard = [
+	'qwertyuiop',
+	'asdfghjkl',
+	'zxcvbnm',
+]
+
+
+def _neighbours():
+	position = {}
+	for row, keys in enumerate(keyboard):
+		for col, key in enumerate(keys):
+			position[key] = (row, col)
+
+	result = {}
+	for key, (row, col) in position.items():
+		result[key] = [
+			other for other, (r, c) in position.items()
+			if other != key and abs(r - row) <= 1 and abs(c - col) <= 1
+		]
+
+	return result
+
+
+neighbours = _neighbours()
+
+
+def typo(word, rnd):
+	"returns word with a single keyboard error"
+
+	i = rnd.randrange(len(word))
+	kind = rnd.choice(['substitute', 'double', 'miss', 'swap'])
+	if kind == 'swap' and len(word) < 2:
+		kind = 'double'
+	if kind == 'miss' and len(word) < 2:
+		kind = 'substitute'
+
+	if kind == 'substitute':
+		near = neighbours.get(word[i].lower())
+		if not near:
+			return word + 'x'
+		return word[:i] + rnd.choice(near) + word[i+1:]
+	elif kind == 'double':
+		return word[:i] + word[i] + word[i:]
+	elif kind == 'miss':
+		return word[:i] + word[i+1:]
+	else:
+		i = min(i, len(word) - 2)
+		return word[:i] + word[i+1] + word[i] + word[i+2:]
+
+
+def length_bucket(word):
+	n = len(word)
+	if n <= 4:
+		return '1-4'
+	elif n <= 8:
+		return '5-8'
+	elif n <= 12:
+		return '9-12'
+	else:
+		return '13+'
+
+
+buckets = ['1-4', '5-8', '9-12', '13+']
+
+
+def corpus(size, typo_rate=0.2, non_ascii=False, seed=1234):
+	"returns list of size words, typo_rate of them misspelled"
+
+	rnd = random.Random(seed)
+	source = words + words_latin1 if non_ascii else words
+
+	result = []
+	for i in range(size):
+		word = rnd.choice(source)
+		if rnd.random() < typo_rate:
+			word = typo(word, rnd)
+
+		result.append(word)
+
+	return result
+
+
+def typos(size, seed=4321):
+	"returns list of size misspelled words"
+
+	rnd = random.Random(seed)
+	return [typo(rnd.choice(words), rnd) for i in range(size)]
+
+
+def by_length(wordlist):
+	"groups words by length bucket"
+
+	result = dict((bucket, []) for bucket in buckets)
+	for word in wordlist:
+		result[length_bucket(word)].append(word)
+
+	return result
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -0,0 +1,49 @@
+# Measures time of a single check() call for spellers using
+# different encodings. Run against two builds of the module to
+# compare them.
+#
+# usage: python3 test/benchmark_encoding.py [number of calls]
+
+import sys
+import timeit
+
+import aspell
+
+
+encodings = ['ascii', 'iso-8859-1', 'utf-8']
+
+words = {
+	'ascii'		: ['word', 'flower', 'wrod', 'misteke'],
+	'non-ascii'	: [u'caf\xe9', u'na\xefve', u'd\xe9j\xe0', u'cr\xe8me'],
+}
+
+
+def measure(speller, wordlist, number):
+	check = speller.check
+	def run():
+		for word in wordlist:
+			check(word)
+
+	best = min(timeit.repeat(run, number=number, repeat=5))
+	return best / (number * len(wordlist)) * 1e9
+
+
+def main():
+	number = 20000
+	if len(sys.argv) > 1:
+		number = int(sys.argv[1])
+
+	print("%-12s %-10s %12s" % ("encoding", "words", "ns/call"))
+	for encoding in encodings:
+		speller = aspell.Speller(('lang', 'en'), ('encoding', encoding))
+		for kind in sorted(words):
+			if encoding == 'ascii' and kind == 'non-ascii':
+				continue
+
+			print("%-12s %-10s %12.1f" % (encoding, kind, measure(speller, words[kind], number)))
+
+
+if __name__ == '__main__':
+	main()
+
+# vim: ts=4 sw=4 nowrap noexpandtab
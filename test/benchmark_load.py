@@ -0,0 +1,78 @@
+# Measures time of loading a list of terms into the session dictionary:
+# addtoSession() called in a loop, a single addtoSessionMany() call and
+# loadSessionFile().
+#
+# usage: python3 test/benchmark_load.py [number of terms ...]
+
+import os
+import sys
+import tempfile
+import time
+
+import aspell
+
+
+def make_terms(count):
+	"returns list of distinct, letters-only terms"
+	letters = 'abcdefghijklmnopqrstuvwxyz'
+	terms = []
+	for i in range(count):
+		term = ''
+		while True:
+			term += letters[i % 26]
+			i //= 26
+			if i == 0:
+				break
+
+		terms.append('zq' + term)
+
+	return terms
+
+
+def measure(speller, function):
+	speller.clearSession()
+	start = time.perf_counter()
+	function()
+	return time.perf_counter() - start
+
+
+def main():
+	sizes = [10000, 100000, 1000000]
+	if len(sys.argv) > 1:
+		sizes = [int(arg) for arg in sys.argv[1:]]
+
+	speller = aspell.Speller(('lang', 'en'))
+
+	print("%-10s %-18s %10s %14s" % ("terms", "method", "seconds", "terms/s"))
+	for size in sizes:
+		terms = make_terms(size)
+
+		fd, path = tempfile.mkstemp(suffix='.txt')
+		with os.fdopen(fd, 'w') as f:
+			f.write('\n'.join(terms))
+
+		def loop():
+			add = speller.addtoSession
+			for term in terms:
+				add(term)
+
+		methods = [
+			('addtoSession',		loop),
+			('addtoSessionMany',	lambda: speller.addtoSessionMany(terms)),
+			('loadSessionFile',		lambda: speller.loadSessionFile(path)),
+		]
+
+		try:
+			for name, function in methods:
+				seconds = measure(speller, function)
+				print("%-10d %-18s %10.3f %14.0f" % (size, name, seconds, size / seconds))
+		finally:
+			os.remove(path)
+
+	speller.clearSession()
+
+
+if __name__ == '__main__':
+	main()
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -0,0 +1,55 @@
+# Compares checking words against several dictionaries with a loop
+# over separate spellers and with MultiSpeller, word by word and in
+# batches.
+#
+# usage: python3 test/benchmark_multi.py [number of words] [lang ...]
+
+import sys
+import time
+
+import aspell
+
+
+def measure(function):
+	start = time.perf_counter()
+	function()
+	return time.perf_counter() - start
+
+
+def main():
+	count = 100000
+	langs = ['en', 'de', 'pl']
+	if len(sys.argv) > 1:
+		count = int(sys.argv[1])
+	if len(sys.argv) > 2:
+		langs = sys.argv[2:]
+
+	spellers = [aspell.Speller(('lang', lang)) for lang in langs]
+	multi = aspell.MultiSpeller(spellers)
+
+	# mostly words from later dictionaries and misspellings
+	sample = ['word', 'haus', 'kot', 'wrod', 'xyzzy', 'drzewo']
+	words = [sample[i % len(sample)] + ('' if i % 2 else 's') for i in range(count)]
+
+	def loop():
+		for word in words:
+			for speller in spellers:
+				if speller.check(word):
+					break
+
+	methods = [
+		('Speller loop',			loop),
+		('MultiSpeller.check',		lambda: [multi.check(word) for word in words]),
+		('MultiSpeller.checkMany',	lambda: multi.checkMany(words)),
+	]
+
+	print("%-24s %10s %14s" % ("method", "seconds", "words/s"))
+	for name, function in methods:
+		seconds = measure(function)
+		print("%-24s %10.3f %14.0f" % (name, seconds, count / seconds))
+
+
+if __name__ == '__main__':
+	main()
+
+# vim: ts=4 sw=4 nowrap noexpandtab
@@ -1,4 +1,6 @@
+# -*- coding: utf-8 -*-
 import unittest
+import gc
 import os
 import sys
 
@@ -52,6 +54,163 @@ class TestCheckMethod(TestBase):
 			self.assertFalse(word in self.speller)
 			self.assertTrue(word not in self.speller)
 
+	def test_number_of_arguments(self):
+		self.assertRaises(TypeError, self.speller.check)
+		self.assertRaises(TypeError, self.speller.check, 'word', 'tree')
+		self.assertRaises(TypeError, self.speller.suggest)
+		self.assertRaises(TypeError, self.speller.addtoSession, 'word', 'tree')
+		self.assertRaises(TypeError, self.speller.addReplacement, 'wrod')
+
+
+class TestCheckManyMethod(TestBase):
+	"test checkMany method"
+
+	words = ['word', 'misteke', 'flower', 'zo', 'tree', 'bicyle']
+
+	def test_mask(self):
+		mask = self.speller.checkMany(self.words)
+		self.assertEqual(type(mask), bytearray)
+		self.assertEqual(list(mask), [1, 0, 1, 0, 1, 0])
+
+	def test_indices(self):
+		idx = self.speller.checkMany(self.words, indices=True)
+		self.assertEqual(idx, [1, 3, 5])
+
+	def test_iterables(self):
+		expected = bytearray([1, 0, 1, 0, 1, 0])
+		self.assertEqual(self.speller.checkMany(tuple(self.words)), expected)
+		self.assertEqual(self.speller.checkMany(iter(self.words)), expected)
+		self.assertEqual(self.speller.checkMany(w for w in self.words), expected)
+
+	def test_empty(self):
+		self.assertEqual(self.speller.checkMany([]), bytearray())
+		self.assertEqual(self.speller.checkMany([], indices=True), [])
+
+	def test_same_as_check(self):
+		mask = self.speller.checkMany(self.words)
+		for word, correct in zip(self.words, mask):
+			self.assertEqual(self.speller.check(word), bool(correct))
+
+	def test_wrong_type(self):
+		with self.assertRaises(TypeError):
+			self.speller.checkMany(['word', 42])
+
+		with self.assertRaises(TypeError):
+			self.speller.checkMany(42)
+
+
+class TestCheckBufferMethod(TestBase):
+	"test checkBuffer method"
+
+	words = ['word', 'misteke', 'flower', 'zo', 'tree', 'bicyle']
+
+	def test_mask(self):
+		data = '\n'.join(self.words).encode('ascii')
+		mask = self.speller.checkBuffer(data)
+		self.assertEqual(type(mask), bytearray)
+		self.assertEqual(mask, self.speller.checkMany(self.words))
+
+		# trailing separator doesn't add a word
+		self.assertEqual(self.speller.checkBuffer(data + b'\n'), mask)
+
+	def test_offsets(self):
+		data = b'word\nmisteke\n\ntree\nzo'
+		offsets = self.speller.checkBuffer(data, offsets=True)
+		self.assertEqual(offsets.typecode, 'q')
+		self.assertEqual(list(offsets), [5, 19])
+
+	def test_separators(self):
+		data = bytearray(b'word\0misteke\0tree')
+		self.assertEqual(list(self.speller.checkBuffer(data, sep=b'\0')), [1, 0, 1])
+
+		data = memoryview(b'word, misteke, tree')
+		self.assertEqual(list(self.speller.checkBuffer(data, sep=b', ')), [1, 0, 1])
+
+	def test_empty(self):
+		self.assertEqual(self.speller.checkBuffer(b''), bytearray())
+		self.assertEqual(list(self.speller.checkBuffer(b'', offsets=True)), [])
+
+	def test_wrong_arguments(self):
+		self.assertRaises(TypeError, self.speller.checkBuffer, 'word')
+		self.assertRaises(ValueError, self.speller.checkBuffer, b'word', sep=b'')
+
+
+class TestCheckDocumentMethod(TestBase):
+	"test checkDocument method"
+
+	def test_plain(self):
+		text = 'This is some text with a mistkae and anothr one.'
+		spans = self.speller.checkDocument(text, mode='none')
+		words = [text[offset:offset+length] for offset, length in spans]
+		self.assertEqual(words, ['mistkae', 'anothr'])
+
+	def test_html(self):
+		text = '<p class="klass">Hello <b>wrold</b></p>'
+		spans = self.speller.checkDocument(text, mode='html')
+		words = [text[offset:offset+length] for offset, length in spans]
+		self.assertEqual(words, ['wrold'])
+
+	def test_character_offsets(self):
+		if self.config['encoding'] not in ('utf-8', 'utf8'):
+			self.skipTest("requires utf-8 dictionary")
+
+		text = u'zażółć wrold'
+		self.assertEqual(self.speller.checkDocument(text, mode='none')[-1], (7, 5))
+
+		data = text.encode('utf-8')
+		self.assertEqual(self.speller.checkDocument(data, mode='none')[-1], (11, 5))
+
+	def test_mode_is_restored(self):
+		before = self.speller.ConfigKeys()['mode']
+		self.speller.checkDocument('text', mode='html')
+		self.assertEqual(self.speller.ConfigKeys()['mode'], before)
+
+	def test_empty(self):
+		self.assertEqual(self.speller.checkDocument(''), [])
+
+
+class TestCheckFileMethod(TestBase):
+	def setUp(self):
+		TestBase.setUp(self)
+		import tempfile
+		fd, self.path = tempfile.mkstemp(suffix='.txt')
+		os.close(fd)
+
+	def tearDown(self):
+		os.remove(self.path)
+
+	def write(self, data):
+		with open(self.path, 'wb') as f:
+			f.write(data)
+
+	def test_records(self):
+		self.write(b'word wrod\n\ntree misteke\nflower')
+		result = list(self.speller.checkFile(self.path, mode='none'))
+		self.assertEqual(result, [(5, 1, 'wrod'), (16, 3, 'misteke')])
+
+	def test_same_as_checkDocument(self):
+		lines = ['word wrod tree'] * 5000 + ['misteke ' * 20000, 'flower zo']
+		self.write('\n'.join(lines).encode('ascii'))
+
+		expected = []
+		offset = 0
+		for number, line in enumerate(lines, 1):
+			for start, length in self.speller.checkDocument(line, mode='none'):
+				expected.append((offset + start, number, line[start:start+length]))
+			offset += len(line) + 1
+
+		self.assertEqual(list(self.speller.checkFile(self.path, mode='none')), expected)
+
+	def test_html(self):
+		self.write(b'<p class="klass">Hello <b>wrold</b></p>\n')
+		self.assertEqual([word for _, _, word in self.speller.checkFile(self.path, mode='html')], ['wrold'])
+
+	def test_empty(self):
+		self.assertEqual(list(self.speller.checkFile(self.path)), [])
+
+	def test_errors(self):
+		self.assertRaises(OSError, self.speller.checkFile, self.path + '.missing')
+
 
 class TestSuggestMethod(TestBase):
 	def test(self):
@@ -65,6 +224,67 @@ class TestSuggestMethod(TestBase):
 			sug = self.speller.suggest(incorrect)
 			self.assertTrue(correct in sug)
 
+	def test_limit(self):
+		sug = self.speller.suggest('wrod')
+		self.assertEqual(self.speller.suggest('wrod', limit=2), sug[:2])
+		self.assertEqual(self.speller.suggest('wrod', 2), sug[:2])
+		self.assertEqual(self.speller.suggest('wrod', limit=0), [])
+		self.assertEqual(self.speller.suggest('wrod', limit=None), sug)
+		self.assertEqual(self.speller.suggest('wrod', limit=len(sug) + 10), sug)
+
+	def test_mode(self):
+		before = self.speller.ConfigKeys()['sug-mode']
+		sug = self.speller.suggest('wrod', mode='ultra')
+		self.assertTrue('word' in sug)
+		self.assertEqual(self.speller.ConfigKeys()['sug-mode'], before)
+
+		self.speller.setConfigKey('sug-mode', 'ultra')
+		self.assertEqual(self.speller.suggest('wrod'), sug)
+
+	def test_wrong_arguments(self):
+		self.assertRaises(ValueError, self.speller.suggest, 'wrod', limit=-1)
+		self.assertRaises(TypeError, self.speller.suggest, 'wrod', limit='2')
+		self.assertRaises(TypeError, self.speller.suggest, 'wrod', mode=1)
+		self.assertRaises(TypeError, self.speller.suggest, 'wrod', foo=1)
+		self.assertRaises(TypeError, self.speller.suggest, 'wrod', 1, word='wrod')
+		self.assertRaises(TypeError, self.speller.suggest, limit=1)
+
+
+class TestSuggestManyMethod(TestBase):
+	words = ['wrod', 'tre', 'xoo', 'wrod', 'rokc', 'tre']
+
+	def test_order(self):
+		for threads in [1, 2, 4]:
+			result = self.speller.suggestMany(self.words, threads=threads)
+			self.assertEqual(result, [self.speller.suggest(word) for word in self.words])
+
+	def test_duplicates(self):
+		result = self.speller.suggestMany(self.words, threads=3)
+		self.assertEqual(result[0], result[3])
+		self.assertFalse(result[0] is result[3])
+
+	def test_empty(self):
+		self.assertEqual(self.speller.suggestMany([]), [])
+
+	def test_session_and_replacements(self):
+		self.speller.suggestMany(self.words, threads=4)
+
+		self.speller.addtoSession('wrodd')
+		self.speller.addReplacement('wrod', 'trod')
+
+		result = self.speller.suggestMany(['wrod'] * 3 + ['rokc', 'tre'], threads=4)
+		self.assertEqual(result[0][0], 'trod')
+		self.assertTrue('wrodd' in result[0])
+		self.assertEqual(result[4], self.speller.suggest('tre'))
+
+	def test_errors(self):
+		self.assertRaises(ValueError, self.speller.suggestMany, self.words, threads=0)
+
+		with self.assertRaises(TypeError) as cm:
+			self.speller.suggestMany(['wrod', 1])
+
+		self.assertTrue('#1' in str(cm.exception))
+
 
 class TestAddReplacementMethod(TestBase):
 	def test(self):
@@ -83,6 +303,181 @@ class TestAddReplacementMethod(TestBase):
 		self.assertEqual(sug[0], correct)
 
 
+class TestSuggestCache(TestBase):
+	def setUp(self):
+		TestBase.setUp(self)
+		self.speller.setSuggestCache(2)
+
+	def test_disabled_by_default(self):
+		s = aspell.Speller(('lang', 'en'))
+		s.suggest('wrod')
+		stats = s.suggestCacheStats()
+		self.assertFalse(stats['enabled'])
+		self.assertEqual(stats['hits'], 0)
+
+	def test_hits(self):
+		sug1 = self.speller.suggest('wrod')
+		sug2 = self.speller.suggest('wrod')
+		self.assertEqual(sug1, sug2)
+
+		# result is a copy
+		sug2.append('foo')
+		self.assertEqual(self.speller.suggest('wrod'), sug1)
+
+		stats = self.speller.suggestCacheStats()
+		self.assertEqual(stats['hits'], 2)
+		self.assertEqual(stats['misses'], 1)
+		self.assertEqual(stats['entries'], 1)
+
+	def test_lru(self):
+		self.speller.suggest('wrod')
+		self.speller.suggest('tre')
+		self.speller.suggest('wrod')
+		self.speller.suggest('xoo')	# evicts 'tre'
+
+		stats = self.speller.suggestCacheStats()
+		self.assertEqual(stats['entries'], 2)
+		self.assertEqual(stats['evictions'], 1)
+
+		self.speller.suggest('wrod')
+		self.speller.suggest('tre')
+		stats = self.speller.suggestCacheStats()
+		self.assertEqual(stats['hits'], 2)
+		self.assertEqual(stats['misses'], 4)
+
+	def test_bytes_limit(self):
+		self.speller.setSuggestCache(0, 1)
+		self.speller.suggest('wrod')
+		self.assertEqual(self.speller.suggestCacheStats()['entries'], 0)
+
+	def test_raw_bytes(self):
+		raw = aspell.Speller(('lang', 'en'), raw=True)
+		raw.setSuggestCache(2)
+		suggestions = raw.suggest(b'wrod')
+		stats = raw.suggestCacheStats()
+		self.assertEqual(stats['entries'], 1)
+		self.assertGreater(stats['bytes'], sum(map(len, suggestions)))
+
+	def test_wide_strings(self):
+		"strings are accounted with their real size"
+
+		def cached(word, wrong):
+			speller = aspell.Speller(('lang', 'en'), ('encoding', 'utf-8'))
+			speller.setSuggestCache(2)
+			try:
+				speller.addtoSession(word)
+			except aspell.AspellSpellerError:
+				self.skipTest('dictionary rejects the word')
+
+			suggestions = speller.suggest(wrong)
+			if suggestions != [word]:
+				self.skipTest('unexpected suggestions')
+
+			return speller.suggestCacheStats()['bytes'], len(wrong.encode('utf-8'))
+
+		wide = '\U0001F600' * 4
+		wide_bytes, wide_key = cached(wide, wide + 'x')
+		ascii_bytes, ascii_key = cached('qqqq', 'qqqqx')
+
+		# entries differ only by keys and the sizes of strings; a fresh
+		# copy is measured, the word has a cached UTF-8 form
+		self.assertGreaterEqual(
+			wide_bytes - ascii_bytes,
+			sys.getsizeof(wide.encode('utf-8').decode('utf-8')) - sys.getsizeof('qqqq') + wide_key - ascii_key
+		)
+
+	def test_invalidation(self):
+		wrong = 'wrod'
+		self.assertEqual(self.speller.suggest(wrong)[0], 'word')
+
+		self.speller.addReplacement(wrong, 'trod')
+		self.assertEqual(self.speller.suggest(wrong)[0], 'trod')
+
+		for method, args in [
+			('addtoSession', ('kot',)),
+			('addtoPersonal', ('kot',)),
+			('clearSession', ()),
+			('setConfigKey', ('sug-mode', 'normal')),
+		]:
+			self.speller.suggest(wrong)
+			getattr(self.speller, method)(*args)
+			self.assertEqual(self.speller.suggestCacheStats()['entries'], 0, method)
+
+	def test_limit_and_mode(self):
+		sug = self.speller.suggest('wrod', limit=1)
+		self.assertEqual(len(sug), 1)
+		self.assertEqual(self.speller.suggest('wrod')[:1], sug)	# complete list is cached
+
+		self.speller.suggest('wrod', mode='bad-spellers')
+		stats = self.speller.suggestCacheStats()
+		self.assertEqual(stats['hits'], 1)
+		self.assertEqual(stats['entries'], 2)
+
+	def test_disable(self):
+		self.speller.suggest('wrod')
+		self.speller.setSuggestCache(0)
+		stats = self.speller.suggestCacheStats()
+		self.assertFalse(stats['enabled'])
+		self.assertEqual(stats['entries'], 0)
+
+
+class TestFinalizers(TestBase):
+	"python objects are not created under the speller's lock"
+
+	def setUp(self):
+		TestBase.setUp(self)
+		self.threshold = gc.get_threshold()
+		self.calls = 0
+
+	def tearDown(self):
+		gc.set_threshold(*self.threshold)
+
+	def garbage(self):
+		"cyclic garbage; its finalizer uses the speller"
+
+		test = self
+		class Node(object):
+			def __del__(self):
+				test.speller.check('word')
+				test.calls += 1
+
+		node = Node()
+		node.cycle = node
+
+	def run_with_gc(self, function):
+		gc.set_threshold(1)
+		for i in range(20):
+			self.garbage()
+			function()
+		gc.set_threshold(*self.threshold)
+		gc.collect()
+		self.assertTrue(self.calls > 0)
+
+	def test_suggest(self):
+		self.run_with_gc(lambda: self.speller.suggest('wrod'))
+
+	def test_suggest_cached(self):
+		self.speller.setSuggestCache(10)
+		self.run_with_gc(lambda: self.speller.suggest('wrod', limit=2))
+
+	def test_suggestMany(self):
+		self.speller.setSuggestCache(10)
+		self.run_with_gc(lambda: self.speller.suggestMany(['wrod', 'tre', 'wrod']))
+
+	def test_wordlist(self):
+		self.speller.addtoSession('kot')
+		self.run_with_gc(self.speller.getSessionwordlist)
+
+	def test_ConfigKeys(self):
+		self.run_with_gc(self.speller.ConfigKeys)
+
+	def test_iterMainwordlist(self):
+		self.run_with_gc(lambda: list(self.speller.iterMainwordlist()))
+
+	def test_checkDocument(self):
+		self.run_with_gc(lambda: self.speller.checkDocument('this is a txet with misteke'))
+
+
 class TestaddtoSession(TestBase):
 	def test(self):
 		
@@ -99,6 +494,70 @@ class TestaddtoSession(TestBase):
 			self.assertTrue(self.speller.check(word))
 
 
+class TestAddManyMethods(TestBase):
+	def test_addtoSessionMany(self):
+		self.speller.addtoSessionMany(iter(self.polish_words))
+		self.assertEqual(set(self.speller.getSessionwordlist()), set(self.polish_words))
+		self.assertEqual(self.speller.checkMany(self.polish_words), bytearray([1, 1, 1]))
+
+	def test_addtoPersonalMany(self):
+		self.speller.addtoPersonalMany(self.polish_words)
+		self.assertTrue(set(self.polish_words) <= set(self.speller.getPersonalwordlist()))
+
+	def test_cached_results_invalidated(self):
+		self.assertFalse(self.speller.check('kot'))
+		self.speller.addtoSessionMany(['kot'])
+		self.assertTrue(self.speller.check('kot'))
+
+	def test_errors(self):
+		with self.assertRaises(TypeError) as cm:
+			self.speller.addtoSessionMany(['kot', 1])
+		self.assertIn('word #1', str(cm.exception))
+		self.assertEqual(self.speller.getSessionwordlist(), [])
+
+		# words preceding the invalid one are added
+		with self.assertRaises(aspell.AspellSpellerError) as cm:
+			self.speller.addtoSessionMany(['kot', 'drzewo', 'two words', 'wiosna'])
+		self.assertIn('word #2', str(cm.exception))
+		self.assertEqual(self.speller.getSessionwordlist(), ['kot', 'drzewo'])
+
+		self.assertRaises(TypeError, self.speller.addtoSessionMany, 1)
+		self.assertRaises(TypeError, self.speller.addtoSessionMany)
+
+
+class TestLoadSessionFile(TestBase):
+	def setUp(self):
+		TestBase.setUp(self)
+		import tempfile
+		fd, self.path = tempfile.mkstemp(suffix='.txt')
+		os.close(fd)
+
+	def tearDown(self):
+		os.remove(self.path)
+
+	def write(self, data):
+		with open(self.path, 'wb') as f:
+			f.write(data)
+
+	def test(self):
+		self.write(b'kot\r\n\ndrzewo\nwiosna')
+		self.assertEqual(self.speller.loadSessionFile(self.path), 3)
+		self.assertEqual(self.speller.getSessionwordlist(), self.polish_words)
+
+	def test_empty(self):
+		self.write(b'')
+		self.assertEqual(self.speller.loadSessionFile(self.path), 0)
+
+	def test_errors(self):
+		self.assertRaises(OSError, self.speller.loadSessionFile, self.path + '.missing')
+
+		self.write(b'kot\n\ntwo words\ndrzewo\n')
+		with self.assertRaises(aspell.AspellSpellerError) as cm:
+			self.speller.loadSessionFile(self.path)
+		self.assertIn('line 3', str(cm.exception))
+		self.assertEqual(self.speller.getSessionwordlist(), ['kot'])
+
+
 class TestSessionwordlist(TestBase):
 	def all_correct(self):
 		for word in self.polish_words:
@@ -144,6 +603,150 @@ class TestSessionwordlist(TestBase):
 		self.all_incorrect()
 
 
+class TestWordlistIterators(TestBase):
+	def test_session(self):
+		self.assertEqual(list(self.speller.iterSessionwordlist()), [])
+		self.assertEqual(self.speller.getSessionwordlistSize(), 0)
+
+		for word in self.polish_words:
+			self.speller.addtoSession(word)
+
+		words = list(self.speller.iterSessionwordlist())
+		self.assertEqual(words, self.speller.getSessionwordlist())
+		self.assertEqual(self.speller.getSessionwordlistSize(), len(self.polish_words))
+
+	def test_many_chunks(self):
+		words = ['kot%dx' % i for i in range(1000)]
+		for word in words:
+			self.speller.addtoSession(word)
+
+		self.assertEqual(sorted(self.speller.iterSessionwordlist()), sorted(words))
+
+	def test_changed(self):
+		self.speller.addtoSession('kot')
+		it = self.speller.iterSessionwordlist()
+		self.speller.addtoSession('drzewo')
+		self.assertRaises(RuntimeError, list, it)
+
+	def test_main(self):
+		import itertools
+
+		self.assertTrue(self.speller.getMainwordlistSize() > 0)
+		words = list(itertools.islice(self.speller.iterMainwordlist(), 10))
+		self.assertEqual(len(words), 10)
+		for word in words:
+			self.assertTrue(isinstance(word, str))
+
+
+class TestMappedWordlist(TestBase):
+	def setUp(self):
+		TestBase.setUp(self)
+		import tempfile
+		fd, self.path = tempfile.mkstemp(suffix='.wl')
+		os.close(fd)
+
+	def tearDown(self):
+		os.remove(self.path)
+
+	def test_export(self):
+		self.speller.addtoPersonal('kot')
+		self.speller.exportWordlist(self.path)
+
+		wordlist = aspell.MappedWordlist(self.path)
+		self.assertEqual(len(wordlist), self.speller.getMainwordlistSize() + 1)
+		self.assertEqual(wordlist.encoding, self.config['encoding'])
+
+		for word in self.speller.iterMainwordlist():
+			self.assertTrue(word in wordlist)
+
+		self.assertTrue(wordlist.check('kot'))
+		self.assertFalse(wordlist.check('drzewo'))
+		self.assertFalse('' in wordlist)
+
+	def test_replace_mapped(self):
+		"export replaces the file, a mapped previous version stays intact"
+
+		self.speller.exportWordlist(self.path)
+		old = aspell.MappedWordlist(self.path)
+		size = len(old)
+
+		self.speller.addtoPersonal('kot')
+		self.speller.exportWordlist(self.path)
+		new = aspell.MappedWordlist(self.path)
+
+		self.assertEqual(len(old), size)
+		self.assertFalse(old.check('kot'))
+		self.assertTrue(old.check('word'))
+		self.assertEqual(len(new), size + 1)
+		self.assertTrue(new.check('kot'))
+
+		# no temporary file is left
+		directory, name = os.path.split(self.path)
+		self.assertEqual([f for f in os.listdir(directory) if f.startswith(name)], [name])
+
+	def test_fallback(self):
+		self.speller.exportWordlist(self.path)
+		self.speller.addtoSession('drzewo')
+
+		wordlist = aspell.MappedWordlist(self.path, fallback=self.speller)
+		self.assertTrue(wordlist.check('drzewo'))
+		self.assertFalse(wordlist.check('wiosna'))
+
+	def test_root_words_only(self):
+		"forms made by affix rules are not exported"
+
+		self.speller.exportWordlist(self.path)
+		roots = set(self.speller.getMainwordlist())
+		forms = [word for word in ['trees', 'flowers', 'rocks', 'winters', 'words']
+		         if word not in roots and self.speller.check(word)]
+		if not forms:
+			self.skipTest('dictionary has no affixes')
+
+		wordlist = aspell.MappedWordlist(self.path)
+		fallback = aspell.MappedWordlist(self.path, fallback=self.speller)
+		for word in forms:
+			self.assertFalse(wordlist.check(word))
+			self.assertTrue(fallback.check(word))
+
+	def test_invalid(self):
+		with open(self.path, 'wb') as f:
+			f.write(b'not a word list' * 10)
+
+		self.assertRaises(aspell.AspellModuleError, aspell.MappedWordlist, self.path)
+		self.assertRaises(OSError, aspell.MappedWordlist, self.path + '.missing')
+
+		# just a header, with a huge number of words
+		import struct
+		header = b'ASPWLST1' + b'utf-8'.ljust(32, b'\0') + struct.pack('<II', 0x40000000, 0)
+		with open(self.path, 'wb') as f:
+			f.write(header)
+
+		self.assertRaises(aspell.AspellModuleError, aspell.MappedWordlist, self.path)
+
+	def test_corrupted_offset(self):
+		import struct
+		self.speller.exportWordlist(self.path)
+		with open(self.path, 'rb') as f:
+			data = bytearray(f.read())
+
+		count = struct.unpack_from('<I', data, 40)[0]
+		for offset in [0xfffffff0, 0]:
+			corrupted = bytearray(data)
+			struct.pack_into('<I', corrupted, 48 + 4*(count//2), offset)
+			with open(self.path, 'wb') as f:
+				f.write(corrupted)
+
+			self.assertRaises(aspell.AspellModuleError, aspell.MappedWordlist, self.path)
+
+		# the first offset must be 0
+		corrupted = bytearray(data)
+		struct.pack_into('<I', corrupted, 48, 1)
+		with open(self.path, 'wb') as f:
+			f.write(corrupted)
+
+		self.assertRaises(aspell.AspellModuleError, aspell.MappedWordlist, self.path)
+
+
 class TestPersonalwordlist(TestBase):
 	
 	def setUp(self):
@@ -204,6 +807,265 @@ class TestPersonalwordlist(TestBase):
 		self._clear_personal()
 
 
+class TestStats(TestBase):
+	def setUp(self):
+		TestBase.setUp(self)
+		aspell.setStatsEnabled(True)
+
+	def tearDown(self):
+		aspell.setStatsEnabled(False)
+
+	def test_counters(self):
+		self.speller.check('word')
+		self.speller.check('wrod')
+		self.speller.checkMany(['word', 'tree', 'wrod'])
+		self.speller.suggest('wrod')
+		self.assertRaises(TypeError, self.speller.check, 1)
+
+		stats = self.speller.stats()
+		self.assertEqual(stats['check']['calls'], 3)
+		self.assertEqual(stats['check']['words'], 2)
+		self.assertEqual(stats['check']['exceptions'], 1)
+		self.assertEqual(stats['checkMany']['words'], 3)
+		self.assertEqual(stats['suggest']['calls'], 1)
+		self.assertEqual(stats['suggestMany']['calls'], 0)
+
+		histogram = stats['suggest']['aspell_histogram']
+		self.assertEqual(sum(histogram.values()), 1)
+		self.assertTrue(stats['suggest']['aspell_time'] > 0)
+
+	def test_reset(self):
+		self.speller.check('word')
+		self.speller.resetStats()
+		self.assertEqual(self.speller.stats()['check']['calls'], 0)
+
+	def test_disabled(self):
+		aspell.setStatsEnabled(False)
+		self.assertFalse(aspell.statsEnabled())
+
+		self.speller.check('word')
+		self.speller.suggest('wrod')
+
+		stats = self.speller.stats()
+		self.assertEqual(stats['check']['calls'], 0)
+		self.assertEqual(stats['suggest']['calls'], 0)
+
+
+class TestClone(TestBase):
+	def test_clone(self):
+		self.speller.addtoSession('kot')
+		self.speller.addtoPersonal('drzewo')
+		self.speller.addReplacement('wrod', 'trod')
+
+		clone = self.speller.clone()
+		self.assertFalse(clone is self.speller)
+		self.assertEqual(clone.ConfigKeys(), self.speller.ConfigKeys())
+		self.assertTrue(clone.check('kot'))
+		self.assertTrue(clone.check('drzewo'))
+		self.assertEqual(clone.suggest('wrod')[0], 'trod')
+
+	def test_independent(self):
+		clone = self.speller.clone()
+		clone.addtoSession('wiosna')
+
+		self.assertTrue(clone.check('wiosna'))
+		self.assertFalse(self.speller.check('wiosna'))
+
+
+class TestSnapshot(TestBase):
+	def test_restore(self):
+		self.speller.addtoSessionMany(['kot', 'wiosna'])
+		self.speller.addtoPersonal('drzewo')
+		self.speller.addReplacement('wrod', 'trod')
+
+		restored = aspell.Speller.restore(self.speller.snapshot())
+		self.assertFalse(restored is self.speller)
+		self.assertEqual(restored.ConfigKeys(), self.speller.ConfigKeys())
+		self.assertEqual(restored.getSessionwordlist(), ['kot', 'wiosna'])
+		self.assertTrue(restored.check('drzewo'))
+		self.assertEqual(restored.suggest('wrod')[0], 'trod')
+
+		# snapshot of restored speller holds the same state
+		self.assertEqual(restored.snapshot(), self.speller.snapshot())
+
+	def test_raw(self):
+		speller = aspell.Speller(('lang', 'en'), raw=True)
+		restored = aspell.Speller.restore(speller.snapshot())
+		self.assertEqual(restored.suggest(b'wrod'), speller.suggest(b'wrod'))
+		self.assertRaises(TypeError, restored.check, 'word')
+
+	def test_pickle(self):
+		import pickle
+		self.speller.addtoSession('kot')
+
+		restored = pickle.loads(pickle.dumps(self.speller))
+		self.assertTrue(isinstance(restored, aspell.Speller))
+		self.assertTrue(restored.check('kot'))
+
+	def test_invalid(self):
+		snapshot = self.speller.snapshot()
+		self.assertRaises(ValueError, aspell.Speller.restore, b'')
+		self.assertRaises(ValueError, aspell.Speller.restore, b'word')
+		self.assertRaises(ValueError, aspell.Speller.restore, snapshot[:-1])
+		self.assertRaises(ValueError, aspell.Speller.restore, snapshot + b'\0')
+		self.assertRaises(TypeError, aspell.Speller.restore, 'aspl')
+
+
+class TestRawSpeller(unittest.TestCase):
+	def setUp(self):
+		self.speller = aspell.Speller(('lang', 'en'), raw=True)
+
+	def test_check(self):
+		self.assertTrue(self.speller.check(b'word'))
+		self.assertFalse(self.speller.check(b'wrod'))
+		self.assertTrue(self.speller.check(bytearray(b'word')))
+		self.assertTrue(self.speller.check(memoryview(b'word')))
+		self.assertEqual(self.speller.checkMany([b'word', b'wrod'], indices=True), [1])
+
+	def test_results_are_bytes(self):
+		sug = self.speller.suggest(b'wrod')
+		self.assertTrue(b'word' in sug)
+		self.assertTrue(all(isinstance(word, bytes) for word in sug))
+
+		self.speller.addtoSession(b'kot')
+		self.assertEqual(self.speller.getSessionwordlist(), [b'kot'])
+		self.assertEqual(self.speller.suggestMany([b'wrod'])[0], sug)
+		self.assertEqual(self.speller.clone().suggest(b'wrod'), sug)
+
+	def test_str_rejected(self):
+		self.assertRaises(TypeError, self.speller.check, 'word')
+		self.assertRaises(TypeError, self.speller.suggest, 'wrod')
+
+	def test_options(self):
+		self.assertRaises(TypeError, aspell.Speller, ('lang', 'en'), foo=True)
+		self.assertTrue(aspell.Speller(('lang', 'en'), raw=False).check('word'))
+
+
+class TestSpellerRegistry(unittest.TestCase):
+	def setUp(self):
+		aspell.clearSpellerRegistry()
+
+	def tearDown(self):
+		aspell.clearSpellerRegistry()
+
+	def test_shared(self):
+		s1 = aspell.getSpeller(('lang', 'en'))
+		s2 = aspell.getSpeller('lang', 'en')
+		s3 = aspell.getSpeller(('lang', 'pl'))
+
+		self.assertTrue(s1 is s2)
+		self.assertFalse(s1 is s3)
+
+		stats = aspell.spellerRegistryStats()
+		self.assertEqual(stats['configs'], 2)
+		self.assertEqual(stats['hits'], 1)
+		self.assertEqual(stats['misses'], 2)
+
+	def test_clear(self):
+		s1 = aspell.getSpeller(('lang', 'en'))
+		aspell.clearSpellerRegistry()
+		self.assertEqual(aspell.spellerRegistryStats()['configs'], 0)
+		self.assertFalse(aspell.getSpeller(('lang', 'en')) is s1)
+
+	def test_errors(self):
+		self.assertRaises(aspell.AspellConfigError, aspell.getSpeller, ('no-such-key', 'x'))
+		self.assertEqual(aspell.spellerRegistryStats()['configs'], 0)
+
+
+class TestCommandLine(unittest.TestCase):
+	def setUp(self):
+		import tempfile
+		self.dir = tempfile.mkdtemp()
+		os.mkdir(os.path.join(self.dir, 'sub'))
+		self.write('a.txt', b'word wrod\ntree misteke wrod\n')
+		self.write(os.path.join('sub', 'b.txt'), b'wrod zo\n')
+
+	def tearDown(self):
+		import shutil
+		shutil.rmtree(self.dir)
+
+	def write(self, name, data):
+		with open(os.path.join(self.dir, name), 'wb') as f:
+			f.write(data)
+
+	def run_main(self, *args):
+		import io
+		from aspell import __main__ as cli
+
+		out = io.StringIO()
+		err = io.StringIO()
+		code = cli.main(['-l', 'en'] + list(args), out=out, err=err)
+		return code, out.getvalue(), err.getvalue()
+
+	def test_jsonl(self):
+		import json
+		code, out, err = self.run_main('-j', '1', '-s', '1', os.path.join(self.dir, '**', '*.txt'))
+		self.assertEqual(code, 0)
+
+		records = [json.loads(line) for line in out.splitlines()]
+		self.assertEqual([(r['word'], r['count']) for r in records], [('wrod', 3), ('misteke', 1), ('zo', 1)])
+		self.assertTrue('word' in records[0]['suggestions'])
+		self.assertFalse('suggestions' in records[1])
+		self.assertTrue('total: 7 words' in err)
+
+	def test_tsv(self):
+		code, out, err = self.run_main('-j', '1', '-q', '-f', 'tsv', os.path.join(self.dir, 'a.txt'))
+		self.assertEqual(out, 'wrod\t2\nmisteke\t1\n')
+		self.assertEqual(err, '')
+
+
+@unittest.skipUnless(hasattr(aspell, 'AsyncSpeller'), "asyncio not available")
+class TestAsyncSpeller(unittest.TestCase):
+	def run_async(self, coroutine):
+		import asyncio
+		return asyncio.run(coroutine)
+
+	def test_check(self):
+		import asyncio
+
+		async def main():
+			async with aspell.AsyncSpeller(('lang', 'en'), threads=2) as speller:
+				words = ['word', 'wrod', 'tree', 'tre'] * 10
+				result = await asyncio.gather(*[speller.check(word) for word in words])
+				return result, speller.stats()
+
+		result, stats = self.run_async(main())
+		self.assertEqual(result, [True, False, True, False] * 10)
+		self.assertEqual(stats['requests'], 40)
+		self.assertTrue(stats['batches'] < 40)
+
+	def test_suggest(self):
+		import asyncio
+
+		reference = aspell.Speller(('lang', 'en'))
+
+		async def main():
+			async with aspell.AsyncSpeller(('lang', 'en'), max_batch=2) as speller:
+				return await asyncio.gather(*[speller.suggest(word) for word in ['wrod', 'tre', 'xoo']])
+
+		result = self.run_async(main())
+		self.assertEqual(result, [reference.suggest(word) for word in ['wrod', 'tre', 'xoo']])
+
+	def test_errors(self):
+		import asyncio
+
+		async def main():
+			speller = aspell.AsyncSpeller(('lang', 'en'), ('encoding', 'iso-8859-1'))
+			self.assertRaises(TypeError, speller.check, 1)
+
+			ok = speller.check('word')
+			bad = speller.check(u'\u0105')
+			await asyncio.gather(ok, bad, return_exceptions=True)
+			await speller.close()
+
+			self.assertRaises(RuntimeError, speller.check, 'word')
+			return ok.result(), bad.exception()
+
+		ok, bad = self.run_async(main())
+		self.assertTrue(ok)
+		self.assertTrue(isinstance(bad, UnicodeEncodeError))
+
+
 class TestSetConfigKey(unittest.TestCase):
 	def setUp(self):
 		self.speller = aspell.Speller(('lang', 'en'))
@@ -246,6 +1108,387 @@ class TestSetConfigKey(unittest.TestCase):
 		self.speller.setConfigKey(key, value)
 		self.assertEqual(self.get_config()[key], value)
 
+class TestCheckCache(unittest.TestCase):
+	def setUp(self):
+		aspell.setCheckCache(1000)
+		self.s1 = aspell.Speller(('lang', 'en'))
+		self.s2 = aspell.Speller(('lang', 'en'))
+
+	def tearDown(self):
+		aspell.setCheckCache(0)
+
+	def test_shared(self):
+		self.assertTrue(self.s1.check('word'))
+		self.assertFalse(self.s1.check('wrod'))
+		self.assertTrue(self.s2.check('word'))
+		self.assertFalse(self.s2.check('wrod'))
+		self.assertEqual(self.s2.checkMany(['word', 'wrod']), bytearray([1, 0]))
+
+		stats = aspell.checkCacheStats()
+		self.assertTrue(stats['enabled'])
+		self.assertEqual(stats['misses'], 2)
+		self.assertEqual(stats['hits'], 4)
+		self.assertEqual(stats['entries'], 2)
+
+	def test_different_config(self):
+		s3 = aspell.Speller(('lang', 'en'), ('ignore-case', 'true'))
+		self.s1.check('word')
+		s3.check('word')
+		self.assertEqual(aspell.checkCacheStats()['hits'], 0)
+
+	def test_session_change(self):
+		for word in ['kot', 'drzewo']:
+			self.assertFalse(self.s1.check(word))
+			self.assertFalse(self.s2.check(word))
+
+		self.s1.addtoSession('kot')
+		self.assertTrue(self.s1.check('kot'))
+		self.assertEqual(self.s1.checkMany(['kot', 'drzewo']), bytearray([1, 0]))
+		self.assertFalse(self.s2.check('kot'))
+
+		self.s1.clearSession()
+		self.assertFalse(self.s1.check('kot'))
+
+	def test_disable(self):
+		self.s1.check('word')
+		aspell.setCheckCache(0)
+		self.assertTrue(self.s1.check('word'))
+		self.assertFalse(aspell.checkCacheStats()['enabled'])
+
+
+class TestEncoding(unittest.TestCase):
+	"words are converted according to speller's encoding"
+
+	def speller(self, encoding):
+		return aspell.Speller(('lang', 'en'), ('encoding', encoding))
+
+	def test_ascii(self):
+		s = self.speller('ascii')
+		self.assertTrue(s.check('word'))
+		self.assertTrue(s.check(b'word'))
+		self.assertEqual(s.suggest('wrod')[0], 'word')
+		self.assertRaises(UnicodeEncodeError, s.check, u'za\u017c\xf3\u0142\u0107')
+
+	def test_latin1(self):
+		s = self.speller('iso-8859-1')
+		self.assertTrue(s.check('word'))
+		self.assertFalse(s.check(u'caf\xe9x'))
+		self.assertRaises(UnicodeEncodeError, s.check, u'za\u017c\xf3\u0142\u0107')
+
+	def test_utf8(self):
+		s = self.speller('utf-8')
+		self.assertTrue(s.check('word'))
+		self.assertFalse(s.check(u'za\u017c\xf3\u0142\u0107'))
+		self.assertFalse(s.check(u'\u4e00\u4e01'))
+
+	def test_other(self):
+		s = self.speller('iso-8859-2')
+		self.assertTrue(s.check('word'))
+		self.assertFalse(s.check(u'za\u017c\xf3\u0142\u0107'))
+		self.assertRaises(UnicodeEncodeError, s.check, u'\u4e00')
+
+
+class TestThreads(TestBase):
+	"shared speller used concurrently from several threads"
+
+	def test_shared_speller(self):
+		import threading
+
+		errors = []
+		def worker():
+			try:
+				for i in range(200):
+					self.assertTrue(self.speller.check('word'))
+					self.assertFalse(self.speller.check('wrod'))
+					self.assertTrue('word' in self.speller.suggest('wrod'))
+					self.speller.addtoSession('kot')
+			except Exception as e:
+				errors.append(e)
+
+		threads = [threading.Thread(target=worker) for i in range(8)]
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+
+		self.assertEqual(errors, [])
+		self.assertEqual(self.speller.getSessionwordlist(), ['kot'])
+
+
+class TestSpellerPool(unittest.TestCase):
+	def setUp(self):
+		self.pool = aspell.SpellerPool(2, ('lang', 'en'))
+
+	def test_check_suggest(self):
+		self.assertEqual(len(self.pool), 2)
+		self.assertTrue(self.pool.check('word'))
+		self.assertFalse(self.pool.check('wrod'))
+		self.assertTrue('word' in self.pool.suggest('wrod'))
+		self.assertEqual(len(self.pool.suggest('wrod', limit=1, mode='fast')), 1)
+		self.assertEqual(self.pool.checkMany(['word', 'wrod'], indices=True), [1])
+
+	def test_checkout(self):
+		s1 = self.pool.checkout()
+		s2 = self.pool.checkout()
+		self.assertTrue(s1 is not s2)
+		self.assertTrue(s1.check('word'))
+
+		with self.assertRaises(TimeoutError):
+			self.pool.checkout(timeout=0.01)
+
+		self.pool.checkin(s1)
+		self.assertTrue(self.pool.checkout(timeout=0) is s1)
+
+		self.pool.checkin(s1)
+		self.pool.checkin(s2)
+		with self.assertRaises(ValueError):
+			self.pool.checkin(s2)
+
+		with self.assertRaises(ValueError):
+			self.pool.checkin(aspell.Speller('lang', 'en'))
+
+	def test_stats(self):
+		s = self.pool.checkout()
+		stats = self.pool.stats()
+		self.pool.checkin(s)
+
+		self.assertEqual(stats['size'], 2)
+		self.assertEqual(stats['free'], 1)
+		self.assertEqual(stats['checkouts'], 1)
+		self.assertEqual(stats['max_busy'], 1)
+		self.assertTrue(0.0 <= stats['utilisation'] <= 1.0)
+
+	def test_threads(self):
+		import threading
+
+		errors = []
+		def worker():
+			try:
+				for i in range(100):
+					self.assertTrue(self.pool.check('word'))
+					s = self.pool.checkout()
+					self.assertFalse(s.check('wrod'))
+					self.pool.checkin(s)
+			except Exception as e:
+				errors.append(e)
+
+		threads = [threading.Thread(target=worker) for i in range(6)]
+		for t in threads:
+			t.start()
+		for t in threads:
+			t.join()
+
+		self.assertEqual(errors, [])
+		stats = self.pool.stats()
+		self.assertEqual(stats['free'], 2)
+		self.assertEqual(stats['checkouts'], 1200)
+
+
+class TestThreadLocalSpeller(unittest.TestCase):
+	def test(self):
+		import threading
+
+		local = aspell.ThreadLocalSpeller(('lang', 'en'))
+		self.assertTrue(local.check('word'))
+		self.assertTrue(local.speller() is local.speller())
+
+		other = []
+		t = threading.Thread(target=lambda: other.append(local.speller()))
+		t.start()
+		t.join()
+
+		self.assertTrue(other[0] is not local.speller())
+		self.assertEqual(local.stats()['created'], 2)
+
+
+class TestMultiSpeller(unittest.TestCase):
+	def setUp(self):
+		# two spellers differing in session dictionaries
+		self.first = aspell.Speller(('lang', 'en'))
+		self.second = aspell.Speller(('lang', 'en'))
+		self.first.addtoSession('kot')
+		self.second.addtoSessionMany(['kot', 'drzewo'])
+
+		self.multi = aspell.MultiSpeller([self.first, self.second])
+
+	def test_check(self):
+		self.assertTrue(self.multi.check('word'))
+		self.assertTrue(self.multi.check('drzewo'))
+		self.assertFalse(self.multi.check('wiosna'))
+		self.assertTrue('drzewo' in self.multi)
+
+	def test_which(self):
+		self.assertEqual(self.multi.which('kot'), 0)
+		self.assertEqual(self.multi.which('drzewo'), 1)
+		self.assertEqual(self.multi.which('wiosna'), -1)
+
+	def test_order(self):
+		self.multi.order = [1, 0]
+		self.assertEqual(self.multi.order, (1, 0))
+		self.assertEqual(self.multi.which('kot'), 1)
+
+		self.multi.order = [0]
+		self.assertEqual(self.multi.which('drzewo'), -1)
+
+		for order in [[], [0, 0], [2], ['0']]:
+			with self.assertRaises((ValueError, TypeError)):
+				self.multi.order = order
+
+		multi = aspell.MultiSpeller([self.first, self.second], order=[1, 0])
+		self.assertEqual(multi.which('kot'), 1)
+
+	def test_many(self):
+		words = ['kot', 'wiosna', 'drzewo', 'word']
+		self.assertEqual(self.multi.whichMany(words), [0, -1, 1, 0])
+		self.assertEqual(self.multi.checkMany(iter(words)), bytearray([1, 0, 1, 1]))
+		self.assertEqual(self.multi.checkMany(words, indices=True), [1])
+		self.assertEqual(self.multi.whichMany([]), [])
+
+		with self.assertRaises(TypeError) as cm:
+			self.multi.checkMany(['word', 1])
+		self.assertIn('word #1', str(cm.exception))
+
+	def test_suggest(self):
+		first = self.first.suggest('wrod', limit=2)
+		second = self.second.suggest('wrod', limit=2)
+
+		merged = self.multi.suggest('wrod', limit=2)
+		self.assertEqual(merged[:len(first)], first)
+		self.assertEqual(len(merged), len(set(first + second)))
+		self.assertEqual(self.multi.suggestMany(['wrod', 'word'], limit=2, threads=1), [merged, self.multi.suggest('word', limit=2)])
+
+	def test_configs(self):
+		multi = aspell.MultiSpeller([('lang', 'en'), [('lang', 'en'), ('sug-mode', 'fast')]])
+		self.assertEqual(len(multi), 2)
+		self.assertEqual(multi.spellers[1].ConfigKeys()['sug-mode'][1], 'fast')
+
+		self.assertRaises(ValueError, aspell.MultiSpeller, [])
+		self.assertRaises(TypeError, aspell.MultiSpeller, [1])
+		self.assertRaises(aspell.AspellConfigError, aspell.MultiSpeller, [('no-such-key', 'x')])
+
+
+try:
+	import _interpreters as subinterpreters
+except ImportError:
+	try:
+		import _xxsubinterpreters as subinterpreters
+	except ImportError:
+		subinterpreters = None
+
+
+class TestModuleState(unittest.TestCase):
+	def test_types(self):
+		speller = aspell.Speller(('lang', 'en'))
+		self.assertRaises(TypeError, type(speller.iterMainwordlist()))
+		self.assertRaises(TypeError, setattr, aspell.Speller, 'check', None)
+		with self.assertRaises(TypeError):
+			class Subclass(aspell.Speller):
+				pass
+
+	def test_gc(self):
+		speller = aspell.Speller(('lang', 'en'))
+		multi = aspell.MultiSpeller([speller])
+		for obj in [speller, multi, speller.iterMainwordlist()]:
+			self.assertTrue(gc.is_tracked(obj))
+			self.assertTrue(type(obj) in gc.get_referents(obj))
+
+		spellers = [ref for ref in gc.get_referents(multi) if isinstance(ref, tuple) and speller in ref]
+		self.assertEqual(len(spellers), 1)
+
+	@unittest.skipIf(subinterpreters is None, "subinterpreters not available")
+	def test_subinterpreter_loop(self):
+		# spellers of getSpeller() form a cycle with the module:
+		# registry -> speller -> type -> module -> registry
+		for i in range(20):
+			interp = subinterpreters.create()
+			try:
+				subinterpreters.run_string(interp, '\n'.join([
+					"import sys",
+					"sys.path[:0] = %r" % sys.path,
+					"import aspell",
+					"speller = aspell.getSpeller(('lang', 'en'))",
+					"multi = aspell.MultiSpeller([speller])",
+					"assert multi.check('word')",
+				]))
+			finally:
+				subinterpreters.destroy(interp)
+
+	@unittest.skipIf(subinterpreters is None, "subinterpreters not available")
+	def test_subinterpreter(self):
+		aspell.setCheckCache(100)
+		aspell.setStatsEnabled(True)
+		try:
+			interp = subinterpreters.create()
+			try:
+				subinterpreters.run_string(interp, '\n'.join([
+					"import sys",
+					"sys.path[:0] = %r" % sys.path,
+					"import aspell",
+					"assert not aspell.checkCacheStats()['enabled']",
+					"assert not aspell.statsEnabled()",
+					"aspell.setStatsEnabled(False)",
+					"assert aspell.Speller(('lang', 'en')).check('word')",
+				]))
+			finally:
+				subinterpreters.destroy(interp)
+
+			self.assertTrue(aspell.checkCacheStats()['enabled'])
+			self.assertTrue(aspell.statsEnabled())
+		finally:
+			aspell.setCheckCache(0)
+			aspell.setStatsEnabled(False)
+
+
+# the ctypes module loads library given by ASPELL_CTYPES_LIB or found by ctypes
+try:
+	import ctypes.util
+	from pyaspell.pyaspell import AspellLinux
+	ctypes_lib = os.environ.get('ASPELL_CTYPES_LIB') or ctypes.util.find_library('aspell')
+except ImportError:
+	ctypes_lib = None
+
+
+@unittest.skipIf(ctypes_lib is None, "aspell library not found")
+class TestCtypesModule(unittest.TestCase):
+	def setUp(self):
+		self.speller = AspellLinux(('lang', 'en'), ctypes_lib)
+		self.c_speller = aspell.Speller(('lang', 'en'))
+
+	def tearDown(self):
+		self.speller.close()
+
+	def test_check(self):
+		words = ['word', 'wrod', 'tree', 'zażółć']
+		for word in words:
+			self.assertEqual(self.speller.check(word), self.c_speller.check(word))
+
+		self.assertRaises(TypeError, self.speller.check, 1)
+
+	def test_check_many(self):
+		words = ['word', 'wrod', 'tree', 'zażółć', 'winter']
+		self.assertEqual(self.speller.check_many(words), self.c_speller.checkMany(words))
+		self.assertEqual(self.speller.check_many(iter([])), bytearray())
+		self.assertRaises(TypeError, self.speller.check_many, ['word', 1])
+
+	def test_encoded_length(self):
+		# length passed to aspell is length of encoded word
+		self.speller.session_dict('zażółć')
+		self.assertTrue(self.speller.check('zażółć'))
+		self.assertEqual(self.speller.check_many(['zażółć', 'zażół']), bytearray([1, 0]))
+		self.assertEqual(self.speller.session_dict(), ['zażółć'])
+
+	def test_suggest(self):
+		self.assertEqual(self.speller.suggest('wrod'), self.c_speller.suggest('wrod'))
+
+	def test_library_loaded_once(self):
+		import pyaspell.pyaspell
+		other = AspellLinux(('lang', 'en'), ctypes_lib)
+		try:
+			self.assertEqual(len(pyaspell.pyaspell._libraries), 1)
+		finally:
+			other.close()
+
+
 if __name__ == '__main__':
 	try:
 		del sys.argv[sys.argv.index(arg)]